@@ -0,0 +1,300 @@
+/*
+ *	HTML stream parser benchmark
+ *	Copyright (C) 2012 Michael Kowalczyk
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Generates the synthetic corpora and parses each of them
+ * by every entry point and capture configuration, printing
+ * MB/s, ns per byte and the allocations made. All the entry
+ * points must leave the parser in the same state, otherwise
+ * the program exits with 1, so make check runs it on small
+ * corpora. The corpora are the same for the same seed.
+ *
+ *	htmlbench [-s MB] [-r runs] [-S seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <htmlstreamparser.h>
+
+/*
+ * Counts the allocations of the parser
+ * by wrapping the glibc allocator.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+static unsigned long allocs;
+
+void *malloc(size_t size) { __sync_fetch_and_add(&allocs, 1); return __libc_malloc(size); }
+
+void *calloc(size_t n, size_t size) { __sync_fetch_and_add(&allocs, 1); return __libc_calloc(n, size); }
+
+void *realloc(void *p, size_t size) { __sync_fetch_and_add(&allocs, 1); return __libc_realloc(p, size); }
+
+#define ALLOCS_COUNTED 1
+#else
+static unsigned long allocs;
+
+#define ALLOCS_COUNTED 0
+#endif
+
+static unsigned long long seed = 88172645463325252ULL;
+
+static unsigned rnd(void) { seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17; return (unsigned) seed; }
+
+typedef struct {
+	char *buf;
+	size_t len;
+	size_t max_len;
+} CORPUS;
+
+static void put(CORPUS *c, const char *s) {
+	size_t l = strlen(s);
+	if (c->len + l > c->max_len) l = c->max_len - c->len;
+	memcpy(c->buf + c->len, s, l);
+	c->len += l;
+}
+
+static const char *words[] = { "the", "parser", "stream", "html", "tag", "value", "text", "of", "and", "a", "embedded", "device", "&amp;", "&lt;", "&#233;", "chunk" };
+
+#define WORDS (sizeof(words) / sizeof(words[0]))
+
+static void put_word(CORPUS *c) { put(c, words[rnd() % WORDS]); put(c, rnd() % 8 ? " " : "\n"); }
+
+static void gen_text(CORPUS *c) {
+	int i, n;
+	put(c, "<html><head><title>text</title></head><body>\n");
+	while (c->len < c->max_len) {
+		put(c, rnd() % 2 ? "<p>" : "<div>");
+		for (i = 0, n = 20 + rnd() % 200; i < n; i++) {
+			if (rnd() % 40 == 0) { put(c, "<b>"); put_word(c); put(c, "</b> "); }
+			else put_word(c);
+		}
+		put(c, "</p>\n");
+	}
+}
+
+static void gen_attributes(CORPUS *c) {
+	char num[32];
+	int i, n;
+	while (c->len < c->max_len) {
+		put(c, rnd() % 2 ? "<a" : "<img");
+		for (i = 0, n = 2 + rnd() % 8; i < n; i++) {
+			switch (rnd() % 4) {
+			case 0: put(c, " href=\"/path/to/page?id="); sprintf(num, "%u", rnd()); put(c, num); put(c, "&amp;x=1\""); break;
+			case 1: put(c, " class='nav item active'"); break;
+			case 2: put(c, " data-n="); sprintf(num, "%u", rnd() % 1000); put(c, num); break;
+			default: put(c, " hidden"); break;
+			}
+		}
+		put(c, rnd() % 2 ? ">x</a>\n" : " />\n");
+	}
+}
+
+static void gen_script(CORPUS *c) {
+	while (c->len < c->max_len) {
+		put(c, "<script type=\"text/javascript\">\n");
+		while (rnd() % 16) {
+			put(c, rnd() % 2 ? "for (var i = 0; i < n && a[i] > 0; i++) { s += '<div>' + a[i] + '</div>'; }\n"
+				: "if (x<y) document.write(\"<p class='x'>\" + y + \"</p>\"); // a > b\n");
+		}
+		put(c, "</script>\n<!-- ");
+		put_word(c);
+		put(c, "--> <p>");
+		put_word(c);
+		put(c, "</p>\n");
+	}
+}
+
+static void gen_nested(CORPUS *c) {
+	int depth, i;
+	while (c->len < c->max_len) {
+		depth = 16 + rnd() % 240;
+		for (i = 0; i < depth; i++) put(c, i % 3 ? "<div class=\"n\">" : "<span>");
+		put_word(c);
+		for (i = depth - 1; i >= 0; i--) put(c, i % 3 ? "</div>" : "</span>");
+		put(c, "\n");
+	}
+}
+
+static const char *broken[] = { "<", ">", "</", "<!", "<!--", "-->", "=", "\"", "'", " ", "<a href=\"x", "<p title='", "< p>", "</ a>", "<br/", "a<b", "<scr", "</script", "<script>", "&", "&#x", "&amp", "x" };
+
+#define BROKEN (sizeof(broken) / sizeof(broken[0]))
+
+static void gen_malformed(CORPUS *c) {
+	while (c->len < c->max_len) {
+		put(c, broken[rnd() % BROKEN]);
+		if (rnd() % 4 == 0) put_word(c);
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*gen)(CORPUS *c);
+} corpora[] = {
+	{ "text", gen_text },
+	{ "attributes", gen_attributes },
+	{ "script", gen_script },
+	{ "nested", gen_nested },
+	{ "malformed", gen_malformed }
+};
+
+#define CORPORA (sizeof(corpora) / sizeof(corpora[0]))
+
+enum { CAPTURE_NONE, CAPTURE_BUFFERS, CAPTURE_LOWER, CAPTURE_COLLAPSE, CAPTURES };
+
+static const char *captures[] = { "none", "buffers", "lower", "collapse" };
+
+enum { ENTRY_CHAR_PARSE, ENTRY_PARSE, ENTRY_CALLBACKS, ENTRY_LINKS, ENTRY_VISIBLE, ENTRY_TAPE, ENTRIES };
+
+static const char *entries[] = { "char_parse", "parse", "callbacks", "links", "visible", "tape" };
+
+static char tag[128], attr[128], val[128], text[1024];
+
+#define LINKS 65536
+
+static HTMLSTREAMPARSER_LINK links[LINKS];
+
+static char link_buf[LINKS * 64];
+
+static char ring[65536];
+
+#define TOKENS (1 << 20)
+
+static HTMLSTREAMPARSER_TOKEN tape[TOKENS];
+
+static char tape_arena[65536];
+
+static unsigned long events;
+
+static void on_name(void *user, const char *name, size_t len) { (void) user; (void) name; (void) len; events++; }
+
+static void on_attribute(void *user, const char *name, size_t name_len, const char *value, size_t value_len) { (void) user; (void) name; (void) name_len; (void) value; (void) value_len; events++; }
+
+static void on_low(HTMLSTREAMPARSER *hsp, void *user) { (void) user; html_parser_consume_visible_text(hsp, html_parser_visible_text_length(hsp)); }
+
+static const HTMLSTREAMPARSER_CALLBACKS counter = { on_name, on_attribute, on_name, on_name, on_name, on_name };
+
+/*
+ * The parser state left after the corpus,
+ * which must not depend on the entry point.
+ */
+typedef struct {
+	unsigned long html_part;
+	size_t tag_len;
+	size_t attr_len;
+	size_t val_len;
+	size_t text_len;
+	size_t text_real_len;
+} STATE;
+
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double run(const CORPUS *c, int entry, int capture, STATE *s) {
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	double t;
+	size_t i;
+	if (!hsp) return -1;
+	if (capture != CAPTURE_NONE) {
+		html_parser_set_tag_buffer(hsp, tag, sizeof(tag));
+		html_parser_set_attr_buffer(hsp, attr, sizeof(attr));
+		html_parser_set_val_buffer(hsp, val, sizeof(val));
+		html_parser_set_inner_text_buffer(hsp, text, sizeof(text));
+	}
+	if (capture == CAPTURE_LOWER) {
+		html_parser_set_tag_to_lower(hsp, 1);
+		html_parser_set_attr_to_lower(hsp, 1);
+		html_parser_set_val_to_lower(hsp, 1);
+	}
+	if (capture == CAPTURE_COLLAPSE) html_parser_set_inner_text_collapse(hsp, 1);
+	if (entry == ENTRY_CALLBACKS) html_parser_set_callbacks(hsp, &counter, NULL);
+	if (entry == ENTRY_LINKS) {
+		if (html_parser_set_links(hsp, links, LINKS, link_buf, sizeof(link_buf), 1)) return -1;
+		html_parser_set_links_url(hsp, "http://example.com/dir/page.html", 32);
+	}
+	if (entry == ENTRY_VISIBLE && html_parser_set_visible_text(hsp, ring, sizeof(ring), sizeof(ring) / 4, on_low, NULL)) return -1;
+	if (entry == ENTRY_TAPE && html_parser_set_tape(hsp, tape, TOKENS, tape_arena, sizeof(tape_arena))) return -1;
+	t = now();
+	if (entry == ENTRY_CHAR_PARSE) for (i = 0; i < c->len; i++) html_parser_char_parse(hsp, c->buf[i]);
+	else html_parser_parse(hsp, c->buf, c->len);
+	t = now() - t;
+	s->html_part = hsp->html_part;
+	s->tag_len = html_parser_tag_length(hsp);
+	s->attr_len = html_parser_attr_length(hsp);
+	s->val_len = html_parser_val_length(hsp);
+	s->text_len = html_parser_inner_text_length(hsp);
+	s->text_real_len = hsp->inner_text_real_len;
+	html_parser_cleanup(hsp);
+	return t;
+}
+
+int main(int argc, char **argv) {
+	size_t size = 16, i;
+	int runs = 3, entry, capture, r, failed = 0;
+	CORPUS c;
+	STATE first, s;
+	unsigned long a;
+	double best, t;
+	for (r = 1; r + 1 < argc; r += 2) {
+		if (!strcmp(argv[r], "-s")) size = strtoul(argv[r + 1], NULL, 10);
+		else if (!strcmp(argv[r], "-r")) runs = atoi(argv[r + 1]);
+		else if (!strcmp(argv[r], "-S")) seed = strtoull(argv[r + 1], NULL, 10);
+		else break;
+	}
+	if (r < argc || !size || runs < 1 || !seed) {
+		fprintf(stderr, "usage: %s [-s MB] [-r runs] [-S seed]\n", argv[0]);
+		return 2;
+	}
+	c.max_len = size << 20;
+	if (!(c.buf = (char *) malloc(c.max_len))) return 2;
+	printf("%-10s %-10s %-8s %9s %8s %7s\n", "corpus", "entry", "capture", "MB/s", "ns/B", "allocs");
+	for (i = 0; i < CORPORA; i++) {
+		c.len = 0;
+		corpora[i].gen(&c);
+		for (capture = 0; capture < CAPTURES; capture++) {
+			for (entry = 0; entry < ENTRIES; entry++) {
+				best = 0;
+				for (r = 0; r < runs; r++) {
+					a = allocs;
+					if ((t = run(&c, entry, capture, &s)) < 0) return 2;
+					a = allocs - a;
+					if (!r || t < best) best = t;
+				}
+				if (entry == 0) first = s;
+				else if (memcmp(&first, &s, sizeof(STATE))) {
+					fprintf(stderr, "%s: %s and %s disagree with %s capture\n", corpora[i].name, entries[0], entries[entry], captures[capture]);
+					failed = 1;
+				}
+				if (best <= 0) best = 1e-9;
+				printf("%-10s %-10s %-8s %9.1f %8.2f ", corpora[i].name, entries[entry], captures[capture], c.len / best / 1e6, best * 1e9 / c.len);
+				if (ALLOCS_COUNTED) printf("%7lu\n", a);
+				else printf("%7s\n", "-");
+			}
+		}
+	}
+	free(c.buf);
+	return failed;
+}
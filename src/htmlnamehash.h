@@ -0,0 +1,175 @@
+/*
+ *	HTML stream parser
+ *	Copyright (C) 2012 Michael Kowalczyk
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The perfect hash tables of the tag and attribute names
+ * listed in htmlnames.h. The FNV-1a hash of a lower case name
+ * selects a displacement from the *_displacements table and
+ * the hash mixed with the displacement selects a slot holding
+ * the id of the only name which can be there. The name of the id
+ * is the *_names part from *_name_offsets[id - 1] to
+ * *_name_offsets[id], so the lookup ends with one compare.
+ */
+
+#define HTML_TAG_HASH_BITS 8
+#define HTML_TAG_HASH_BUCKETS 64
+
+static const char html_tag_names[] =
+	"a" "abbr" "acronym" "address" "applet" "area" "article" "aside" "audio" "b" "base" "basefont"
+	"bdi" "bdo" "bgsound" "big" "blink" "blockquote" "body" "br" "button" "canvas" "caption" "center"
+	"cite" "code" "col" "colgroup" "data" "datalist" "dd" "del" "details" "dfn" "dialog" "dir"
+	"div" "dl" "dt" "em" "embed" "fieldset" "figcaption" "figure" "font" "footer" "form" "frame"
+	"frameset" "h1" "h2" "h3" "h4" "h5" "h6" "head" "header" "hgroup" "hr" "html"
+	"i" "iframe" "image" "img" "input" "ins" "isindex" "kbd" "keygen" "label" "legend" "li"
+	"link" "listing" "main" "map" "mark" "marquee" "math" "menu" "menuitem" "meta" "meter" "multicol"
+	"nav" "nextid" "nobr" "noembed" "noframes" "noscript" "object" "ol" "optgroup" "option" "output" "p"
+	"param" "picture" "plaintext" "pre" "progress" "q" "rb" "rp" "rt" "rtc" "ruby" "s"
+	"samp" "script" "search" "section" "select" "slot" "small" "source" "spacer" "span" "strike" "strong"
+	"style" "sub" "summary" "sup" "svg" "table" "tbody" "td" "template" "textarea" "tfoot" "th"
+	"thead" "time" "title" "tr" "track" "tt" "u" "ul" "var" "video" "wbr" "xmp";
+
+static const unsigned short html_tag_name_offsets[HTML_TAG_ID_SIZE] = {
+	0, 1, 5, 12, 19, 25, 29, 36, 41, 46, 47, 51, 59, 62, 65, 72,
+	75, 80, 90, 94, 96, 102, 108, 115, 121, 125, 129, 132, 140, 144, 152, 154,
+	157, 164, 167, 173, 176, 179, 181, 183, 185, 190, 198, 208, 214, 218, 224, 228,
+	233, 241, 243, 245, 247, 249, 251, 253, 257, 263, 269, 271, 275, 276, 282, 287,
+	290, 295, 298, 305, 308, 314, 319, 325, 327, 331, 338, 342, 345, 349, 356, 360,
+	364, 372, 376, 381, 389, 392, 398, 402, 409, 417, 425, 431, 433, 441, 447, 453,
+	454, 459, 466, 475, 478, 486, 487, 489, 491, 493, 496, 500, 501, 505, 511, 517,
+	524, 530, 534, 539, 545, 551, 555, 561, 567, 572, 575, 582, 585, 588, 593, 598,
+	600, 608, 616, 621, 623, 628, 632, 637, 639, 644, 646, 647, 649, 652, 657, 660,
+	663
+};
+
+static const unsigned short html_tag_displacements[HTML_TAG_HASH_BUCKETS] = {
+	0, 2, 1, 4, 1, 6, 4, 4, 1, 1, 3, 7, 1, 8, 3, 12,
+	2, 1, 2, 1, 1, 1, 1, 1, 2, 1, 0, 5, 1, 0, 1, 4,
+	3, 4, 1, 0, 2, 1, 1, 3, 0, 5, 1, 1, 1, 2, 0, 1,
+	2, 3, 1, 2, 2, 1, 2, 1, 2, 1, 2, 4, 2, 1, 1, 1
+};
+
+static const unsigned short html_tag_slots[1 << HTML_TAG_HASH_BITS] = {
+	0, 0, 0, 0, 138, 63, 35, 129, 0, 0, 1, 0, 0, 41, 39, 18,
+	0, 0, 0, 44, 0, 10, 37, 50, 6, 40, 141, 114, 43, 61, 106, 113,
+	36, 30, 0, 73, 19, 12, 23, 99, 0, 0, 69, 0, 0, 45, 64, 102,
+	0, 0, 115, 0, 95, 0, 125, 89, 81, 0, 0, 0, 124, 0, 60, 0,
+	128, 126, 120, 13, 103, 135, 86, 9, 0, 127, 72, 55, 0, 131, 0, 0,
+	32, 0, 79, 83, 22, 110, 0, 68, 94, 0, 0, 17, 0, 59, 0, 4,
+	0, 65, 0, 78, 0, 87, 0, 0, 88, 25, 57, 0, 0, 52, 53, 0,
+	0, 0, 0, 0, 0, 130, 58, 0, 42, 49, 119, 0, 0, 0, 5, 0,
+	117, 0, 118, 33, 0, 0, 0, 21, 123, 71, 67, 142, 16, 136, 11, 134,
+	0, 38, 7, 0, 100, 112, 0, 70, 0, 0, 104, 62, 47, 0, 0, 0,
+	0, 0, 14, 0, 0, 48, 0, 0, 91, 93, 80, 143, 82, 0, 116, 0,
+	0, 109, 0, 0, 108, 96, 111, 0, 0, 56, 28, 77, 0, 27, 0, 0,
+	0, 0, 137, 0, 139, 0, 75, 20, 0, 0, 0, 0, 3, 92, 97, 0,
+	0, 54, 31, 140, 2, 0, 66, 0, 0, 101, 90, 133, 0, 29, 144, 0,
+	8, 0, 0, 0, 26, 15, 122, 46, 132, 84, 0, 121, 0, 74, 0, 0,
+	24, 85, 105, 51, 0, 0, 0, 107, 0, 0, 0, 0, 0, 34, 76, 98
+};
+
+#define HTML_ATTR_HASH_BITS 9
+#define HTML_ATTR_HASH_BUCKETS 128
+
+static const char html_attr_names[] =
+	"abbr" "accept" "accept-charset" "accesskey" "action" "align" "alink" "allow" "allowfullscreen" "alt" "archive" "async"
+	"autocapitalize" "autocomplete" "autofocus" "autoplay" "axis" "background" "bgcolor" "blocking" "border" "cellpadding" "cellspacing" "char"
+	"charoff" "charset" "checked" "cite" "class" "classid" "clear" "code" "codebase" "codetype" "color" "cols"
+	"colspan" "compact" "content" "contenteditable" "controls" "coords" "crossorigin" "data" "datetime" "declare" "decoding" "default"
+	"defer" "dir" "dirname" "disabled" "download" "draggable" "enctype" "enterkeyhint" "face" "fetchpriority" "for" "form"
+	"formaction" "formenctype" "formmethod" "formnovalidate" "formtarget" "frame" "frameborder" "headers" "height" "hidden" "high" "href"
+	"hreflang" "hspace" "http-equiv" "id" "inert" "inputmode" "integrity" "is" "ismap" "itemid" "itemprop" "itemref"
+	"itemscope" "itemtype" "kind" "label" "lang" "language" "link" "list" "loading" "longdesc" "loop" "low"
+	"marginheight" "marginwidth" "max" "maxlength" "media" "method" "min" "minlength" "multiple" "muted" "name" "nohref"
+	"nomodule" "nonce" "noshade" "novalidate" "nowrap" "onabort" "onafterprint" "onauxclick" "onbeforeinput" "onbeforeprint" "onbeforeunload" "onblur"
+	"oncancel" "oncanplay" "oncanplaythrough" "onchange" "onclick" "onclose" "oncontextmenu" "oncopy" "oncuechange" "oncut" "ondblclick" "ondrag"
+	"ondragend" "ondragenter" "ondragleave" "ondragover" "ondragstart" "ondrop" "ondurationchange" "onemptied" "onended" "onerror" "onfocus" "onformdata"
+	"onhashchange" "oninput" "oninvalid" "onkeydown" "onkeypress" "onkeyup" "onlanguagechange" "onload" "onloadeddata" "onloadedmetadata" "onloadstart" "onmessage"
+	"onmessageerror" "onmousedown" "onmouseenter" "onmouseleave" "onmousemove" "onmouseout" "onmouseover" "onmouseup" "onoffline" "ononline" "onpagehide" "onpageshow"
+	"onpaste" "onpause" "onplay" "onplaying" "onpopstate" "onprogress" "onratechange" "onrejectionhandled" "onreset" "onresize" "onscroll" "onscrollend"
+	"onsecuritypolicyviolation" "onseeked" "onseeking" "onselect" "onslotchange" "onstalled" "onstorage" "onsubmit" "onsuspend" "ontimeupdate" "ontoggle" "onunhandledrejection"
+	"onunload" "onvolumechange" "onwaiting" "onwheel" "open" "optimum" "pattern" "ping" "placeholder" "playsinline" "popover" "popovertarget"
+	"popovertargetaction" "poster" "preload" "profile" "readonly" "referrerpolicy" "rel" "required" "rev" "reversed" "role" "rows"
+	"rowspan" "rules" "sandbox" "scheme" "scope" "scrolling" "selected" "shadowrootmode" "shape" "size" "sizes" "slot"
+	"span" "spellcheck" "src" "srcdoc" "srclang" "srcset" "standby" "start" "step" "style" "summary" "tabindex"
+	"target" "text" "title" "translate" "type" "usemap" "valign" "value" "valuetype" "version" "vlink" "vspace"
+	"width" "wrap" "xmlns";
+
+static const unsigned short html_attr_name_offsets[HTML_ATTR_ID_SIZE] = {
+	0, 4, 10, 24, 33, 39, 44, 49, 54, 69, 72, 79, 84, 98, 110, 119,
+	127, 131, 141, 148, 156, 162, 173, 184, 188, 195, 202, 209, 213, 218, 225, 230,
+	234, 242, 250, 255, 259, 266, 273, 280, 295, 303, 309, 320, 324, 332, 339, 347,
+	354, 359, 362, 369, 377, 385, 394, 401, 413, 417, 430, 433, 437, 447, 458, 468,
+	482, 492, 497, 508, 515, 521, 527, 531, 535, 543, 549, 559, 561, 566, 575, 584,
+	586, 591, 597, 605, 612, 621, 629, 633, 638, 642, 650, 654, 658, 665, 673, 677,
+	680, 692, 703, 706, 715, 720, 726, 729, 738, 746, 751, 755, 761, 769, 774, 781,
+	791, 797, 804, 816, 826, 839, 852, 866, 872, 880, 889, 905, 913, 920, 927, 940,
+	946, 957, 962, 972, 978, 987, 998, 1009, 1019, 1030, 1036, 1052, 1061, 1068, 1075, 1082,
+	1092, 1104, 1111, 1120, 1129, 1139, 1146, 1162, 1168, 1180, 1196, 1207, 1216, 1230, 1241, 1253,
+	1265, 1276, 1286, 1297, 1306, 1315, 1323, 1333, 1343, 1350, 1357, 1363, 1372, 1382, 1392, 1404,
+	1422, 1429, 1437, 1445, 1456, 1481, 1489, 1498, 1506, 1518, 1527, 1536, 1544, 1553, 1565, 1573,
+	1593, 1601, 1615, 1624, 1631, 1635, 1642, 1649, 1653, 1664, 1675, 1682, 1695, 1714, 1720, 1727,
+	1734, 1742, 1756, 1759, 1767, 1770, 1778, 1782, 1786, 1793, 1798, 1805, 1811, 1816, 1825, 1833,
+	1847, 1852, 1856, 1861, 1865, 1869, 1879, 1882, 1888, 1895, 1901, 1908, 1913, 1917, 1922, 1929,
+	1937, 1943, 1947, 1952, 1961, 1965, 1971, 1977, 1982, 1991, 1998, 2003, 2009, 2014, 2018, 2023
+};
+
+static const unsigned short html_attr_displacements[HTML_ATTR_HASH_BUCKETS] = {
+	2, 1, 3, 2, 1, 2, 4, 2, 2, 1, 0, 5, 1, 1, 3, 2,
+	4, 1, 0, 2, 1, 1, 1, 3, 2, 3, 8, 2, 1, 1, 3, 1,
+	3, 3, 1, 5, 1, 1, 1, 8, 1, 2, 3, 2, 1, 0, 1, 4,
+	2, 0, 1, 3, 1, 0, 0, 1, 2, 4, 1, 1, 1, 1, 3, 3,
+	4, 1, 2, 2, 2, 1, 2, 2, 1, 4, 6, 0, 1, 3, 3, 1,
+	1, 0, 4, 3, 2, 3, 3, 1, 1, 5, 0, 2, 1, 1, 1, 1,
+	1, 1, 1, 0, 0, 0, 3, 1, 1, 1, 1, 4, 0, 1, 2, 0,
+	0, 1, 1, 3, 2, 1, 1, 2, 2, 2, 1, 2, 1, 2, 2, 4
+};
+
+static const unsigned short html_attr_slots[1 << HTML_ATTR_HASH_BITS] = {
+	0, 167, 204, 162, 247, 0, 180, 113, 0, 0, 74, 109, 234, 7, 142, 0,
+	118, 46, 0, 210, 55, 85, 0, 0, 0, 164, 103, 0, 0, 0, 135, 0,
+	34, 0, 139, 107, 0, 0, 0, 0, 0, 0, 0, 0, 0, 251, 81, 3,
+	174, 0, 0, 205, 0, 106, 0, 0, 0, 123, 0, 0, 248, 0, 86, 181,
+	50, 199, 0, 0, 0, 0, 41, 0, 0, 254, 5, 98, 216, 0, 52, 0,
+	0, 0, 0, 0, 0, 42, 208, 182, 0, 235, 0, 0, 0, 23, 0, 0,
+	69, 147, 151, 232, 0, 0, 170, 0, 96, 0, 56, 0, 29, 87, 0, 137,
+	0, 163, 48, 30, 0, 0, 67, 0, 0, 97, 24, 0, 100, 0, 0, 178,
+	211, 196, 131, 38, 194, 0, 198, 149, 0, 9, 0, 243, 0, 108, 0, 0,
+	0, 0, 129, 250, 59, 0, 0, 0, 0, 158, 0, 193, 22, 58, 0, 35,
+	0, 0, 0, 84, 0, 0, 0, 0, 17, 217, 0, 175, 184, 201, 0, 236,
+	0, 0, 0, 40, 0, 219, 206, 190, 62, 18, 0, 0, 8, 45, 225, 0,
+	0, 0, 68, 101, 244, 0, 159, 0, 177, 0, 0, 117, 124, 207, 0, 0,
+	0, 0, 28, 0, 192, 0, 70, 0, 0, 0, 0, 183, 31, 0, 82, 0,
+	90, 249, 0, 0, 0, 88, 0, 0, 0, 102, 0, 0, 0, 0, 73, 94,
+	36, 0, 0, 0, 0, 200, 0, 116, 212, 61, 4, 215, 0, 0, 19, 37,
+	20, 0, 0, 133, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 47,
+	141, 0, 0, 12, 13, 0, 0, 0, 0, 0, 77, 127, 0, 220, 15, 114,
+	0, 6, 185, 138, 253, 0, 0, 176, 0, 187, 237, 0, 0, 0, 195, 1,
+	223, 171, 53, 191, 0, 0, 89, 230, 242, 0, 155, 95, 0, 11, 21, 0,
+	111, 0, 0, 0, 0, 0, 54, 0, 0, 0, 0, 66, 0, 0, 0, 136,
+	229, 63, 0, 0, 0, 91, 188, 105, 0, 76, 122, 222, 0, 130, 238, 154,
+	0, 49, 110, 0, 0, 64, 221, 26, 0, 246, 121, 0, 0, 0, 148, 104,
+	0, 0, 78, 0, 0, 0, 79, 0, 0, 240, 0, 197, 202, 0, 0, 72,
+	143, 0, 169, 226, 0, 153, 0, 0, 0, 0, 126, 166, 75, 0, 0, 0,
+	0, 0, 213, 0, 92, 241, 83, 128, 0, 39, 161, 10, 65, 160, 0, 0,
+	0, 0, 0, 168, 0, 0, 203, 173, 0, 186, 93, 0, 112, 218, 0, 145,
+	0, 51, 60, 189, 0, 0, 0, 0, 144, 231, 0, 44, 209, 146, 228, 0,
+	0, 0, 0, 120, 0, 0, 0, 33, 0, 32, 16, 43, 80, 179, 14, 119,
+	227, 0, 156, 239, 140, 134, 71, 99, 0, 165, 0, 0, 0, 0, 27, 0,
+	0, 252, 0, 0, 0, 0, 224, 0, 152, 0, 150, 0, 157, 125, 0, 0,
+	172, 0, 245, 0, 25, 214, 0, 233, 0, 132, 57, 0, 255, 0, 115, 0
+};
@@ -0,0 +1,443 @@
+/*
+ *	HTML stream parser
+ *	Copyright (C) 2012 Michael Kowalczyk
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HTMLNAMES_H
+#define HTMLNAMES_H
+
+/*
+ * The standard HTML tag names, including
+ * the obsolete ones still found in the wild,
+ * as returned by html_parser_tag_id.
+ */
+enum html_tag_id {
+	HTML_TAG_ID_UNKNOWN,
+	HTML_TAG_ID_A,
+	HTML_TAG_ID_ABBR,
+	HTML_TAG_ID_ACRONYM,
+	HTML_TAG_ID_ADDRESS,
+	HTML_TAG_ID_APPLET,
+	HTML_TAG_ID_AREA,
+	HTML_TAG_ID_ARTICLE,
+	HTML_TAG_ID_ASIDE,
+	HTML_TAG_ID_AUDIO,
+	HTML_TAG_ID_B,
+	HTML_TAG_ID_BASE,
+	HTML_TAG_ID_BASEFONT,
+	HTML_TAG_ID_BDI,
+	HTML_TAG_ID_BDO,
+	HTML_TAG_ID_BGSOUND,
+	HTML_TAG_ID_BIG,
+	HTML_TAG_ID_BLINK,
+	HTML_TAG_ID_BLOCKQUOTE,
+	HTML_TAG_ID_BODY,
+	HTML_TAG_ID_BR,
+	HTML_TAG_ID_BUTTON,
+	HTML_TAG_ID_CANVAS,
+	HTML_TAG_ID_CAPTION,
+	HTML_TAG_ID_CENTER,
+	HTML_TAG_ID_CITE,
+	HTML_TAG_ID_CODE,
+	HTML_TAG_ID_COL,
+	HTML_TAG_ID_COLGROUP,
+	HTML_TAG_ID_DATA,
+	HTML_TAG_ID_DATALIST,
+	HTML_TAG_ID_DD,
+	HTML_TAG_ID_DEL,
+	HTML_TAG_ID_DETAILS,
+	HTML_TAG_ID_DFN,
+	HTML_TAG_ID_DIALOG,
+	HTML_TAG_ID_DIR,
+	HTML_TAG_ID_DIV,
+	HTML_TAG_ID_DL,
+	HTML_TAG_ID_DT,
+	HTML_TAG_ID_EM,
+	HTML_TAG_ID_EMBED,
+	HTML_TAG_ID_FIELDSET,
+	HTML_TAG_ID_FIGCAPTION,
+	HTML_TAG_ID_FIGURE,
+	HTML_TAG_ID_FONT,
+	HTML_TAG_ID_FOOTER,
+	HTML_TAG_ID_FORM,
+	HTML_TAG_ID_FRAME,
+	HTML_TAG_ID_FRAMESET,
+	HTML_TAG_ID_H1,
+	HTML_TAG_ID_H2,
+	HTML_TAG_ID_H3,
+	HTML_TAG_ID_H4,
+	HTML_TAG_ID_H5,
+	HTML_TAG_ID_H6,
+	HTML_TAG_ID_HEAD,
+	HTML_TAG_ID_HEADER,
+	HTML_TAG_ID_HGROUP,
+	HTML_TAG_ID_HR,
+	HTML_TAG_ID_HTML,
+	HTML_TAG_ID_I,
+	HTML_TAG_ID_IFRAME,
+	HTML_TAG_ID_IMAGE,
+	HTML_TAG_ID_IMG,
+	HTML_TAG_ID_INPUT,
+	HTML_TAG_ID_INS,
+	HTML_TAG_ID_ISINDEX,
+	HTML_TAG_ID_KBD,
+	HTML_TAG_ID_KEYGEN,
+	HTML_TAG_ID_LABEL,
+	HTML_TAG_ID_LEGEND,
+	HTML_TAG_ID_LI,
+	HTML_TAG_ID_LINK,
+	HTML_TAG_ID_LISTING,
+	HTML_TAG_ID_MAIN,
+	HTML_TAG_ID_MAP,
+	HTML_TAG_ID_MARK,
+	HTML_TAG_ID_MARQUEE,
+	HTML_TAG_ID_MATH,
+	HTML_TAG_ID_MENU,
+	HTML_TAG_ID_MENUITEM,
+	HTML_TAG_ID_META,
+	HTML_TAG_ID_METER,
+	HTML_TAG_ID_MULTICOL,
+	HTML_TAG_ID_NAV,
+	HTML_TAG_ID_NEXTID,
+	HTML_TAG_ID_NOBR,
+	HTML_TAG_ID_NOEMBED,
+	HTML_TAG_ID_NOFRAMES,
+	HTML_TAG_ID_NOSCRIPT,
+	HTML_TAG_ID_OBJECT,
+	HTML_TAG_ID_OL,
+	HTML_TAG_ID_OPTGROUP,
+	HTML_TAG_ID_OPTION,
+	HTML_TAG_ID_OUTPUT,
+	HTML_TAG_ID_P,
+	HTML_TAG_ID_PARAM,
+	HTML_TAG_ID_PICTURE,
+	HTML_TAG_ID_PLAINTEXT,
+	HTML_TAG_ID_PRE,
+	HTML_TAG_ID_PROGRESS,
+	HTML_TAG_ID_Q,
+	HTML_TAG_ID_RB,
+	HTML_TAG_ID_RP,
+	HTML_TAG_ID_RT,
+	HTML_TAG_ID_RTC,
+	HTML_TAG_ID_RUBY,
+	HTML_TAG_ID_S,
+	HTML_TAG_ID_SAMP,
+	HTML_TAG_ID_SCRIPT,
+	HTML_TAG_ID_SEARCH,
+	HTML_TAG_ID_SECTION,
+	HTML_TAG_ID_SELECT,
+	HTML_TAG_ID_SLOT,
+	HTML_TAG_ID_SMALL,
+	HTML_TAG_ID_SOURCE,
+	HTML_TAG_ID_SPACER,
+	HTML_TAG_ID_SPAN,
+	HTML_TAG_ID_STRIKE,
+	HTML_TAG_ID_STRONG,
+	HTML_TAG_ID_STYLE,
+	HTML_TAG_ID_SUB,
+	HTML_TAG_ID_SUMMARY,
+	HTML_TAG_ID_SUP,
+	HTML_TAG_ID_SVG,
+	HTML_TAG_ID_TABLE,
+	HTML_TAG_ID_TBODY,
+	HTML_TAG_ID_TD,
+	HTML_TAG_ID_TEMPLATE,
+	HTML_TAG_ID_TEXTAREA,
+	HTML_TAG_ID_TFOOT,
+	HTML_TAG_ID_TH,
+	HTML_TAG_ID_THEAD,
+	HTML_TAG_ID_TIME,
+	HTML_TAG_ID_TITLE,
+	HTML_TAG_ID_TR,
+	HTML_TAG_ID_TRACK,
+	HTML_TAG_ID_TT,
+	HTML_TAG_ID_U,
+	HTML_TAG_ID_UL,
+	HTML_TAG_ID_VAR,
+	HTML_TAG_ID_VIDEO,
+	HTML_TAG_ID_WBR,
+	HTML_TAG_ID_XMP
+};
+
+#define HTML_TAG_ID_SIZE 145
+
+/*
+ * The standard HTML attribute names, including
+ * the event handlers and the obsolete presentational
+ * ones, as returned by html_parser_attr_id.
+ */
+enum html_attr_id {
+	HTML_ATTR_ID_UNKNOWN,
+	HTML_ATTR_ID_ABBR,
+	HTML_ATTR_ID_ACCEPT,
+	HTML_ATTR_ID_ACCEPT_CHARSET,
+	HTML_ATTR_ID_ACCESSKEY,
+	HTML_ATTR_ID_ACTION,
+	HTML_ATTR_ID_ALIGN,
+	HTML_ATTR_ID_ALINK,
+	HTML_ATTR_ID_ALLOW,
+	HTML_ATTR_ID_ALLOWFULLSCREEN,
+	HTML_ATTR_ID_ALT,
+	HTML_ATTR_ID_ARCHIVE,
+	HTML_ATTR_ID_ASYNC,
+	HTML_ATTR_ID_AUTOCAPITALIZE,
+	HTML_ATTR_ID_AUTOCOMPLETE,
+	HTML_ATTR_ID_AUTOFOCUS,
+	HTML_ATTR_ID_AUTOPLAY,
+	HTML_ATTR_ID_AXIS,
+	HTML_ATTR_ID_BACKGROUND,
+	HTML_ATTR_ID_BGCOLOR,
+	HTML_ATTR_ID_BLOCKING,
+	HTML_ATTR_ID_BORDER,
+	HTML_ATTR_ID_CELLPADDING,
+	HTML_ATTR_ID_CELLSPACING,
+	HTML_ATTR_ID_CHAR,
+	HTML_ATTR_ID_CHAROFF,
+	HTML_ATTR_ID_CHARSET,
+	HTML_ATTR_ID_CHECKED,
+	HTML_ATTR_ID_CITE,
+	HTML_ATTR_ID_CLASS,
+	HTML_ATTR_ID_CLASSID,
+	HTML_ATTR_ID_CLEAR,
+	HTML_ATTR_ID_CODE,
+	HTML_ATTR_ID_CODEBASE,
+	HTML_ATTR_ID_CODETYPE,
+	HTML_ATTR_ID_COLOR,
+	HTML_ATTR_ID_COLS,
+	HTML_ATTR_ID_COLSPAN,
+	HTML_ATTR_ID_COMPACT,
+	HTML_ATTR_ID_CONTENT,
+	HTML_ATTR_ID_CONTENTEDITABLE,
+	HTML_ATTR_ID_CONTROLS,
+	HTML_ATTR_ID_COORDS,
+	HTML_ATTR_ID_CROSSORIGIN,
+	HTML_ATTR_ID_DATA,
+	HTML_ATTR_ID_DATETIME,
+	HTML_ATTR_ID_DECLARE,
+	HTML_ATTR_ID_DECODING,
+	HTML_ATTR_ID_DEFAULT,
+	HTML_ATTR_ID_DEFER,
+	HTML_ATTR_ID_DIR,
+	HTML_ATTR_ID_DIRNAME,
+	HTML_ATTR_ID_DISABLED,
+	HTML_ATTR_ID_DOWNLOAD,
+	HTML_ATTR_ID_DRAGGABLE,
+	HTML_ATTR_ID_ENCTYPE,
+	HTML_ATTR_ID_ENTERKEYHINT,
+	HTML_ATTR_ID_FACE,
+	HTML_ATTR_ID_FETCHPRIORITY,
+	HTML_ATTR_ID_FOR,
+	HTML_ATTR_ID_FORM,
+	HTML_ATTR_ID_FORMACTION,
+	HTML_ATTR_ID_FORMENCTYPE,
+	HTML_ATTR_ID_FORMMETHOD,
+	HTML_ATTR_ID_FORMNOVALIDATE,
+	HTML_ATTR_ID_FORMTARGET,
+	HTML_ATTR_ID_FRAME,
+	HTML_ATTR_ID_FRAMEBORDER,
+	HTML_ATTR_ID_HEADERS,
+	HTML_ATTR_ID_HEIGHT,
+	HTML_ATTR_ID_HIDDEN,
+	HTML_ATTR_ID_HIGH,
+	HTML_ATTR_ID_HREF,
+	HTML_ATTR_ID_HREFLANG,
+	HTML_ATTR_ID_HSPACE,
+	HTML_ATTR_ID_HTTP_EQUIV,
+	HTML_ATTR_ID_ID,
+	HTML_ATTR_ID_INERT,
+	HTML_ATTR_ID_INPUTMODE,
+	HTML_ATTR_ID_INTEGRITY,
+	HTML_ATTR_ID_IS,
+	HTML_ATTR_ID_ISMAP,
+	HTML_ATTR_ID_ITEMID,
+	HTML_ATTR_ID_ITEMPROP,
+	HTML_ATTR_ID_ITEMREF,
+	HTML_ATTR_ID_ITEMSCOPE,
+	HTML_ATTR_ID_ITEMTYPE,
+	HTML_ATTR_ID_KIND,
+	HTML_ATTR_ID_LABEL,
+	HTML_ATTR_ID_LANG,
+	HTML_ATTR_ID_LANGUAGE,
+	HTML_ATTR_ID_LINK,
+	HTML_ATTR_ID_LIST,
+	HTML_ATTR_ID_LOADING,
+	HTML_ATTR_ID_LONGDESC,
+	HTML_ATTR_ID_LOOP,
+	HTML_ATTR_ID_LOW,
+	HTML_ATTR_ID_MARGINHEIGHT,
+	HTML_ATTR_ID_MARGINWIDTH,
+	HTML_ATTR_ID_MAX,
+	HTML_ATTR_ID_MAXLENGTH,
+	HTML_ATTR_ID_MEDIA,
+	HTML_ATTR_ID_METHOD,
+	HTML_ATTR_ID_MIN,
+	HTML_ATTR_ID_MINLENGTH,
+	HTML_ATTR_ID_MULTIPLE,
+	HTML_ATTR_ID_MUTED,
+	HTML_ATTR_ID_NAME,
+	HTML_ATTR_ID_NOHREF,
+	HTML_ATTR_ID_NOMODULE,
+	HTML_ATTR_ID_NONCE,
+	HTML_ATTR_ID_NOSHADE,
+	HTML_ATTR_ID_NOVALIDATE,
+	HTML_ATTR_ID_NOWRAP,
+	HTML_ATTR_ID_ONABORT,
+	HTML_ATTR_ID_ONAFTERPRINT,
+	HTML_ATTR_ID_ONAUXCLICK,
+	HTML_ATTR_ID_ONBEFOREINPUT,
+	HTML_ATTR_ID_ONBEFOREPRINT,
+	HTML_ATTR_ID_ONBEFOREUNLOAD,
+	HTML_ATTR_ID_ONBLUR,
+	HTML_ATTR_ID_ONCANCEL,
+	HTML_ATTR_ID_ONCANPLAY,
+	HTML_ATTR_ID_ONCANPLAYTHROUGH,
+	HTML_ATTR_ID_ONCHANGE,
+	HTML_ATTR_ID_ONCLICK,
+	HTML_ATTR_ID_ONCLOSE,
+	HTML_ATTR_ID_ONCONTEXTMENU,
+	HTML_ATTR_ID_ONCOPY,
+	HTML_ATTR_ID_ONCUECHANGE,
+	HTML_ATTR_ID_ONCUT,
+	HTML_ATTR_ID_ONDBLCLICK,
+	HTML_ATTR_ID_ONDRAG,
+	HTML_ATTR_ID_ONDRAGEND,
+	HTML_ATTR_ID_ONDRAGENTER,
+	HTML_ATTR_ID_ONDRAGLEAVE,
+	HTML_ATTR_ID_ONDRAGOVER,
+	HTML_ATTR_ID_ONDRAGSTART,
+	HTML_ATTR_ID_ONDROP,
+	HTML_ATTR_ID_ONDURATIONCHANGE,
+	HTML_ATTR_ID_ONEMPTIED,
+	HTML_ATTR_ID_ONENDED,
+	HTML_ATTR_ID_ONERROR,
+	HTML_ATTR_ID_ONFOCUS,
+	HTML_ATTR_ID_ONFORMDATA,
+	HTML_ATTR_ID_ONHASHCHANGE,
+	HTML_ATTR_ID_ONINPUT,
+	HTML_ATTR_ID_ONINVALID,
+	HTML_ATTR_ID_ONKEYDOWN,
+	HTML_ATTR_ID_ONKEYPRESS,
+	HTML_ATTR_ID_ONKEYUP,
+	HTML_ATTR_ID_ONLANGUAGECHANGE,
+	HTML_ATTR_ID_ONLOAD,
+	HTML_ATTR_ID_ONLOADEDDATA,
+	HTML_ATTR_ID_ONLOADEDMETADATA,
+	HTML_ATTR_ID_ONLOADSTART,
+	HTML_ATTR_ID_ONMESSAGE,
+	HTML_ATTR_ID_ONMESSAGEERROR,
+	HTML_ATTR_ID_ONMOUSEDOWN,
+	HTML_ATTR_ID_ONMOUSEENTER,
+	HTML_ATTR_ID_ONMOUSELEAVE,
+	HTML_ATTR_ID_ONMOUSEMOVE,
+	HTML_ATTR_ID_ONMOUSEOUT,
+	HTML_ATTR_ID_ONMOUSEOVER,
+	HTML_ATTR_ID_ONMOUSEUP,
+	HTML_ATTR_ID_ONOFFLINE,
+	HTML_ATTR_ID_ONONLINE,
+	HTML_ATTR_ID_ONPAGEHIDE,
+	HTML_ATTR_ID_ONPAGESHOW,
+	HTML_ATTR_ID_ONPASTE,
+	HTML_ATTR_ID_ONPAUSE,
+	HTML_ATTR_ID_ONPLAY,
+	HTML_ATTR_ID_ONPLAYING,
+	HTML_ATTR_ID_ONPOPSTATE,
+	HTML_ATTR_ID_ONPROGRESS,
+	HTML_ATTR_ID_ONRATECHANGE,
+	HTML_ATTR_ID_ONREJECTIONHANDLED,
+	HTML_ATTR_ID_ONRESET,
+	HTML_ATTR_ID_ONRESIZE,
+	HTML_ATTR_ID_ONSCROLL,
+	HTML_ATTR_ID_ONSCROLLEND,
+	HTML_ATTR_ID_ONSECURITYPOLICYVIOLATION,
+	HTML_ATTR_ID_ONSEEKED,
+	HTML_ATTR_ID_ONSEEKING,
+	HTML_ATTR_ID_ONSELECT,
+	HTML_ATTR_ID_ONSLOTCHANGE,
+	HTML_ATTR_ID_ONSTALLED,
+	HTML_ATTR_ID_ONSTORAGE,
+	HTML_ATTR_ID_ONSUBMIT,
+	HTML_ATTR_ID_ONSUSPEND,
+	HTML_ATTR_ID_ONTIMEUPDATE,
+	HTML_ATTR_ID_ONTOGGLE,
+	HTML_ATTR_ID_ONUNHANDLEDREJECTION,
+	HTML_ATTR_ID_ONUNLOAD,
+	HTML_ATTR_ID_ONVOLUMECHANGE,
+	HTML_ATTR_ID_ONWAITING,
+	HTML_ATTR_ID_ONWHEEL,
+	HTML_ATTR_ID_OPEN,
+	HTML_ATTR_ID_OPTIMUM,
+	HTML_ATTR_ID_PATTERN,
+	HTML_ATTR_ID_PING,
+	HTML_ATTR_ID_PLACEHOLDER,
+	HTML_ATTR_ID_PLAYSINLINE,
+	HTML_ATTR_ID_POPOVER,
+	HTML_ATTR_ID_POPOVERTARGET,
+	HTML_ATTR_ID_POPOVERTARGETACTION,
+	HTML_ATTR_ID_POSTER,
+	HTML_ATTR_ID_PRELOAD,
+	HTML_ATTR_ID_PROFILE,
+	HTML_ATTR_ID_READONLY,
+	HTML_ATTR_ID_REFERRERPOLICY,
+	HTML_ATTR_ID_REL,
+	HTML_ATTR_ID_REQUIRED,
+	HTML_ATTR_ID_REV,
+	HTML_ATTR_ID_REVERSED,
+	HTML_ATTR_ID_ROLE,
+	HTML_ATTR_ID_ROWS,
+	HTML_ATTR_ID_ROWSPAN,
+	HTML_ATTR_ID_RULES,
+	HTML_ATTR_ID_SANDBOX,
+	HTML_ATTR_ID_SCHEME,
+	HTML_ATTR_ID_SCOPE,
+	HTML_ATTR_ID_SCROLLING,
+	HTML_ATTR_ID_SELECTED,
+	HTML_ATTR_ID_SHADOWROOTMODE,
+	HTML_ATTR_ID_SHAPE,
+	HTML_ATTR_ID_SIZE,
+	HTML_ATTR_ID_SIZES,
+	HTML_ATTR_ID_SLOT,
+	HTML_ATTR_ID_SPAN,
+	HTML_ATTR_ID_SPELLCHECK,
+	HTML_ATTR_ID_SRC,
+	HTML_ATTR_ID_SRCDOC,
+	HTML_ATTR_ID_SRCLANG,
+	HTML_ATTR_ID_SRCSET,
+	HTML_ATTR_ID_STANDBY,
+	HTML_ATTR_ID_START,
+	HTML_ATTR_ID_STEP,
+	HTML_ATTR_ID_STYLE,
+	HTML_ATTR_ID_SUMMARY,
+	HTML_ATTR_ID_TABINDEX,
+	HTML_ATTR_ID_TARGET,
+	HTML_ATTR_ID_TEXT,
+	HTML_ATTR_ID_TITLE,
+	HTML_ATTR_ID_TRANSLATE,
+	HTML_ATTR_ID_TYPE,
+	HTML_ATTR_ID_USEMAP,
+	HTML_ATTR_ID_VALIGN,
+	HTML_ATTR_ID_VALUE,
+	HTML_ATTR_ID_VALUETYPE,
+	HTML_ATTR_ID_VERSION,
+	HTML_ATTR_ID_VLINK,
+	HTML_ATTR_ID_VSPACE,
+	HTML_ATTR_ID_WIDTH,
+	HTML_ATTR_ID_WRAP,
+	HTML_ATTR_ID_XMLNS
+};
+
+#define HTML_ATTR_ID_SIZE 256
+
+#endif
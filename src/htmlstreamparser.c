@@ -16,11 +16,90 @@
  *	along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
+#include <limits.h>
 #include <htmlstreamparser.h>
+#include "htmlentities.h"
+#include "htmlnamehash.h"
+#include "htmlcharsets.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#ifdef __GNUC__
+#define HTML_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define HTML_ALWAYS_INLINE inline
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <dirent.h>
+#include <time.h>
+#endif
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#define HTML_PARSER_ZLIB
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#define HTML_PARSER_EPOLL
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_SYS_MMAN_H)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#define HTML_PARSER_IO_URING
+#endif
+#endif
+
+/*
+ * The ASCII classes, not depending on the locale
+ * like the ctype functions do.
+ */
+static inline int html_parser_tolower(int c) { return c >= 'A' && c <= 'Z' ? c + 32 : c; }
+
+static inline int html_parser_isdigit(int c) { return c >= '0' && c <= '9'; }
+
+static inline int html_parser_isxdigit(int c) { return html_parser_isdigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+static inline int html_parser_isalnum(int c) { return html_parser_isdigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+/*
+ * Writes the code point c as UTF-8 to the chars
+ * pointed by q and returns their number.
+ */
+static inline int html_parser_utf8_put(char *q, unsigned long c) {
+	if (c < 0x80) { q[0] = c; return 1; }
+	if (c < 0x800) { q[0] = 0xc0 | c >> 6; q[1] = 0x80 | (c & 0x3f); return 2; }
+	if (c < 0x10000) { q[0] = 0xe0 | c >> 12; q[1] = 0x80 | (c >> 6 & 0x3f); q[2] = 0x80 | (c & 0x3f); return 3; }
+	q[0] = 0xf0 | c >> 18; q[1] = 0x80 | (c >> 12 & 0x3f); q[2] = 0x80 | (c >> 6 & 0x3f); q[3] = 0x80 | (c & 0x3f);
+	return 4;
+}
+
+// chooses the step and the tokenizer for the configuration
+static void html_parser_configure(HTMLSTREAMPARSER *hsp);
 
 HTMLSTREAMPARSER *html_parser_reset(HTMLSTREAMPARSER *hsp) {
-	memset(hsp->html_part, 0, HTML_PART_SIZE);
+	hsp->html_part = 0;
 	hsp->parser_state = 0;
 	hsp->tag_name_max_len = 0;
 	hsp->attr_name_max_len = 0;
@@ -38,229 +117,4830 @@ HTMLSTREAMPARSER *html_parser_reset(HTMLSTREAMPARSER *hsp) {
 	hsp->attr_name = NULL;
 	hsp->attr_value = NULL;
 	hsp->inner_text = NULL;
+	hsp->comment = NULL;
+	hsp->comment_len = 0;
+	hsp->comment_real_len = 0;
+	hsp->comment_max_len = 0;
 	hsp->tag_name_to_lower = 0;
 	hsp->attr_name_to_lower = 0;
 	hsp->attr_val_to_lower = 0;
-	hsp->script_equality_len = 0;
+	hsp->inner_text_collapse = 0;
+	hsp->inner_text_space = 0;
+	hsp->decode_entities = 0;
+	hsp->entity_len = 0;
+	hsp->raw = 0;
+	hsp->held_len = 0;
+	hsp->callbacks = NULL;
+	hsp->user = NULL;
+	memset(hsp->span, 0, sizeof(hsp->span));
+	hsp->script_len = 0;
+	hsp->carry = NULL;
+	hsp->carry_len = 0;
+	hsp->carry_max_len = 0;
+	hsp->text_arena = NULL;
+	hsp->text_arena_len = 0;
+	hsp->tag_arena = NULL;
+	hsp->tag_arena_len = 0;
+	hsp->arena_len = 0;
+	hsp->arena_max_len = 0;
+	hsp->arena_tail = 0;
+	hsp->attr_list = NULL;
+	hsp->attr_list_len = 0;
+	hsp->attr_list_max_len = 0;
+	hsp->attr_pool = NULL;
+	hsp->attr_pool_len = 0;
+	hsp->attr_pool_max_len = 0;
+	hsp->attr_pending = 0;
+	hsp->attr_value_begin = 0;
+	hsp->interest = NULL;
+	hsp->interest_tag = HTML_TAG_ID_UNKNOWN;
+	hsp->skip_text = 0;
+	hsp->skip_attr = 0;
+	hsp->skip_value = 0;
+	hsp->inflate = NULL;
+	hsp->charset = NULL;
+	hsp->links = NULL;
+	hsp->visible = NULL;
+	hsp->tape = NULL;
+	html_parser_configure(hsp);
+	html_parser_reset_stats(hsp);
 	return hsp;
 }
 
 HTMLSTREAMPARSER *html_parser_init() { return html_parser_reset((HTMLSTREAMPARSER *) malloc(sizeof(HTMLSTREAMPARSER))); }
 
-void html_parser_cleanup(HTMLSTREAMPARSER *hsp) { free(hsp); }
+void html_parser_cleanup(HTMLSTREAMPARSER *hsp) { html_parser_release_callbacks(hsp); html_parser_release_arena(hsp); html_parser_release_inflate(hsp); html_parser_release_charset(hsp); html_parser_release_links(hsp); html_parser_release_visible_text(hsp); html_parser_release_tape(hsp); free(hsp); }
+
+int ishtmlspace(char chr) { return ((chr == ' ' || chr == '\t' || chr == '\n' || chr == '\r')); }
+
+#if defined(__SSE2__)
+/*
+ * Returns the mask of the HTML spaces among the 16 chars
+ * of v and sets s to v having them replaced by ' '.
+ */
+static inline unsigned int html_parser_space_mask(__m128i v, __m128i *s) {
+	const __m128i sp = _mm_set1_epi8(' ');
+	__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+		_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+	if (s) *s = _mm_or_si128(_mm_andnot_si128(m, v), _mm_and_si128(m, sp));
+	return _mm_movemask_epi8(m);
+}
+#endif
+
+/*
+ * Appends the chars from p to end to the buffer dst of the
+ * length len and max length max_len, collapsing the runs of
+ * spaces into one ' '. A space is only written before the next
+ * char, until then space is set. The spaces at the beginning
+ * of the buffer are dropped when trim is set. Returns the new
+ * length, lost is set if a char does not fit. The dst can be
+ * p itself as the chars are never moved forward.
+ */
+static size_t html_parser_collapse_chars(char *dst, size_t len, size_t max_len, const char *p, const char *end, char *space, char trim, char *lost) {
+	for (; p < end; p++) {
+		if (ishtmlspace(*p)) {
+			if (len < max_len) *space = len || !trim;
+			continue;
+		}
+		if (len == max_len || (*space && len + 1 == max_len)) {
+			// the buffer is full, the rest is lost
+			if (*space && len < max_len) dst[len++] = ' ';
+			*space = 0;
+			*lost = 1;
+			return len;
+		}
+		if (*space) dst[len++] = ' ';
+		*space = 0;
+		dst[len++] = *p;
+	}
+	return len;
+}
 
-inline int ishtmlspace(char chr) { return ((chr == ' ' || chr == '\t' || chr == '\n' || chr == '\r')); }
+/*
+ * The same taking the blocks of 16 chars having no two
+ * spaces in a row as a whole.
+ */
+static size_t html_parser_collapse(char *dst, size_t len, size_t max_len, const char *p, size_t n, char *space, char trim, char *lost) {
+	const char *end = p + n;
+#if defined(__SSE2__)
+	__m128i s;
+	unsigned int m;
+	for (; end - p >= 16 && max_len - len > 16; p += 16) {
+		m = html_parser_space_mask(_mm_loadu_si128((const __m128i *) p), &s);
+		if (m == 0xffff) *space = len || !trim;
+		else if (m & m >> 1 || (m & 1 && !len && trim)) len = html_parser_collapse_chars(dst, len, max_len, p, p + 16, space, trim, lost);
+		else {
+			if (*space && !(m & 1)) dst[len++] = ' ';
+			_mm_storeu_si128((__m128i *) (dst + len), s);
+			len += 16;
+			*space = m >> 15;
+			len -= *space;
+		}
+	}
+#endif
+	return html_parser_collapse_chars(dst, len, max_len, p, end, space, trim, lost);
+}
 
-char *html_parser_rtrim(char *src, size_t *len) { while (ishtmlspace(src[(*len)-1]) && *len > 0) { (*len)--; } return src; }
+char *html_parser_rtrim(char *src, size_t *len) {
+#if defined(__SSE2__)
+	unsigned int m;
+	while (*len >= 16) {
+		m = html_parser_space_mask(_mm_loadu_si128((const __m128i *) (src + *len - 16)), NULL);
+		if (m != 0xffff) {
+			*len -= __builtin_clz(~m & 0xffff) - 16;
+			return src;
+		}
+		*len -= 16;
+	}
+#endif
+	while (*len > 0 && ishtmlspace(src[*len - 1])) (*len)--;
+	return src;
+}
 
-char *html_parser_ltrim(char *src, size_t *len) { while (ishtmlspace(*src) && *len > 0) { src++; (*len)--; } return src; }
+char *html_parser_ltrim(char *src, size_t *len) {
+#if defined(__SSE2__)
+	unsigned int m;
+	while (*len >= 16) {
+		m = html_parser_space_mask(_mm_loadu_si128((const __m128i *) src), NULL);
+		if (m != 0xffff) {
+			*len -= __builtin_ctz(~m);
+			return src + __builtin_ctz(~m);
+		}
+		src += 16;
+		*len -= 16;
+	}
+#endif
+	while (*len > 0 && ishtmlspace(*src)) { src++; (*len)--; }
+	return src;
+}
 
 char *html_parser_trim(char *src, size_t *len) { return html_parser_rtrim(html_parser_ltrim(src, len), len); }
 
 char *html_parser_replace_spaces(char *src, size_t *len) {
-	char ws = 1;
-	size_t i = 0, l = 0;
-	while (i < *len) {
-		if (!ishtmlspace(src[i])) {
-			src[l++] = src[i];
-			ws = 1;
-		} else if (ws) {
-			src[l++] = ' ';
-			ws = 0;
-		}
-		i++;
-	}
+	char space = 0, lost = 0;
+	size_t l = html_parser_collapse(src, 0, *len, src, *len, &space, 0, &lost);
+	// the last space is pending
+	if (space) src[l++] = ' ';
 	*len = l;
 	return src;
 }
 
-int html_parser_is_in(HTMLSTREAMPARSER *hsp, int html_part) { if (html_part >= 0 && html_part < HTML_PART_SIZE) return hsp->html_part[html_part]; else return 0; }
+/*
+ * The parser is a DFA. A char is mapped to its class
+ * and the pair of the current state and the class selects
+ * the next state and an action. The action clears and sets
+ * the HTML part bits and selects the buffer the char goes to.
+ */
 
-void html_parser_char_parse(HTMLSTREAMPARSER *hsp, const char c) {
-	char *s = &hsp->parser_state, *h = hsp->html_part, *l = &hsp->script_equality_len;
-	const char script[] = "script";
-	if (*s == 0 && *l == 6) { *s = 10; memset(h, 0, HTML_PART_SIZE); h[HTML_SCRIPT] = 1; }
-	switch (*s) {
-		case 0: // inside the inner text
-			if (c == '<') { *s = 1; memset(h, 0, HTML_PART_SIZE); h[HTML_TAG] = 1; h[HTML_TAG_BEGINNING] = 1; }
-			else {
-				if (!h[HTML_INNER_TEXT]) {
-					memset(h, 0, HTML_PART_SIZE); h[HTML_INNER_TEXT] = 1; h[HTML_INNER_TEXT_BEGINNING] = 1;
-				} else h[HTML_INNER_TEXT_BEGINNING] = 0;
-			}
+enum {
+	HTML_CLASS_OTHER,
+	HTML_CLASS_ALPHA,
+	HTML_CLASS_LT,
+	HTML_CLASS_GT,
+	HTML_CLASS_SLASH,
+	HTML_CLASS_BANG,
+	HTML_CLASS_EQUALITY,
+	HTML_CLASS_DQ,
+	HTML_CLASS_SQ,
+	HTML_CLASS_SPACE,
+	HTML_CLASS_DASH,
+	HTML_CLASS_BRACKET,
+	HTML_CLASS_QUESTION,
+	HTML_CLASS_SIZE
+};
+
+static const unsigned char html_parser_classes[256] = {
+	['<'] = HTML_CLASS_LT, ['>'] = HTML_CLASS_GT, ['/'] = HTML_CLASS_SLASH, ['!'] = HTML_CLASS_BANG,
+	['='] = HTML_CLASS_EQUALITY, ['"'] = HTML_CLASS_DQ, ['\''] = HTML_CLASS_SQ,
+	[' '] = HTML_CLASS_SPACE, ['\t'] = HTML_CLASS_SPACE, ['\n'] = HTML_CLASS_SPACE, ['\r'] = HTML_CLASS_SPACE,
+	['-'] = HTML_CLASS_DASH, [']'] = HTML_CLASS_BRACKET, ['?'] = HTML_CLASS_QUESTION,
+	['a'] = HTML_CLASS_ALPHA, ['b'] = HTML_CLASS_ALPHA, ['c'] = HTML_CLASS_ALPHA, ['d'] = HTML_CLASS_ALPHA, ['e'] = HTML_CLASS_ALPHA,
+	['f'] = HTML_CLASS_ALPHA, ['g'] = HTML_CLASS_ALPHA, ['h'] = HTML_CLASS_ALPHA, ['i'] = HTML_CLASS_ALPHA, ['j'] = HTML_CLASS_ALPHA,
+	['k'] = HTML_CLASS_ALPHA, ['l'] = HTML_CLASS_ALPHA, ['m'] = HTML_CLASS_ALPHA, ['n'] = HTML_CLASS_ALPHA, ['o'] = HTML_CLASS_ALPHA,
+	['p'] = HTML_CLASS_ALPHA, ['q'] = HTML_CLASS_ALPHA, ['r'] = HTML_CLASS_ALPHA, ['s'] = HTML_CLASS_ALPHA, ['t'] = HTML_CLASS_ALPHA,
+	['u'] = HTML_CLASS_ALPHA, ['v'] = HTML_CLASS_ALPHA, ['w'] = HTML_CLASS_ALPHA, ['x'] = HTML_CLASS_ALPHA, ['y'] = HTML_CLASS_ALPHA,
+	['z'] = HTML_CLASS_ALPHA,
+	['A'] = HTML_CLASS_ALPHA, ['B'] = HTML_CLASS_ALPHA, ['C'] = HTML_CLASS_ALPHA, ['D'] = HTML_CLASS_ALPHA, ['E'] = HTML_CLASS_ALPHA,
+	['F'] = HTML_CLASS_ALPHA, ['G'] = HTML_CLASS_ALPHA, ['H'] = HTML_CLASS_ALPHA, ['I'] = HTML_CLASS_ALPHA, ['J'] = HTML_CLASS_ALPHA,
+	['K'] = HTML_CLASS_ALPHA, ['L'] = HTML_CLASS_ALPHA, ['M'] = HTML_CLASS_ALPHA, ['N'] = HTML_CLASS_ALPHA, ['O'] = HTML_CLASS_ALPHA,
+	['P'] = HTML_CLASS_ALPHA, ['Q'] = HTML_CLASS_ALPHA, ['R'] = HTML_CLASS_ALPHA, ['S'] = HTML_CLASS_ALPHA, ['T'] = HTML_CLASS_ALPHA,
+	['U'] = HTML_CLASS_ALPHA, ['V'] = HTML_CLASS_ALPHA, ['W'] = HTML_CLASS_ALPHA, ['X'] = HTML_CLASS_ALPHA, ['Y'] = HTML_CLASS_ALPHA,
+	['Z'] = HTML_CLASS_ALPHA
+};
+
+enum {
+	HTML_STATE_START,         // right after a tag, the inner text is not started
+	HTML_STATE_TEXT,          // inside the inner text
+	HTML_STATE_SCRIPT_START,  // right after the start tag of a raw text element
+	HTML_STATE_TAG,           // tag beginning
+	HTML_STATE_NAME,          // inside a tag name
+	HTML_STATE_SPACE,         // tag space
+	HTML_STATE_ATTRIBUTE,     // inside an attribute name
+	HTML_STATE_EQUALITY,      // before an attribute value
+	HTML_STATE_DQ_START,      // before the first char of a value surrounded by double quotes
+	HTML_STATE_DQ,            // inside a value surrounded by double quotes
+	HTML_STATE_SQ,            // inside a value surrounded by single quotes
+	HTML_STATE_UNQUOTED,      // inside a value not surrounded by quotes
+	HTML_STATE_SCRIPT_SPACE,  // the same states inside the start tag of a raw text element
+	HTML_STATE_SCRIPT_ATTRIBUTE,
+	HTML_STATE_SCRIPT_EQUALITY,
+	HTML_STATE_SCRIPT_DQ_START,
+	HTML_STATE_SCRIPT_DQ,
+	HTML_STATE_SCRIPT_SQ,
+	HTML_STATE_SCRIPT_UNQUOTED,
+	HTML_STATE_DECLARATION,   // after "<!", the chars are held back until the declaration is known
+	HTML_STATE_COMMENT_START, // right after "<!--"
+	HTML_STATE_COMMENT_START_DASH,
+	HTML_STATE_COMMENT,       // inside a comment
+	HTML_STATE_COMMENT_DASH,  // after '-' inside a comment, the dashes are held back
+	HTML_STATE_COMMENT_DASH_DASH,
+	HTML_STATE_COMMENT_DASH_BANG,
+	HTML_STATE_BOGUS,         // inside a "<!" declaration taken as a comment
+	HTML_STATE_DOCTYPE,       // inside a doctype
+	HTML_STATE_PI,            // inside a processing instruction
+	HTML_STATE_CDATA,         // inside a CDATA section
+	HTML_STATE_CDATA_BRACKET, // after ']' inside a CDATA section, the brackets are held back
+	HTML_STATE_CDATA_BRACKETS,
+	HTML_STATE_SCRIPT,        // searching script end
+	HTML_STATE_SCRIPT_LT,     // after '<' inside a script
+	HTML_STATE_RAW,           // inside the text of a raw text element other than script
+	HTML_STATE_RAW_LT,        // after '<' inside the text, the chars from '<' are held back
+	HTML_STATE_RAW_NAME,      // inside the name after "</" inside the text matching the element name
+	HTML_STATE_SCRIPT_NAME,   // inside the name after "</" inside a script, hides the tag name
+	HTML_STATE_SIZE
+};
+
+enum {
+	HTML_CAPTURE_NONE,
+	HTML_CAPTURE_TEXT,
+	HTML_CAPTURE_TEXT_RESET,
+	HTML_CAPTURE_TAG,
+	HTML_CAPTURE_TAG_RESET,
+	HTML_CAPTURE_ATTRIBUTE,
+	HTML_CAPTURE_ATTRIBUTE_RESET,
+	HTML_CAPTURE_VALUE,
+	HTML_CAPTURE_VALUE_RESET,
+	HTML_CAPTURE_RAW_TEXT,
+	HTML_CAPTURE_RAW_TEXT_RESET,
+	HTML_CAPTURE_RAW_LT,
+	HTML_CAPTURE_RAW_LT_RESET,
+	HTML_CAPTURE_RAW_NAME,
+	HTML_CAPTURE_RAW_FLUSH,
+	HTML_CAPTURE_RAW_FLUSH_LT,
+	HTML_CAPTURE_RAW_TAG,
+	HTML_CAPTURE_COMMENT,
+	HTML_CAPTURE_COMMENT_RESET,
+	HTML_CAPTURE_HOLD,
+	HTML_CAPTURE_DROP,
+	HTML_CAPTURE_FLUSH,
+	HTML_CAPTURE_FLUSH_HOLD,
+	HTML_CAPTURE_FLUSH_END
+};
+
+enum {
+	HTML_ACTION_NONE,
+	HTML_ACTION_TAG_OPEN,
+	HTML_ACTION_TEXT_OPEN,
+	HTML_ACTION_TEXT,
+	HTML_ACTION_TAG_LT,
+	HTML_ACTION_CLOSING,
+	HTML_ACTION_COMMENT_OPEN,
+	HTML_ACTION_EMPTY_TAG_END,
+	HTML_ACTION_NAME_OPEN,
+	HTML_ACTION_NAME,
+	HTML_ACTION_SPACE,
+	HTML_ACTION_SPACE_END,
+	HTML_ACTION_SPACE_EQUALITY,
+	HTML_ACTION_ATTRIBUTE_OPEN,
+	HTML_ACTION_ATTRIBUTE,
+	HTML_ACTION_ATTRIBUTE_END,
+	HTML_ACTION_ATTRIBUTE_EQUALITY,
+	HTML_ACTION_ATTRIBUTE_SPACE,
+	HTML_ACTION_EQUALITY_SPACE,
+	HTML_ACTION_EQUALITY_END,
+	HTML_ACTION_DQ_OPEN,
+	HTML_ACTION_SQ_OPEN,
+	HTML_ACTION_UNQUOTED_OPEN,
+	HTML_ACTION_DQ_EMPTY,
+	HTML_ACTION_DQ_FIRST,
+	HTML_ACTION_VALUE,
+	HTML_ACTION_SQ,
+	HTML_ACTION_VALUE_END,
+	HTML_ACTION_UNQUOTED_END,
+	HTML_ACTION_UNQUOTED_SPACE,
+	HTML_ACTION_COMMENT_END,
+	HTML_ACTION_PI_OPEN,
+	HTML_ACTION_COMMENT_BEGIN,
+	HTML_ACTION_CDATA_OPEN,
+	HTML_ACTION_DOCTYPE_OPEN,
+	HTML_ACTION_COMMENT_TEXT,
+	HTML_ACTION_COMMENT_HOLD,
+	HTML_ACTION_COMMENT_FLUSH,
+	HTML_ACTION_COMMENT_FLUSH_HOLD,
+	HTML_ACTION_COMMENT_FLUSH_END,
+	HTML_ACTION_SCRIPT_NAME_OPEN,
+	HTML_ACTION_SCRIPT_NAME,
+	HTML_ACTION_RAW_OPEN,
+	HTML_ACTION_RAW_OPEN_LT,
+	HTML_ACTION_RAW_TEXT,
+	HTML_ACTION_RAW_LT,
+	HTML_ACTION_RAW_FLUSH,
+	HTML_ACTION_RAW_FLUSH_LT,
+	HTML_ACTION_NAME_END,     // the actions below are checked by html_parser_raw
+	HTML_ACTION_NAME_SPACE,
+	HTML_ACTION_SCRIPT_OPEN,
+	HTML_ACTION_SCRIPT_END,
+	HTML_ACTION_SCRIPT_SPACE,
+	HTML_ACTION_RAW_NAME,
+	HTML_ACTION_RAW_END,
+	HTML_ACTION_RAW_SPACE,
+	HTML_ACTION_DECLARATION,
+	HTML_ACTION_SIZE
+};
+
+#define HTML_BIT(part) (1UL << (part))
+#define HTML_ALL (HTML_BIT(HTML_PART_SIZE) - 1)
+#define HTML_SPACE_CLEAR (HTML_BIT(HTML_NAME_ENDED) | HTML_BIT(HTML_ATTRIBUTE_ENDED) | HTML_BIT(HTML_VALUE_ENDED) | HTML_BIT(HTML_VALUE_QUOTED) \
+	| HTML_BIT(HTML_VALUE_SINGLE_QUOTED) | HTML_BIT(HTML_VALUE_DOUBLE_QUOTED) | HTML_BIT(HTML_EQUALITY))
+#define HTML_EQUALITY_CLEAR (HTML_BIT(HTML_EQUALITY) | HTML_BIT(HTML_ATTRIBUTE_ENDED) | HTML_BIT(HTML_SPACE))
+#define HTML_COMMENT_PARTS (HTML_BIT(HTML_COMMENT) | HTML_BIT(HTML_CDATA) | HTML_BIT(HTML_DOCTYPE) | HTML_BIT(HTML_PROCESSING_INSTRUCTION))
+
+static const struct html_parser_action {
+	unsigned long clear;
+	unsigned long set;
+	unsigned char capture;
+} html_parser_actions[HTML_ACTION_SIZE] = {
+	[HTML_ACTION_NONE] = { 0, 0, HTML_CAPTURE_NONE },
+	[HTML_ACTION_TAG_OPEN] = { HTML_ALL, HTML_BIT(HTML_TAG) | HTML_BIT(HTML_TAG_BEGINNING), HTML_CAPTURE_NONE },
+	[HTML_ACTION_TEXT_OPEN] = { HTML_ALL, HTML_BIT(HTML_INNER_TEXT) | HTML_BIT(HTML_INNER_TEXT_BEGINNING), HTML_CAPTURE_TEXT_RESET },
+	[HTML_ACTION_TEXT] = { HTML_BIT(HTML_INNER_TEXT_BEGINNING), 0, HTML_CAPTURE_TEXT },
+	[HTML_ACTION_TAG_LT] = { HTML_BIT(HTML_TAG_BEGINNING), 0, HTML_CAPTURE_NONE },
+	[HTML_ACTION_CLOSING] = { HTML_BIT(HTML_TAG_BEGINNING), HTML_BIT(HTML_CLOSING_TAG) | HTML_BIT(HTML_SLASH) | HTML_BIT(HTML_NAME) | HTML_BIT(HTML_NAME_BEGINNING), HTML_CAPTURE_TAG_RESET },
+	[HTML_ACTION_COMMENT_OPEN] = { HTML_BIT(HTML_TAG_BEGINNING), HTML_BIT(HTML_COMMENT), HTML_CAPTURE_COMMENT_RESET },
+	[HTML_ACTION_EMPTY_TAG_END] = { HTML_BIT(HTML_TAG_BEGINNING), HTML_BIT(HTML_TAG_END), HTML_CAPTURE_NONE },
+	[HTML_ACTION_NAME_OPEN] = { HTML_BIT(HTML_TAG_BEGINNING), HTML_BIT(HTML_NAME) | HTML_BIT(HTML_NAME_BEGINNING), HTML_CAPTURE_TAG_RESET },
+	[HTML_ACTION_NAME] = { HTML_BIT(HTML_NAME_BEGINNING) | HTML_BIT(HTML_SLASH), 0, HTML_CAPTURE_TAG },
+	[HTML_ACTION_SPACE] = { HTML_SPACE_CLEAR, 0, HTML_CAPTURE_NONE },
+	[HTML_ACTION_SPACE_END] = { HTML_SPACE_CLEAR | HTML_BIT(HTML_SPACE), HTML_BIT(HTML_TAG_END), HTML_CAPTURE_NONE },
+	[HTML_ACTION_SPACE_EQUALITY] = { HTML_SPACE_CLEAR | HTML_BIT(HTML_SPACE), HTML_BIT(HTML_EQUALITY), HTML_CAPTURE_NONE },
+	[HTML_ACTION_ATTRIBUTE_OPEN] = { HTML_SPACE_CLEAR | HTML_BIT(HTML_SPACE), HTML_BIT(HTML_ATTRIBUTE) | HTML_BIT(HTML_ATTRIBUTE_BEGINNING), HTML_CAPTURE_ATTRIBUTE_RESET },
+	[HTML_ACTION_ATTRIBUTE] = { HTML_BIT(HTML_ATTRIBUTE_BEGINNING), 0, HTML_CAPTURE_ATTRIBUTE },
+	[HTML_ACTION_ATTRIBUTE_END] = { HTML_BIT(HTML_ATTRIBUTE_BEGINNING) | HTML_BIT(HTML_ATTRIBUTE), HTML_BIT(HTML_TAG_END) | HTML_BIT(HTML_ATTRIBUTE_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_ATTRIBUTE_EQUALITY] = { HTML_BIT(HTML_ATTRIBUTE_BEGINNING) | HTML_BIT(HTML_ATTRIBUTE), HTML_BIT(HTML_EQUALITY) | HTML_BIT(HTML_ATTRIBUTE_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_ATTRIBUTE_SPACE] = { HTML_BIT(HTML_ATTRIBUTE_BEGINNING) | HTML_BIT(HTML_ATTRIBUTE), HTML_BIT(HTML_SPACE) | HTML_BIT(HTML_ATTRIBUTE_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_EQUALITY_SPACE] = { HTML_BIT(HTML_EQUALITY) | HTML_BIT(HTML_ATTRIBUTE_ENDED), HTML_BIT(HTML_SPACE), HTML_CAPTURE_NONE },
+	[HTML_ACTION_EQUALITY_END] = { HTML_EQUALITY_CLEAR, HTML_BIT(HTML_TAG_END), HTML_CAPTURE_NONE },
+	[HTML_ACTION_DQ_OPEN] = { HTML_EQUALITY_CLEAR, HTML_BIT(HTML_VALUE_QUOTED) | HTML_BIT(HTML_VALUE_DOUBLE_QUOTED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_SQ_OPEN] = { HTML_EQUALITY_CLEAR, HTML_BIT(HTML_VALUE_QUOTED) | HTML_BIT(HTML_VALUE_SINGLE_QUOTED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_UNQUOTED_OPEN] = { HTML_EQUALITY_CLEAR, HTML_BIT(HTML_VALUE) | HTML_BIT(HTML_VALUE_BEGINNING), HTML_CAPTURE_VALUE_RESET },
+	[HTML_ACTION_DQ_EMPTY] = { HTML_BIT(HTML_VALUE), HTML_BIT(HTML_VALUE_BEGINNING) | HTML_BIT(HTML_VALUE_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_DQ_FIRST] = { 0, HTML_BIT(HTML_VALUE) | HTML_BIT(HTML_VALUE_BEGINNING), HTML_CAPTURE_VALUE_RESET },
+	[HTML_ACTION_VALUE] = { HTML_BIT(HTML_VALUE_BEGINNING), 0, HTML_CAPTURE_VALUE },
+	[HTML_ACTION_SQ] = { HTML_BIT(HTML_VALUE_BEGINNING), HTML_BIT(HTML_VALUE), HTML_CAPTURE_VALUE },
+	[HTML_ACTION_VALUE_END] = { HTML_BIT(HTML_VALUE_BEGINNING) | HTML_BIT(HTML_VALUE), HTML_BIT(HTML_VALUE_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_UNQUOTED_END] = { HTML_BIT(HTML_VALUE_BEGINNING) | HTML_BIT(HTML_VALUE), HTML_BIT(HTML_TAG_END) | HTML_BIT(HTML_VALUE_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_UNQUOTED_SPACE] = { HTML_BIT(HTML_VALUE_BEGINNING) | HTML_BIT(HTML_VALUE), HTML_BIT(HTML_SPACE) | HTML_BIT(HTML_VALUE_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_COMMENT_END] = { 0, HTML_BIT(HTML_TAG_END), HTML_CAPTURE_NONE },
+	[HTML_ACTION_PI_OPEN] = { HTML_BIT(HTML_TAG_BEGINNING), HTML_BIT(HTML_PROCESSING_INSTRUCTION), HTML_CAPTURE_COMMENT_RESET },
+	[HTML_ACTION_COMMENT_BEGIN] = { 0, 0, HTML_CAPTURE_DROP },
+	[HTML_ACTION_CDATA_OPEN] = { HTML_BIT(HTML_COMMENT), HTML_BIT(HTML_CDATA), HTML_CAPTURE_DROP },
+	[HTML_ACTION_DOCTYPE_OPEN] = { HTML_BIT(HTML_COMMENT), HTML_BIT(HTML_DOCTYPE), HTML_CAPTURE_DROP },
+	[HTML_ACTION_COMMENT_TEXT] = { 0, 0, HTML_CAPTURE_COMMENT },
+	[HTML_ACTION_COMMENT_HOLD] = { 0, 0, HTML_CAPTURE_HOLD },
+	[HTML_ACTION_COMMENT_FLUSH] = { 0, 0, HTML_CAPTURE_FLUSH },
+	[HTML_ACTION_COMMENT_FLUSH_HOLD] = { 0, 0, HTML_CAPTURE_FLUSH_HOLD },
+	[HTML_ACTION_COMMENT_FLUSH_END] = { 0, HTML_BIT(HTML_TAG_END), HTML_CAPTURE_FLUSH_END },
+	[HTML_ACTION_SCRIPT_NAME_OPEN] = { 0, 0, HTML_CAPTURE_TAG_RESET },
+	[HTML_ACTION_SCRIPT_NAME] = { 0, 0, HTML_CAPTURE_TAG },
+	[HTML_ACTION_RAW_OPEN] = { HTML_ALL, HTML_BIT(HTML_INNER_TEXT) | HTML_BIT(HTML_INNER_TEXT_BEGINNING), HTML_CAPTURE_RAW_TEXT_RESET },
+	[HTML_ACTION_RAW_OPEN_LT] = { HTML_ALL, HTML_BIT(HTML_INNER_TEXT) | HTML_BIT(HTML_INNER_TEXT_BEGINNING), HTML_CAPTURE_RAW_LT_RESET },
+	[HTML_ACTION_RAW_TEXT] = { HTML_BIT(HTML_INNER_TEXT_BEGINNING), 0, HTML_CAPTURE_RAW_TEXT },
+	[HTML_ACTION_RAW_LT] = { HTML_BIT(HTML_INNER_TEXT_BEGINNING), 0, HTML_CAPTURE_RAW_LT },
+	[HTML_ACTION_RAW_FLUSH] = { HTML_BIT(HTML_INNER_TEXT_BEGINNING), 0, HTML_CAPTURE_RAW_FLUSH },
+	[HTML_ACTION_RAW_FLUSH_LT] = { HTML_BIT(HTML_INNER_TEXT_BEGINNING), 0, HTML_CAPTURE_RAW_FLUSH_LT },
+	[HTML_ACTION_NAME_END] = { HTML_BIT(HTML_NAME_BEGINNING) | HTML_BIT(HTML_SLASH) | HTML_BIT(HTML_NAME), HTML_BIT(HTML_TAG_END) | HTML_BIT(HTML_NAME_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_NAME_SPACE] = { HTML_BIT(HTML_NAME_BEGINNING) | HTML_BIT(HTML_SLASH) | HTML_BIT(HTML_NAME), HTML_BIT(HTML_SPACE) | HTML_BIT(HTML_NAME_ENDED), HTML_CAPTURE_NONE },
+	[HTML_ACTION_SCRIPT_OPEN] = { HTML_ALL, HTML_BIT(HTML_SCRIPT), HTML_CAPTURE_NONE },
+	[HTML_ACTION_SCRIPT_END] = { HTML_BIT(HTML_SCRIPT), HTML_BIT(HTML_TAG) | HTML_BIT(HTML_TAG_END) | HTML_BIT(HTML_NAME_ENDED) | HTML_BIT(HTML_CLOSING_TAG), HTML_CAPTURE_NONE },
+	[HTML_ACTION_SCRIPT_SPACE] = { HTML_BIT(HTML_SCRIPT), HTML_BIT(HTML_TAG) | HTML_BIT(HTML_SPACE) | HTML_BIT(HTML_NAME_ENDED) | HTML_BIT(HTML_CLOSING_TAG), HTML_CAPTURE_NONE },
+	[HTML_ACTION_RAW_NAME] = { 0, 0, HTML_CAPTURE_RAW_NAME },
+	[HTML_ACTION_RAW_END] = { HTML_ALL, HTML_BIT(HTML_TAG) | HTML_BIT(HTML_TAG_END) | HTML_BIT(HTML_NAME_ENDED) | HTML_BIT(HTML_CLOSING_TAG), HTML_CAPTURE_RAW_TAG },
+	[HTML_ACTION_RAW_SPACE] = { HTML_ALL, HTML_BIT(HTML_TAG) | HTML_BIT(HTML_SPACE) | HTML_BIT(HTML_NAME_ENDED) | HTML_BIT(HTML_CLOSING_TAG), HTML_CAPTURE_RAW_TAG },
+	[HTML_ACTION_DECLARATION] = { 0, 0, HTML_CAPTURE_HOLD }
+};
+
+/*
+ * A transition holds the next state in the high byte
+ * and the action in the low byte.
+ */
+static const unsigned short html_parser_transitions[HTML_STATE_SIZE][HTML_CLASS_SIZE] = {
+#define T(state, action) (HTML_STATE_##state << 8 | HTML_ACTION_##action)
+#define ROW(other, alpha, lt, gt, slash, bang, equality, dq, sq, space, dash, bracket, question) \
+	{ other, alpha, lt, gt, slash, bang, equality, dq, sq, space, dash, bracket, question }
+#define ROW_LT(d, lt) ROW(d, d, lt, d, d, d, d, d, d, d, d, d, d)
+#define ROW_GT(d, gt) ROW(d, d, d, gt, d, d, d, d, d, d, d, d, d)
+#define ROW_DQ(d, dq) ROW(d, d, d, d, d, d, d, dq, d, d, d, d, d)
+#define ROW_SQ(d, sq) ROW(d, d, d, d, d, d, d, d, sq, d, d, d, d)
+#define ROW_GT_SPACE(d, gt, space) ROW(d, d, d, gt, d, d, d, d, d, space, d, d, d)
+#define ROW_GT_EQUALITY_SPACE(d, gt, equality, space) ROW(d, d, d, gt, d, d, equality, d, d, space, d, d, d)
+#define ROW_GT_DASH(d, gt, dash) ROW(d, d, d, gt, d, d, d, d, d, d, dash, d, d)
+#define ROW_GT_BRACKET(d, gt, bracket) ROW(d, d, d, gt, d, d, d, d, d, d, d, bracket, d)
+#define ROWS_TAG(prefix, start) \
+	/* SPACE */ ROW(T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), T(start, SPACE_END), \
+		T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), T(prefix##EQUALITY, SPACE_EQUALITY), T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), \
+		T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), T(prefix##SPACE, SPACE), T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN), \
+		T(prefix##ATTRIBUTE, ATTRIBUTE_OPEN)), \
+	/* ATTRIBUTE */ ROW_GT_EQUALITY_SPACE(T(prefix##ATTRIBUTE, ATTRIBUTE), T(start, ATTRIBUTE_END), T(prefix##EQUALITY, ATTRIBUTE_EQUALITY), T(prefix##SPACE, ATTRIBUTE_SPACE)), \
+	/* EQUALITY */ ROW(T(prefix##UNQUOTED, UNQUOTED_OPEN), T(prefix##UNQUOTED, UNQUOTED_OPEN), T(prefix##UNQUOTED, UNQUOTED_OPEN), T(start, EQUALITY_END), \
+		T(prefix##UNQUOTED, UNQUOTED_OPEN), T(prefix##UNQUOTED, UNQUOTED_OPEN), T(prefix##UNQUOTED, UNQUOTED_OPEN), T(prefix##DQ_START, DQ_OPEN), \
+		T(prefix##SQ, SQ_OPEN), T(prefix##EQUALITY, EQUALITY_SPACE), T(prefix##UNQUOTED, UNQUOTED_OPEN), T(prefix##UNQUOTED, UNQUOTED_OPEN), \
+		T(prefix##UNQUOTED, UNQUOTED_OPEN)), \
+	/* DQ_START */ ROW_DQ(T(prefix##DQ, DQ_FIRST), T(prefix##SPACE, DQ_EMPTY)), \
+	/* DQ */ ROW_DQ(T(prefix##DQ, VALUE), T(prefix##SPACE, VALUE_END)), \
+	/* SQ */ ROW_SQ(T(prefix##SQ, SQ), T(prefix##SPACE, VALUE_END)), \
+	/* UNQUOTED */ ROW_GT_SPACE(T(prefix##UNQUOTED, VALUE), T(start, UNQUOTED_END), T(prefix##SPACE, UNQUOTED_SPACE))
+#define SN T(SCRIPT_NAME, SCRIPT_NAME)
+#define RN T(RAW_NAME, RAW_NAME)
+#define RF T(RAW, RAW_FLUSH)
+#define CF T(COMMENT, COMMENT_FLUSH)
+#define CE T(START, COMMENT_END)
+#define D T(DECLARATION, DECLARATION)
+	/* START */ ROW_LT(T(TEXT, TEXT_OPEN), T(TAG, TAG_OPEN)),
+	/* TEXT */ ROW_LT(T(TEXT, TEXT), T(TAG, TAG_OPEN)),
+	/* SCRIPT_START */ ROW_LT(T(SCRIPT, SCRIPT_OPEN), T(SCRIPT_LT, SCRIPT_OPEN)),
+	/* TAG */ ROW(T(TEXT, TEXT_OPEN), T(NAME, NAME_OPEN), T(TAG, TAG_LT), T(START, EMPTY_TAG_END), T(NAME, CLOSING), T(DECLARATION, COMMENT_OPEN),
+		T(TEXT, TEXT_OPEN), T(TEXT, TEXT_OPEN), T(TEXT, TEXT_OPEN), T(TEXT, TEXT_OPEN), T(TEXT, TEXT_OPEN), T(TEXT, TEXT_OPEN), T(PI, PI_OPEN)),
+	/* NAME */ ROW_GT_SPACE(T(NAME, NAME), T(START, NAME_END), T(SPACE, NAME_SPACE)),
+	ROWS_TAG(, START),
+	ROWS_TAG(SCRIPT_, SCRIPT_START),
+	/* DECLARATION */ ROW(D, D, D, T(START, COMMENT_FLUSH_END), D, D, D, D, D, D, D, D, D),
+	/* COMMENT_START */ ROW_GT_DASH(T(COMMENT, COMMENT_TEXT), CE, T(COMMENT_START_DASH, COMMENT_HOLD)),
+	/* COMMENT_START_DASH */ ROW_GT_DASH(CF, CE, T(COMMENT_DASH_DASH, COMMENT_HOLD)),
+	/* COMMENT */ ROW_GT_DASH(T(COMMENT, COMMENT_TEXT), T(COMMENT, COMMENT_TEXT), T(COMMENT_DASH, COMMENT_HOLD)),
+	/* COMMENT_DASH */ ROW_GT_DASH(CF, CF, T(COMMENT_DASH_DASH, COMMENT_HOLD)),
+	/* COMMENT_DASH_DASH */ ROW(CF, CF, CF, CE, CF, T(COMMENT_DASH_BANG, COMMENT_HOLD), CF, CF, CF, CF, T(COMMENT_DASH_DASH, COMMENT_TEXT), CF, CF),
+	/* COMMENT_DASH_BANG */ ROW_GT_DASH(CF, CE, T(COMMENT_DASH, COMMENT_FLUSH_HOLD)),
+	/* BOGUS */ ROW_GT(T(BOGUS, COMMENT_TEXT), CE),
+	/* DOCTYPE */ ROW_GT(T(DOCTYPE, COMMENT_TEXT), CE),
+	/* PI */ ROW_GT(T(PI, COMMENT_TEXT), CE),
+	/* CDATA */ ROW_GT_BRACKET(T(CDATA, COMMENT_TEXT), T(CDATA, COMMENT_TEXT), T(CDATA_BRACKET, COMMENT_HOLD)),
+	/* CDATA_BRACKET */ ROW_GT_BRACKET(T(CDATA, COMMENT_FLUSH), T(CDATA, COMMENT_FLUSH), T(CDATA_BRACKETS, COMMENT_HOLD)),
+	/* CDATA_BRACKETS */ ROW_GT_BRACKET(T(CDATA, COMMENT_FLUSH), CE, T(CDATA_BRACKETS, COMMENT_TEXT)),
+	/* SCRIPT */ ROW_LT(T(SCRIPT, NONE), T(SCRIPT_LT, NONE)),
+	/* SCRIPT_LT */ ROW(T(SCRIPT, NONE), T(SCRIPT, NONE), T(SCRIPT_LT, NONE), T(SCRIPT, NONE), T(SCRIPT_NAME, SCRIPT_NAME_OPEN), T(SCRIPT, NONE),
+		T(SCRIPT, NONE), T(SCRIPT, NONE), T(SCRIPT, NONE), T(SCRIPT, NONE), T(SCRIPT, NONE), T(SCRIPT, NONE), T(SCRIPT, NONE)),
+	/* RAW */ ROW_LT(T(RAW, RAW_TEXT), T(RAW_LT, RAW_LT)),
+	/* RAW_LT */ ROW(RF, RF, T(RAW_LT, RAW_FLUSH_LT), RF, RN, RF, RF, RF, RF, RF, RF, RF, RF),
+	/* RAW_NAME */ ROW(RN, RN, T(RAW_LT, RAW_FLUSH_LT), T(START, RAW_END), RN, RN, RN, RN, RN, T(SPACE, RAW_SPACE), RN, RN, RN),
+	/* SCRIPT_NAME */ ROW(SN, SN, T(SCRIPT_LT, NONE), T(START, SCRIPT_END), SN, SN, SN, SN, SN, T(SPACE, SCRIPT_SPACE), SN, SN, SN)
+#undef D
+#undef CE
+#undef CF
+#undef RF
+#undef RN
+#undef SN
+#undef ROWS_TAG
+#undef ROW_GT_BRACKET
+#undef ROW_GT_DASH
+#undef ROW_GT_EQUALITY_SPACE
+#undef ROW_GT_SPACE
+#undef ROW_SQ
+#undef ROW_DQ
+#undef ROW_GT
+#undef ROW_LT
+#undef ROW
+#undef T
+};
+
+/*
+ * The char the parser scans for in the states
+ * staying the same for all the other chars.
+ */
+static const char html_parser_scan_chars[HTML_STATE_SIZE] = {
+	[HTML_STATE_TEXT] = '<',
+	[HTML_STATE_DQ] = '"',
+	[HTML_STATE_SQ] = '\'',
+	[HTML_STATE_SCRIPT_DQ] = '"',
+	[HTML_STATE_SCRIPT_SQ] = '\'',
+	[HTML_STATE_COMMENT] = '-',
+	[HTML_STATE_BOGUS] = '>',
+	[HTML_STATE_DOCTYPE] = '>',
+	[HTML_STATE_PI] = '>',
+	[HTML_STATE_CDATA] = ']',
+	[HTML_STATE_SCRIPT] = '<',
+	[HTML_STATE_RAW] = '<'
+};
+
+int html_parser_is_in(HTMLSTREAMPARSER *hsp, int html_part) { if (html_part >= 0 && html_part < HTML_PART_SIZE) return (hsp->html_part >> html_part) & 1; else return 0; }
+
+/*
+ * Places the tag name, attribute name and value
+ * one after another to the tag arena. Only the last
+ * one, the part tail, and the parts after it can grow.
+ */
+static void html_parser_tag_arena_layout(HTMLSTREAMPARSER *hsp, char tail) {
+	hsp->arena_tail = tail;
+	if (!hsp->tag_arena) return;
+	hsp->tag_name = hsp->tag_arena;
+	hsp->attr_name = hsp->tag_name + hsp->tag_name_len;
+	hsp->attr_value = hsp->attr_name + hsp->attr_name_len;
+	hsp->tag_name_max_len = hsp->tag_name_len;
+	hsp->attr_name_max_len = hsp->attr_name_len;
+	hsp->attr_value_max_len = hsp->attr_value_len;
+	if (tail == HTML_NAME) hsp->tag_name_max_len = hsp->tag_arena_len;
+	else if (tail == HTML_ATTRIBUTE) hsp->attr_name_max_len = hsp->tag_arena_len - hsp->tag_name_len;
+	else hsp->attr_value_max_len = hsp->tag_arena_len - hsp->tag_name_len - hsp->attr_name_len;
+}
+
+/*
+ * Doubles the arena until it has the length need
+ * or the arena max length.
+ */
+static void html_parser_arena_fit(HTMLSTREAMPARSER *hsp, char **arena, size_t *len, size_t need) {
+	size_t l = *len ? *len : hsp->arena_len;
+	char *p;
+	while (l < need && l < hsp->arena_max_len) l *= 2;
+	if (l > hsp->arena_max_len) l = hsp->arena_max_len;
+	if (l > *len && (p = (char *) realloc(*arena, l))) { *arena = p; *len = l; }
+}
+
+/*
+ * Grows the arena of the part (HTML_INNER_TEXT, HTML_NAME,
+ * HTML_ATTRIBUTE or HTML_VALUE) to fit n more chars.
+ * Returns 0 if no more char fits.
+ */
+static int html_parser_arena_grow(HTMLSTREAMPARSER *hsp, char part, size_t n) {
+	if (!hsp->arena_max_len) return 0;
+	if (part == HTML_INNER_TEXT) {
+		html_parser_arena_fit(hsp, &hsp->text_arena, &hsp->text_arena_len, hsp->inner_text_len + n);
+		hsp->inner_text = hsp->text_arena;
+		hsp->inner_text_max_len = hsp->text_arena_len;
+		return hsp->inner_text_len < hsp->inner_text_max_len;
+	}
+	// the parts are in the arena in the order of their enum values
+	if (part < hsp->arena_tail) return 0;
+	html_parser_arena_fit(hsp, &hsp->tag_arena, &hsp->tag_arena_len, hsp->tag_name_len + hsp->attr_name_len + hsp->attr_value_len + n);
+	html_parser_tag_arena_layout(hsp, part);
+	return hsp->tag_name_len + hsp->attr_name_len + hsp->attr_value_len < hsp->tag_arena_len;
+}
+
+typedef char html_parser_states_check[HTML_STATE_SIZE == HTML_PARSER_STATE_SIZE ? 1 : -1];
+
+static const char *html_parser_state_names[HTML_STATE_SIZE] = {
+	"START", "TEXT", "SCRIPT_START", "TAG", "NAME", "SPACE", "ATTRIBUTE", "EQUALITY", "DQ_START", "DQ", "SQ", "UNQUOTED",
+	"SCRIPT_SPACE", "SCRIPT_ATTRIBUTE", "SCRIPT_EQUALITY", "SCRIPT_DQ_START", "SCRIPT_DQ", "SCRIPT_SQ", "SCRIPT_UNQUOTED",
+	"DECLARATION", "COMMENT_START", "COMMENT_START_DASH", "COMMENT", "COMMENT_DASH", "COMMENT_DASH_DASH", "COMMENT_DASH_BANG",
+	"BOGUS", "DOCTYPE", "PI", "CDATA", "CDATA_BRACKET", "CDATA_BRACKETS", "SCRIPT", "SCRIPT_LT", "RAW", "RAW_LT", "RAW_NAME", "SCRIPT_NAME"
+};
+
+#ifdef HTML_PARSER_STATS
+/*
+ * Counts the action taken.
+ */
+static void html_parser_stats_action(HTMLSTREAMPARSER *hsp, int action) {
+	switch (action) {
+		case HTML_ACTION_NAME_OPEN:
+		case HTML_ACTION_CLOSING:
+		case HTML_ACTION_SCRIPT_END:
+		case HTML_ACTION_SCRIPT_SPACE:
+		case HTML_ACTION_RAW_END:
+		case HTML_ACTION_RAW_SPACE:
+			hsp->stats.tags++;
 			break;
-		case 1: // tag beginning
-			h[HTML_TAG_BEGINNING] = 0;
-			*l = 0;
-			if (c == '/') { *s = 2; h[HTML_CLOSING_TAG] = 1; h[HTML_SLASH] = 1; h[HTML_NAME] = 1; h[HTML_NAME_BEGINNING] = 1; }
-			else if (c == '!') { *s = 9; h[HTML_COMMENT] = 1; }
-			else if (c == '>') { *s = 0; h[HTML_TAG_END] = 1; }
-			else if (isalpha(c)) { *s = 2; h[HTML_NAME] = 1; h[HTML_NAME_BEGINNING] = 1; }
-			else if (c != '<') { *s = 0; memset(h, 0, HTML_PART_SIZE); h[HTML_INNER_TEXT] = 1; h[HTML_INNER_TEXT_BEGINNING] = 1; }
-			break;
-		case 2: // inside a tag name
-			h[HTML_NAME_BEGINNING] = 0;
-			h[HTML_SLASH] = 0;
-			if (c == '>') { *s = 0; h[HTML_TAG_END] = 1; h[HTML_NAME_ENDED] = 1; h[HTML_NAME] = 0; }
-			else if (ishtmlspace(c)) { *s = 3; h[HTML_SPACE] = 1; h[HTML_NAME_ENDED] = 1; h[HTML_NAME] = 0; }
-			break;
-		case 3: // tag space
-			h[HTML_NAME_ENDED] = 0;
-			h[HTML_ATTRIBUTE_ENDED] = 0;
-			h[HTML_VALUE_ENDED] = 0;
-			h[HTML_VALUE_QUOTED] = 0;
-			h[HTML_VALUE_SINGLE_QUOTED] = 0;
-			h[HTML_VALUE_DOUBLE_QUOTED] = 0;
-			h[HTML_EQUALITY] = 0;
-			if (!ishtmlspace(c)) {
-				h[HTML_SPACE] = 0;
-				if (c == '>') { *s = 0; h[HTML_TAG_END] = 1; }
-				else if (c == '=') { *s = 5; h[HTML_EQUALITY] = 1; }
-				else { *s = 4; h[HTML_ATTRIBUTE] = 1; h[HTML_ATTRIBUTE_BEGINNING] = 1; }
-			}
+		case HTML_ACTION_ATTRIBUTE_OPEN:
+			hsp->stats.attributes++;
+			break;
+		case HTML_ACTION_SCRIPT_OPEN:
+			hsp->stats.scripts++;
 			break;
-		case 4: // inside an attribute name
-			h[HTML_ATTRIBUTE_BEGINNING] = 0;
-			if (c == '>') { *s = 0; h[HTML_TAG_END] = 1; h[HTML_ATTRIBUTE] = 0; h[HTML_ATTRIBUTE_ENDED] = 1; }
-			else if (c == '=') { *s = 5; h[HTML_EQUALITY] = 1; h[HTML_ATTRIBUTE] = 0; h[HTML_ATTRIBUTE_ENDED] = 1; }
-			else if (ishtmlspace(c)) { *s = 3; h[HTML_SPACE] = 1; h[HTML_ATTRIBUTE] = 0; h[HTML_ATTRIBUTE_ENDED] = 1; }
-			break;
-		case 5: // before an attribute value
-			h[HTML_EQUALITY] = 0;
-			h[HTML_ATTRIBUTE_ENDED] = 0;
-			h[HTML_SPACE] = 1;
-			if (!ishtmlspace(c)) {
-				h[HTML_SPACE] = 0;
-				if (c == '>') { *s = 0; h[HTML_TAG_END] = 1; }
-				else if (c == '"') { *s = 6; h[HTML_VALUE_QUOTED] = 1; h[HTML_VALUE_DOUBLE_QUOTED] = 1; }
-				else if (c == '\'') { *s = 7; h[HTML_VALUE_QUOTED] = 1; h[HTML_VALUE_SINGLE_QUOTED] = 1; }
-				else { *s = 8; h[HTML_VALUE] = 1; h[HTML_VALUE_BEGINNING] = 1; }
+		case HTML_ACTION_COMMENT_OPEN:
+		case HTML_ACTION_PI_OPEN:
+			hsp->stats.comments++;
+			break;
+	}
+	if (html_parser_actions[action].clear == HTML_ALL) hsp->stats.resets++;
+}
+
+/*
+ * Counts the capture of the buffer kind as truncated
+ * when its first char is lost. A buffer not set
+ * does not count.
+ */
+static void html_parser_stats_truncate(HTMLSTREAMPARSER *hsp, int kind, const char *buffer) {
+	if (!buffer || (hsp->stats_truncated & 1 << kind)) return;
+	hsp->stats_truncated |= 1 << kind;
+	hsp->stats.truncations[kind]++;
+}
+
+/*
+ * Ends the capture of the buffer kind
+ * having the real length real_len.
+ */
+static void html_parser_stats_end(HTMLSTREAMPARSER *hsp, int kind, size_t real_len) {
+	if (hsp->stats.max_real_len[kind] < real_len) hsp->stats.max_real_len[kind] = real_len;
+	hsp->stats_truncated &= ~(1 << kind);
+}
+#endif
+
+/*
+ * Appends the n chars to the inner text
+ * collapsing the whitespace.
+ */
+static void html_parser_text_collapse(HTMLSTREAMPARSER *hsp, const char *p, size_t n) {
+	char lost = 0;
+	// a pending space can come before the chars
+	if (hsp->inner_text_max_len - hsp->inner_text_len <= n) html_parser_arena_grow(hsp, HTML_INNER_TEXT, n + 1);
+	hsp->inner_text_len = html_parser_collapse(hsp->inner_text, hsp->inner_text_len, hsp->inner_text_max_len, p, n, &hsp->inner_text_space, 1, &lost);
+#ifdef HTML_PARSER_STATS
+	if (lost) html_parser_stats_truncate(hsp, HTML_BUFFER_INNER_TEXT, hsp->inner_text);
+#endif
+}
+
+/*
+ * Appends the n chars to the buffer
+ * of the inner text or attribute value.
+ */
+static void html_parser_entity_put(HTMLSTREAMPARSER *hsp, char part, const char *p, size_t n) {
+	size_t i;
+	if (part == HTML_INNER_TEXT && hsp->inner_text_collapse) html_parser_text_collapse(hsp, p, n);
+	else if (part == HTML_INNER_TEXT) {
+		if (hsp->inner_text_max_len - hsp->inner_text_len < n) html_parser_arena_grow(hsp, HTML_INNER_TEXT, n);
+		for (i = 0; i < n && hsp->inner_text_len < hsp->inner_text_max_len; i++) hsp->inner_text[hsp->inner_text_len++] = p[i];
+#ifdef HTML_PARSER_STATS
+		if (i < n) html_parser_stats_truncate(hsp, HTML_BUFFER_INNER_TEXT, hsp->inner_text);
+#endif
+	} else {
+		if (hsp->attr_value_max_len - hsp->attr_value_len < n) html_parser_arena_grow(hsp, HTML_VALUE, n);
+		for (i = 0; i < n && hsp->attr_value_len < hsp->attr_value_max_len; i++)
+			hsp->attr_value[hsp->attr_value_len++] = hsp->attr_val_to_lower ? html_parser_tolower(p[i]) : p[i];
+#ifdef HTML_PARSER_STATS
+		if (i < n) html_parser_stats_truncate(hsp, HTML_BUFFER_VALUE, hsp->attr_value);
+#endif
+	}
+}
+
+/*
+ * Returns the code point of a numeric reference.
+ * Invalid code points are replaced by U+FFFD and
+ * the C1 controls by the windows-1252 chars as HTML5 does.
+ */
+static unsigned long html_parser_reference_code(unsigned long code) {
+	static const unsigned short c1[32] = {
+		0x20AC, 0x81, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x8D, 0x017D, 0x8F,
+		0x90, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x9D, 0x017E, 0x0178
+	};
+	if (code == 0 || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) return 0xFFFD;
+	if (code >= 0x80 && code <= 0x9F) return c1[code - 0x80];
+	return code;
+}
+
+/*
+ * Appends the code point of a numeric reference encoded as UTF-8.
+ */
+static void html_parser_entity_put_code(HTMLSTREAMPARSER *hsp, unsigned long code) {
+	char u[4];
+	html_parser_entity_put(hsp, hsp->entity_part, u, html_parser_utf8_put(u, html_parser_reference_code(code)));
+}
+
+/*
+ * Ends the pending character reference before the char c
+ * or before the end of the text or value when c is -1.
+ */
+static void html_parser_entity_end(HTMLSTREAMPARSER *hsp, int c) {
+	const char *e = hsp->entity;
+	int n = hsp->entity_len, m = hsp->entity_match_len, next;
+	if (n > 1 && e[1] == '#') {
+		if (hsp->entity_digits) html_parser_entity_put_code(hsp, hsp->entity_code);
+		else html_parser_entity_put(hsp, hsp->entity_part, e, n);
+	} else if (m) {
+		// a legacy reference in a value followed by '=' or an alphanumeric is not decoded
+		next = m + 1 < n ? (unsigned char) e[m + 1] : c;
+		if (hsp->entity_part == HTML_VALUE && e[m] != ';' && (next == '=' || (next >= 0 && html_parser_isalnum(next)))) html_parser_entity_put(hsp, hsp->entity_part, e, n);
+		else {
+			html_parser_entity_put(hsp, hsp->entity_part, html_entity_values + html_entity_value_offsets[hsp->entity_match],
+				html_entity_value_offsets[hsp->entity_match + 1] - html_entity_value_offsets[hsp->entity_match]);
+			html_parser_entity_put(hsp, hsp->entity_part, e + m + 1, n - m - 1);
+		}
+	} else html_parser_entity_put(hsp, hsp->entity_part, e, n);
+	hsp->entity_len = 0;
+	hsp->html_part &= ~HTML_BIT(HTML_ENTITY);
+}
+
+/*
+ * Returns the first reference in the range [lo, hi) of references
+ * sharing the first d chars whose char at the position d
+ * is not less (or greater if upper is set) than the char c.
+ */
+static unsigned short html_parser_entity_bound(unsigned short lo, unsigned short hi, int d, unsigned char c, int upper) {
+	unsigned short m;
+	int k;
+	while (lo < hi) {
+		m = lo + (hi - lo) / 2;
+		k = html_entity_name_offsets[m] + d < html_entity_name_offsets[m + 1] ? (unsigned char) html_entity_names[html_entity_name_offsets[m] + d] : -1;
+		if (upper ? k <= c : k < c) lo = m + 1; else hi = m;
+	}
+	return lo;
+}
+
+/*
+ * Passes the char c of an inner text or attribute value
+ * through the character reference decoder.
+ */
+static void html_parser_entity_char(HTMLSTREAMPARSER *hsp, char part, const char c) {
+	unsigned char u = c;
+	unsigned short lo, hi;
+	int d;
+	char digits;
+	if (hsp->entity_len == 1 && c == '#') { hsp->entity[hsp->entity_len++] = c; return; }
+	if (hsp->entity_len > 1 && hsp->entity[1] == '#') {
+		if (hsp->entity_len == 2 && !hsp->entity_digits && (c == 'x' || c == 'X')) { hsp->entity[hsp->entity_len++] = c; return; }
+		if (hsp->entity_len > 2 ? html_parser_isxdigit(u) : html_parser_isdigit(u)) {
+			if (hsp->entity_code <= 0x10FFFF) hsp->entity_code = hsp->entity_code * (hsp->entity_len > 2 ? 16 : 10) + (html_parser_isdigit(u) ? u - '0' : html_parser_tolower(u) - 'a' + 10);
+			hsp->entity_digits = 1;
+			return;
+		}
+		digits = hsp->entity_digits;
+		html_parser_entity_end(hsp, u);
+		if (c == ';' && digits) return;
+	} else if (hsp->entity_len) {
+		d = hsp->entity_len - 1;
+		if ((html_parser_isalnum(u) || c == ';') && hsp->entity_len < HTML_ENTITY_SIZE) {
+			lo = html_parser_entity_bound(hsp->entity_lo, hsp->entity_hi, d, u, 0);
+			hi = html_parser_entity_bound(lo, hsp->entity_hi, d, u, 1);
+			if (lo < hi) {
+				hsp->entity[hsp->entity_len++] = c;
+				hsp->entity_lo = lo;
+				hsp->entity_hi = hi;
+				if (html_entity_name_offsets[lo] + d + 1 == html_entity_name_offsets[lo + 1]) { hsp->entity_match = lo; hsp->entity_match_len = d + 1; }
+				if (c == ';') html_parser_entity_end(hsp, -1);
+				return;
 			}
+		}
+		html_parser_entity_end(hsp, u);
+	}
+	if (c == '&') {
+		hsp->entity[0] = c;
+		hsp->entity_len = 1;
+		hsp->entity_part = part;
+		hsp->entity_lo = 0;
+		hsp->entity_hi = HTML_ENTITY_COUNT;
+		hsp->entity_match = 0;
+		hsp->entity_match_len = 0;
+		hsp->entity_code = 0;
+		hsp->entity_digits = 0;
+		hsp->html_part |= HTML_BIT(HTML_ENTITY);
+	} else html_parser_entity_put(hsp, part, &c, 1);
+}
+
+/*
+ * Decides by the action taken which of the inner text,
+ * attribute name and value are of interest and skips
+ * capturing the others. It runs before the action
+ * changes the parts, so the names are not finished yet
+ * by the parts but are already in the buffers.
+ */
+static void html_parser_interest_action(HTMLSTREAMPARSER *hsp, int action) {
+	const HTMLSTREAMPARSER_INTEREST *in = hsp->interest;
+	int id;
+	switch (action) {
+		case HTML_ACTION_TAG_OPEN:
+		case HTML_ACTION_SCRIPT_NAME_OPEN:
+		case HTML_ACTION_RAW_END:
+		case HTML_ACTION_RAW_SPACE:
+			hsp->skip_text = !in->all_text;
+			hsp->interest_tag = HTML_TAG_ID_UNKNOWN;
+			hsp->skip_attr = 1;
+			hsp->skip_value = 1;
 			break;
-		case 6: // inside an attribute value and the value is surrounded by double quotes
-			if (!h[HTML_VALUE]) { h[HTML_VALUE] = 1; h[HTML_VALUE_BEGINNING] = 1; }
-			else h[HTML_VALUE_BEGINNING] = 0;
-			if (c == '"') { *s = 3; h[HTML_VALUE] = 0; h[HTML_VALUE_ENDED] = 1; }
+		case HTML_ACTION_NAME_END:
+		case HTML_ACTION_NAME_SPACE:
+			if (hsp->html_part & HTML_BIT(HTML_CLOSING_TAG) || hsp->tag_name_len != hsp->tag_name_real_len) break;
+			id = html_parser_tag_name_id(hsp->tag_name, hsp->tag_name_len);
+			if (!in->tags[id]) break;
+			hsp->interest_tag = id;
+			hsp->skip_attr = 0;
+			hsp->skip_value = 0;
+			if (in->tags[id] & HTML_INTEREST_TEXT) hsp->skip_text = 0;
 			break;
-		case 7: // inside an attribute value and the value is surrounded by single quotes
-			h[HTML_VALUE] = 1; h[HTML_VALUE_BEGINNING] = 0;
-			if (c == '\'') { *s = 3; h[HTML_VALUE] = 0; h[HTML_VALUE_ENDED] = 1; }
+		case HTML_ACTION_ATTRIBUTE_END:
+		case HTML_ACTION_ATTRIBUTE_EQUALITY:
+		case HTML_ACTION_ATTRIBUTE_SPACE:
+			if (!(in->tags[hsp->interest_tag] & HTML_INTEREST_LISTED)) break;
+			id = hsp->attr_name_len == hsp->attr_name_real_len ? html_parser_attr_name_id(hsp->attr_name, hsp->attr_name_len) : HTML_ATTR_ID_UNKNOWN;
+			hsp->skip_value = !(in->attrs[hsp->interest_tag][id >> 3] >> (id & 7) & 1);
+			break;
+	}
+}
+
+/*
+ * Copies the n chars to the attribute pool.
+ * Returns NULL if they do not fit.
+ */
+static const char *html_parser_attr_pool_put(HTMLSTREAMPARSER *hsp, const char *p, size_t n) {
+	char *b = hsp->attr_pool + hsp->attr_pool_len;
+	if (hsp->attr_pool_max_len - hsp->attr_pool_len < n) return NULL;
+	if (n) memcpy(b, p, n);
+	hsp->attr_pool_len += n;
+	return b;
+}
+
+/*
+ * Appends the current attribute name with the value chars
+ * from value_begin to value_len to the attribute list.
+ * The attribute not fitting the list or the pool is dropped.
+ */
+static void html_parser_attr_list_put(HTMLSTREAMPARSER *hsp, char with_value, size_t value_begin, size_t value_len) {
+	HTMLSTREAMPARSER_ATTRIBUTE *a = hsp->attr_list + hsp->attr_list_len;
+	size_t pool_len = hsp->attr_pool_len;
+	// a value after no attribute name has an empty name, never a listed one
+	if (hsp->skip_value || (!hsp->attr_pending && hsp->interest && hsp->interest->tags[hsp->interest_tag] & HTML_INTEREST_LISTED)) {
+		hsp->attr_pending = 0;
+		return;
+	}
+	if (hsp->attr_list_len == hsp->attr_list_max_len) {
+		hsp->attr_pending = 0;
+		return;
+	}
+	a->name_len = hsp->attr_pending ? hsp->attr_name_len : 0;
+	hsp->attr_pending = 0;
+	a->value_len = value_len - value_begin;
+	a->value = NULL;
+	if (!(a->name = html_parser_attr_pool_put(hsp, hsp->attr_name, a->name_len))
+		|| (with_value && !(a->value = html_parser_attr_pool_put(hsp, hsp->attr_value + value_begin, a->value_len)))) {
+		hsp->attr_pool_len = pool_len;
+		return;
+	}
+	hsp->attr_list_len++;
+}
+
+/*
+ * Collects the attributes of the current tag
+ * to the attribute list by the action taken.
+ * It runs before the action changes the parts and
+ * captures the char, so a new attribute does not
+ * overwrite the previous one yet.
+ */
+static void html_parser_attr_list_action(HTMLSTREAMPARSER *hsp, int action) {
+	switch (action) {
+		case HTML_ACTION_TAG_OPEN:
+		case HTML_ACTION_SCRIPT_NAME_OPEN:
+		case HTML_ACTION_RAW_END:
+		case HTML_ACTION_RAW_SPACE:
+			hsp->attr_list_len = 0;
+			hsp->attr_pool_len = 0;
+			hsp->attr_pending = 0;
 			break;
-		case 8: // inside an attribute value and the value is not surrounded by single or double quotes
-			h[HTML_VALUE_BEGINNING] = 0;
-			if (c == '>') { *s = 0; h[HTML_TAG_END] = 1; h[HTML_VALUE] = 0; h[HTML_VALUE_ENDED] = 1; }
-			else if (ishtmlspace(c)) { *s = 3; h[HTML_SPACE] = 1; h[HTML_VALUE] = 0; h[HTML_VALUE_ENDED] = 1; }
+		case HTML_ACTION_ATTRIBUTE_OPEN:
+			if (hsp->attr_pending) html_parser_attr_list_put(hsp, 0, 0, 0);
+			hsp->attr_pending = 1;
 			break;
-		case 9: // inside a comment
-			if (c == '>') { *s = 0; h[HTML_TAG_END] = 1; }
+		case HTML_ACTION_SQ_OPEN:
+			// a single quoted value does not reset the value buffer
+			hsp->attr_value_begin = hsp->attr_value_len;
 			break;
-		case 10: // searching script end
-			if (c == '<') *s = 11;
+		case HTML_ACTION_DQ_OPEN:
+		case HTML_ACTION_UNQUOTED_OPEN:
+			hsp->attr_value_begin = 0;
 			break;
-		case 11:
-			if (c != '<') {
-				if (c == '/') {
-					*s = 12; *l = 0;
-				} else *s = 10;
-			}
+		case HTML_ACTION_DQ_EMPTY:
+		case HTML_ACTION_VALUE_END:
+		case HTML_ACTION_UNQUOTED_END:
+		case HTML_ACTION_UNQUOTED_SPACE:
+			// nor does an empty value
+			if (hsp->html_part & HTML_BIT(HTML_VALUE)) html_parser_attr_list_put(hsp, 1, hsp->attr_value_begin, hsp->attr_value_len);
+			else html_parser_attr_list_put(hsp, 1, 0, 0);
 			break;
-		case 12:
-		case 13:
-			if (c == '<') *s = 11;
-			else if (c == '>' && *l == 6) { *s = 0; *l = 0; h[HTML_SCRIPT] = 0; h[HTML_TAG] = 1; h[HTML_TAG_END] = 1; h[HTML_NAME_ENDED] = 1; h[HTML_CLOSING_TAG] = 1; }
-			else if (ishtmlspace(c) && *l == 6) { *s = 3; *l = 0; h[HTML_SCRIPT] = 0; h[HTML_TAG] = 1; h[HTML_SPACE] = 1; h[HTML_NAME_ENDED] = 1; h[HTML_CLOSING_TAG] = 1; }
-			else *s = 13;
-			break;
-	}
-	if (*s == 2 || *s == 13) if (*l >= 0 && *l < 6) if (script[*l] == tolower(c)) (*l)++; else *l = -1; else *l = -1;
-
-	if (h[HTML_INNER_TEXT]) {
-		if (h[HTML_INNER_TEXT_BEGINNING]) { hsp->inner_text_len = 0; hsp->inner_text_real_len = 0; }
-		if (hsp->inner_text_len < hsp->inner_text_max_len) hsp->inner_text[hsp->inner_text_len++] = c;
-		hsp->inner_text_real_len++;
-	} else if (h[HTML_NAME] || *s == 12 || *s == 13) {
-		if (h[HTML_NAME_BEGINNING] || *s == 12) {
-			hsp->tag_name_len = 0; hsp->attr_name_len = 0; hsp->attr_value_len = 0;
-			hsp->tag_name_real_len = 0; hsp->attr_name_real_len = 0; hsp->attr_value_real_len = 0;
-		}
-		if (hsp->tag_name_len < hsp->tag_name_max_len)
-			if (hsp->tag_name_to_lower) hsp->tag_name[hsp->tag_name_len++] = tolower(c);
-			else hsp->tag_name[hsp->tag_name_len++] = c;
-		hsp->tag_name_real_len++;
-	} else if (h[HTML_ATTRIBUTE]) {
-		if (h[HTML_ATTRIBUTE_BEGINNING]) {
-			hsp->attr_name_len = 0; hsp->attr_value_len = 0;
-			hsp->attr_name_real_len = 0; hsp->attr_value_real_len = 0;
-		}
-		if (hsp->attr_name_len < hsp->attr_name_max_len)
-			if (hsp->attr_name_to_lower) hsp->attr_name[hsp->attr_name_len++] = tolower(c);
-			else hsp->attr_name[hsp->attr_name_len++] = c;
-		hsp->attr_name_real_len++;
-	} else if (h[HTML_VALUE]) {
-		if (h[HTML_VALUE_BEGINNING]) { hsp->attr_value_len = 0; hsp->attr_value_real_len = 0; }
-		if (hsp->attr_value_len < hsp->attr_value_max_len)
-			if (hsp->attr_val_to_lower) hsp->attr_value[hsp->attr_value_len++] = tolower(c);
-			else hsp->attr_value[hsp->attr_value_len++] = c;
-		hsp->attr_value_real_len++;
 	}
+	if ((html_parser_actions[action].set & HTML_BIT(HTML_TAG_END)) && hsp->attr_pending) html_parser_attr_list_put(hsp, 0, 0, 0);
 }
 
-void html_parser_set_tag_to_lower(HTMLSTREAMPARSER *hsp, char c) { hsp->tag_name_to_lower = c; }
+enum {
+	HTML_RAW_SCRIPT,    // the text goes to no buffer, see HTML_SCRIPT
+	HTML_RAW_TEXT,      // the text is the inner text
+	HTML_RAW_RCDATA,    // the text is the inner text with the references decoded
+	HTML_RAW_PLAINTEXT  // the text is the inner text up to the end of the stream
+};
+
+/*
+ * The elements whose text ends only at their end tag.
+ * The raw member of the parser is the index
+ * of the current one plus 1, 0 for none.
+ */
+static const struct html_parser_raw_element {
+	const char *name;
+	unsigned char len;
+	char kind;
+} html_parser_raw_elements[] = {
+	{ "", 0, HTML_RAW_TEXT },
+	{ "script", 6, HTML_RAW_SCRIPT },
+	{ "style", 5, HTML_RAW_TEXT },
+	{ "xmp", 3, HTML_RAW_TEXT },
+	{ "iframe", 6, HTML_RAW_TEXT },
+	{ "noembed", 7, HTML_RAW_TEXT },
+	{ "noframes", 8, HTML_RAW_TEXT },
+	{ "noscript", 8, HTML_RAW_TEXT },
+	{ "title", 5, HTML_RAW_RCDATA },
+	{ "textarea", 8, HTML_RAW_RCDATA },
+	{ "plaintext", 9, HTML_RAW_PLAINTEXT }
+};
 
-void html_parser_set_attr_to_lower(HTMLSTREAMPARSER *hsp, char c) { hsp->attr_name_to_lower = c; }
+#define HTML_RAW_SIZE (sizeof(html_parser_raw_elements) / sizeof(html_parser_raw_elements[0]))
 
-void html_parser_set_val_to_lower(HTMLSTREAMPARSER *hsp, char c) { hsp->attr_val_to_lower = c; }
+/*
+ * Returns 1 if the n chars pointed by p
+ * are the lower case name in any case.
+ */
+static int html_parser_raw_match(const char *p, const char *name, size_t n) {
+	while (n && html_parser_tolower((unsigned char) *p) == *name) { p++; name++; n--; }
+	return !n;
+}
 
+/*
+ * The declarations told apart after "<!",
+ * the doctype is in any case.
+ */
+static const struct html_parser_declaration {
+	const char *name;
+	unsigned char len;
+	char fold;
+	unsigned short t;
+} html_parser_declarations[] = {
+	{ "--", 2, 0, HTML_STATE_COMMENT_START << 8 | HTML_ACTION_COMMENT_BEGIN },
+	{ "[CDATA[", 7, 0, HTML_STATE_CDATA << 8 | HTML_ACTION_CDATA_OPEN },
+	{ "doctype", 7, 1, HTML_STATE_DOCTYPE << 8 | HTML_ACTION_DOCTYPE_OPEN }
+};
 
-void html_parser_set_tag_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->tag_name = buffer; hsp->tag_name_max_len = length; }
+#define HTML_DECLARATION_SIZE (sizeof(html_parser_declarations) / sizeof(html_parser_declarations[0]))
 
-void html_parser_release_tag_buffer(HTMLSTREAMPARSER *hsp) { hsp->tag_name = NULL; hsp->tag_name_len = 0; hsp->tag_name_max_len = 0; }
+/*
+ * Checks the char c following the k chars held back
+ * after "<!". Returns the transition into the declaration
+ * when c ends its name, t when c may still do it
+ * and the transition into a bogus comment otherwise.
+ */
+static unsigned short html_parser_declaration(HTMLSTREAMPARSER *hsp, unsigned short t, const char c, unsigned char k) {
+	const struct html_parser_declaration *d;
+	unsigned char i, j;
+	for (i = 0; i < HTML_DECLARATION_SIZE; i++) {
+		d = html_parser_declarations + i;
+		if (k >= d->len) continue;
+		for (j = 0; j <= k; j++) if ((d->fold ? html_parser_tolower((unsigned char) (j < k ? hsp->held[j] : c)) : (j < k ? hsp->held[j] : c)) != d->name[j]) break;
+		if (j > k) return k + 1 == d->len ? d->t : t;
+	}
+	return HTML_STATE_BOGUS << 8 | HTML_ACTION_COMMENT_FLUSH;
+}
 
-size_t html_parser_tag_length(HTMLSTREAMPARSER *hsp) { if (!hsp->html_part[HTML_NAME] && hsp->parser_state != 12 && hsp->parser_state != 13) return hsp->tag_name_len; else return 0; }
+/*
+ * Checks the transition t the char c selected
+ * by the raw text element. The start tag name selects
+ * the element and the end tag name must match it.
+ * Returns the transition to take instead.
+ */
+static unsigned short html_parser_raw(HTMLSTREAMPARSER *hsp, unsigned short t, const char c) {
+	const struct html_parser_raw_element *e = html_parser_raw_elements + hsp->raw;
+	unsigned char k = hsp->held_len;
+	switch (t & 0xff) {
+		case HTML_ACTION_NAME_END:
+		case HTML_ACTION_NAME_SPACE:
+			// the name of an end tag has the '/' in front
+			for (hsp->raw = HTML_RAW_SIZE - 1; hsp->raw; hsp->raw--) {
+				e = html_parser_raw_elements + hsp->raw;
+				if (e->len == hsp->tag_name_real_len && html_parser_raw_match(hsp->held, e->name, e->len))
+					return (t & 0xff) == HTML_ACTION_NAME_END ? HTML_STATE_SCRIPT_START << 8 | HTML_ACTION_NAME_END : HTML_STATE_SCRIPT_SPACE << 8 | HTML_ACTION_NAME_SPACE;
+			}
+			return t;
+		case HTML_ACTION_SCRIPT_OPEN:
+			if (e->kind == HTML_RAW_SCRIPT) return t;
+			return c == '<' ? HTML_STATE_RAW_LT << 8 | HTML_ACTION_RAW_OPEN_LT : HTML_STATE_RAW << 8 | HTML_ACTION_RAW_OPEN;
+		case HTML_ACTION_SCRIPT_END:
+		case HTML_ACTION_SCRIPT_SPACE:
+			if (hsp->tag_name_real_len == e->len + 1U && html_parser_raw_match(hsp->held + 1, e->name, e->len)) return t;
+			return HTML_STATE_SCRIPT_NAME << 8 | HTML_ACTION_SCRIPT_NAME;
+		case HTML_ACTION_RAW_NAME:
+			if (e->kind != HTML_RAW_PLAINTEXT && k <= e->len && (k ? html_parser_tolower((unsigned char) c) == e->name[k - 1] : c == '/')) return t;
+			return HTML_STATE_RAW << 8 | HTML_ACTION_RAW_FLUSH;
+		case HTML_ACTION_RAW_END:
+		case HTML_ACTION_RAW_SPACE:
+			if (k == e->len + 1U) return t;
+			return HTML_STATE_RAW << 8 | HTML_ACTION_RAW_FLUSH;
+		case HTML_ACTION_DECLARATION:
+			return html_parser_declaration(hsp, t, c, k);
+	}
+	return t;
+}
 
-size_t html_parser_tag_real_length(HTMLSTREAMPARSER *hsp) { return hsp->tag_name_real_len; }
+/*
+ * The step and the tokenizer are compiled for every variant
+ * of the configuration, so a parser capturing nothing or not
+ * folding the case does not test it for every char. The
+ * variant is chosen by every function changing the configuration
+ * and kept in the parser. A variant not capturing has no buffer,
+ * arena, interest, attribute list nor references decoding.
+ */
+#define HTML_VARIANT_CAPTURE 1
+#define HTML_VARIANT_TAG_LOWER 2
+#define HTML_VARIANT_ATTR_LOWER 4
+#define HTML_VARIANT_VAL_LOWER 8
+#define HTML_VARIANT_CALLBACKS 16
+#define HTML_VARIANT_SIZE 32
 
-char* html_parser_tag(HTMLSTREAMPARSER *hsp) { return hsp->tag_name; }
+static int html_parser_variant(HTMLSTREAMPARSER *hsp) {
+	int capture = ((size_t) hsp->tag_name | (size_t) hsp->attr_name | (size_t) hsp->attr_value | (size_t) hsp->inner_text
+		| (size_t) hsp->comment | hsp->arena_max_len | (size_t) hsp->interest | (size_t) hsp->attr_list | (size_t) hsp->decode_entities) != 0;
+	return (((size_t) hsp->callbacks | (size_t) hsp->links | (size_t) hsp->visible | (size_t) hsp->tape) != 0) << 4 | (-capture & (HTML_VARIANT_CAPTURE | (hsp->tag_name_to_lower != 0) << 1
+		| (hsp->attr_name_to_lower != 0) << 2 | (hsp->attr_val_to_lower != 0) << 3));
+}
 
-int html_parser_cmp_tag(HTMLSTREAMPARSER *hsp, char *p, size_t l) { if (html_parser_tag_length(hsp) == l) if (strncmp(p, hsp->tag_name, l) == 0) return 1; return 0; }
+static inline void html_parser_text_reset(HTMLSTREAMPARSER *hsp) {
+#ifdef HTML_PARSER_STATS
+	html_parser_stats_end(hsp, HTML_BUFFER_INNER_TEXT, hsp->inner_text_real_len);
+#endif
+	hsp->inner_text_len = 0; hsp->inner_text_real_len = 0; hsp->inner_text_space = 0;
+}
 
+static inline void html_parser_text_char(HTMLSTREAMPARSER *hsp, const char c, char decode, const int v) {
+	if ((v & HTML_VARIANT_CAPTURE) && !hsp->skip_text) {
+		if (decode) html_parser_entity_char(hsp, HTML_INNER_TEXT, c);
+		else if (hsp->inner_text_collapse) {
+			if (hsp->inner_text_max_len - hsp->inner_text_len < 2) html_parser_text_collapse(hsp, &c, 1);
+			else if (ishtmlspace(c)) hsp->inner_text_space = hsp->inner_text_len != 0;
+			else {
+				if (hsp->inner_text_space) hsp->inner_text[hsp->inner_text_len++] = ' ';
+				hsp->inner_text_space = 0;
+				hsp->inner_text[hsp->inner_text_len++] = c;
+			}
+		}
+		else if (hsp->inner_text_len < hsp->inner_text_max_len || html_parser_arena_grow(hsp, HTML_INNER_TEXT, 1)) hsp->inner_text[hsp->inner_text_len++] = c;
+#ifdef HTML_PARSER_STATS
+		else html_parser_stats_truncate(hsp, HTML_BUFFER_INNER_TEXT, hsp->inner_text);
+#endif
+	}
+	hsp->inner_text_real_len++;
+}
 
-void html_parser_set_attr_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->attr_name = buffer; hsp->attr_name_max_len = length; }
+static inline void html_parser_raw_char(HTMLSTREAMPARSER *hsp, const char c, const int v) {
+	html_parser_text_char(hsp, c, (v & HTML_VARIANT_CAPTURE) && hsp->decode_entities && html_parser_raw_elements[(int) hsp->raw].kind == HTML_RAW_RCDATA, v);
+}
 
-void html_parser_release_attr_buffer(HTMLSTREAMPARSER *hsp) { hsp->attr_name = NULL; hsp->attr_name_len = 0; hsp->attr_name_max_len = 0; }
+/*
+ * Puts the held back '<' and the end tag name chars
+ * to the text of the raw text element.
+ */
+static void html_parser_raw_flush(HTMLSTREAMPARSER *hsp, const int v) {
+	unsigned char i;
+	html_parser_raw_char(hsp, '<', v);
+	for (i = 0; i < hsp->held_len; i++) html_parser_raw_char(hsp, hsp->held[i], v);
+}
 
-size_t html_parser_attr_length(HTMLSTREAMPARSER *hsp) { if (!hsp->html_part[HTML_ATTRIBUTE]) return hsp->attr_name_len; else return 0; }
+static inline void html_parser_comment_char(HTMLSTREAMPARSER *hsp, const char c, const int v) {
+	if ((v & HTML_VARIANT_CAPTURE) && hsp->comment_len < hsp->comment_max_len) hsp->comment[hsp->comment_len++] = c;
+#ifdef HTML_PARSER_STATS
+	else html_parser_stats_truncate(hsp, HTML_BUFFER_COMMENT, hsp->comment);
+#endif
+	hsp->comment_real_len++;
+}
 
-size_t html_parser_attr_real_length(HTMLSTREAMPARSER *hsp) { return hsp->attr_name_real_len; }
+/*
+ * Puts the chars held back inside the comment to it.
+ */
+static void html_parser_comment_flush(HTMLSTREAMPARSER *hsp, const int v) {
+	unsigned char i;
+	for (i = 0; i < hsp->held_len; i++) html_parser_comment_char(hsp, hsp->held[i], v);
+	hsp->held_len = 0;
+}
 
-char* html_parser_attr(HTMLSTREAMPARSER *hsp) { return hsp->attr_name; }
+static inline void html_parser_tag_reset(HTMLSTREAMPARSER *hsp) {
+#ifdef HTML_PARSER_STATS
+	html_parser_stats_end(hsp, HTML_BUFFER_TAG, hsp->tag_name_real_len);
+	html_parser_stats_end(hsp, HTML_BUFFER_ATTRIBUTE, hsp->attr_name_real_len);
+	html_parser_stats_end(hsp, HTML_BUFFER_VALUE, hsp->attr_value_real_len);
+#endif
+	hsp->tag_name_len = 0; hsp->attr_name_len = 0; hsp->attr_value_len = 0;
+	hsp->tag_name_real_len = 0; hsp->attr_name_real_len = 0; hsp->attr_value_real_len = 0;
+	hsp->held_len = 0;
+	if (hsp->arena_max_len) html_parser_tag_arena_layout(hsp, HTML_NAME);
+}
 
-int html_parser_cmp_attr(HTMLSTREAMPARSER *hsp, char *p, size_t l) { if (html_parser_attr_length(hsp) == l) if (strncmp(p, hsp->attr_name, l) == 0) return 1; return 0; }
+static inline void html_parser_tag_char(HTMLSTREAMPARSER *hsp, const char c, const int v) {
+	// the raw text element is found by the name chars kept aside
+	if (hsp->held_len < HTML_HELD_SIZE) hsp->held[hsp->held_len++] = c;
+	if ((v & HTML_VARIANT_CAPTURE) && (hsp->tag_name_len < hsp->tag_name_max_len || html_parser_arena_grow(hsp, HTML_NAME, 1)))
+		hsp->tag_name[hsp->tag_name_len++] = v & HTML_VARIANT_TAG_LOWER ? html_parser_tolower(c) : c;
+#ifdef HTML_PARSER_STATS
+	else html_parser_stats_truncate(hsp, HTML_BUFFER_TAG, hsp->tag_name);
+#endif
+	hsp->tag_name_real_len++;
+}
 
+/*
+ * Moves the parser by the char c
+ * and returns the action taken.
+ */
+static HTML_ALWAYS_INLINE int html_parser_step_variant(HTMLSTREAMPARSER *hsp, const char c, const int v) {
+	unsigned short t = html_parser_transitions[(int) hsp->parser_state][html_parser_classes[(unsigned char) c]];
+	const struct html_parser_action *a;
+	unsigned char i, n;
+	if ((t & 0xff) >= HTML_ACTION_NAME_END) t = html_parser_raw(hsp, t, c);
+	a = &html_parser_actions[t & 0xff];
+#ifdef HTML_PARSER_STATS
+	hsp->stats.state_bytes[(int) hsp->parser_state]++;
+	html_parser_stats_action(hsp, t & 0xff);
+#endif
+	hsp->parser_state = t >> 8;
+	if ((v & HTML_VARIANT_CAPTURE) && hsp->entity_len && a->capture != HTML_CAPTURE_TEXT && a->capture != HTML_CAPTURE_VALUE && a->capture != HTML_CAPTURE_RAW_TEXT) html_parser_entity_end(hsp, -1);
+	if ((v & HTML_VARIANT_CAPTURE) && hsp->interest) html_parser_interest_action(hsp, t & 0xff);
+	if ((v & HTML_VARIANT_CAPTURE) && hsp->attr_list) html_parser_attr_list_action(hsp, t & 0xff);
+	hsp->html_part = (hsp->html_part & ~a->clear) | a->set;
+	switch (a->capture) {
+		case HTML_CAPTURE_TEXT_RESET:
+			html_parser_text_reset(hsp);
+			/* fall through */
+		case HTML_CAPTURE_TEXT:
+			html_parser_text_char(hsp, c, (v & HTML_VARIANT_CAPTURE) && hsp->decode_entities, v);
+			break;
+		case HTML_CAPTURE_TAG_RESET:
+			html_parser_tag_reset(hsp);
+			/* fall through */
+		case HTML_CAPTURE_TAG:
+			html_parser_tag_char(hsp, c, v);
+			break;
+		case HTML_CAPTURE_ATTRIBUTE_RESET:
+#ifdef HTML_PARSER_STATS
+			html_parser_stats_end(hsp, HTML_BUFFER_ATTRIBUTE, hsp->attr_name_real_len);
+			html_parser_stats_end(hsp, HTML_BUFFER_VALUE, hsp->attr_value_real_len);
+#endif
+			hsp->attr_name_len = 0; hsp->attr_value_len = 0;
+			hsp->attr_name_real_len = 0; hsp->attr_value_real_len = 0;
+			if (hsp->arena_max_len) html_parser_tag_arena_layout(hsp, HTML_ATTRIBUTE);
+			/* fall through */
+		case HTML_CAPTURE_ATTRIBUTE:
+			if ((v & HTML_VARIANT_CAPTURE) && !hsp->skip_attr && (hsp->attr_name_len < hsp->attr_name_max_len || html_parser_arena_grow(hsp, HTML_ATTRIBUTE, 1)))
+				hsp->attr_name[hsp->attr_name_len++] = v & HTML_VARIANT_ATTR_LOWER ? html_parser_tolower(c) : c;
+#ifdef HTML_PARSER_STATS
+			else if (!hsp->skip_attr) html_parser_stats_truncate(hsp, HTML_BUFFER_ATTRIBUTE, hsp->attr_name);
+#endif
+			hsp->attr_name_real_len++;
+			break;
+		case HTML_CAPTURE_VALUE_RESET:
+#ifdef HTML_PARSER_STATS
+			html_parser_stats_end(hsp, HTML_BUFFER_VALUE, hsp->attr_value_real_len);
+#endif
+			hsp->attr_value_len = 0; hsp->attr_value_real_len = 0;
+			if (hsp->arena_max_len) html_parser_tag_arena_layout(hsp, HTML_VALUE);
+			/* fall through */
+		case HTML_CAPTURE_VALUE:
+			if ((v & HTML_VARIANT_CAPTURE) && !hsp->skip_value) {
+				if (hsp->decode_entities) html_parser_entity_char(hsp, HTML_VALUE, c);
+				else if (hsp->attr_value_len < hsp->attr_value_max_len || html_parser_arena_grow(hsp, HTML_VALUE, 1))
+					hsp->attr_value[hsp->attr_value_len++] = v & HTML_VARIANT_VAL_LOWER ? html_parser_tolower(c) : c;
+#ifdef HTML_PARSER_STATS
+				else html_parser_stats_truncate(hsp, HTML_BUFFER_VALUE, hsp->attr_value);
+#endif
+			}
+			hsp->attr_value_real_len++;
+			break;
+		case HTML_CAPTURE_RAW_TEXT_RESET:
+			html_parser_text_reset(hsp);
+			/* fall through */
+		case HTML_CAPTURE_RAW_TEXT:
+			html_parser_raw_char(hsp, c, v);
+			break;
+		case HTML_CAPTURE_RAW_LT_RESET:
+			html_parser_text_reset(hsp);
+			hsp->held_len = 0;
+			break;
+		case HTML_CAPTURE_RAW_FLUSH_LT:
+			html_parser_raw_flush(hsp, v);
+			/* fall through */
+		case HTML_CAPTURE_RAW_LT:
+			hsp->held_len = 0;
+			break;
+		case HTML_CAPTURE_RAW_NAME:
+			hsp->held[hsp->held_len++] = c;
+			break;
+		case HTML_CAPTURE_RAW_FLUSH:
+			html_parser_raw_flush(hsp, v);
+			html_parser_raw_char(hsp, c, v);
+			break;
+		case HTML_CAPTURE_RAW_TAG:
+			// the held back end tag becomes the tag name
+			n = hsp->held_len;
+			html_parser_tag_reset(hsp);
+			for (i = 0; i < n; i++) html_parser_tag_char(hsp, hsp->held[i], v);
+			break;
+		case HTML_CAPTURE_COMMENT_RESET:
+#ifdef HTML_PARSER_STATS
+			html_parser_stats_end(hsp, HTML_BUFFER_COMMENT, hsp->comment_real_len);
+#endif
+			hsp->comment_len = 0; hsp->comment_real_len = 0;
+			/* fall through */
+		case HTML_CAPTURE_DROP:
+			hsp->held_len = 0;
+			break;
+		case HTML_CAPTURE_FLUSH:
+			html_parser_comment_flush(hsp, v);
+			/* fall through */
+		case HTML_CAPTURE_COMMENT:
+			html_parser_comment_char(hsp, c, v);
+			break;
+		case HTML_CAPTURE_FLUSH_HOLD:
+			html_parser_comment_flush(hsp, v);
+			/* fall through */
+		case HTML_CAPTURE_HOLD:
+			hsp->held[hsp->held_len++] = c;
+			break;
+		case HTML_CAPTURE_FLUSH_END:
+			html_parser_comment_flush(hsp, v);
+			break;
+	}
+	return t & 0xff;
+}
 
-void html_parser_set_val_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->attr_value = buffer; hsp->attr_value_max_len = length; }
+#define HTML_PARSER_STEP(v) \
+	static int html_parser_step_##v(HTMLSTREAMPARSER *hsp, const char c) { return html_parser_step_variant(hsp, c, v); }
 
-void html_parser_release_val_buffer(HTMLSTREAMPARSER *hsp) { hsp->attr_value = NULL; hsp->attr_value_len = 0; hsp->attr_value_max_len = 0; }
+HTML_PARSER_STEP(0)
+HTML_PARSER_STEP(1)
+HTML_PARSER_STEP(3)
+HTML_PARSER_STEP(5)
+HTML_PARSER_STEP(7)
+HTML_PARSER_STEP(9)
+HTML_PARSER_STEP(11)
+HTML_PARSER_STEP(13)
+HTML_PARSER_STEP(15)
 
-size_t html_parser_val_length(HTMLSTREAMPARSER *hsp) { if (!hsp->html_part[HTML_VALUE]) return hsp->attr_value_len; else return 0; }
+static int (*const html_parser_steps[HTML_VARIANT_CALLBACKS])(HTMLSTREAMPARSER *hsp, const char c) = {
+	html_parser_step_0, html_parser_step_1, html_parser_step_0, html_parser_step_3,
+	html_parser_step_0, html_parser_step_5, html_parser_step_0, html_parser_step_7,
+	html_parser_step_0, html_parser_step_9, html_parser_step_0, html_parser_step_11,
+	html_parser_step_0, html_parser_step_13, html_parser_step_0, html_parser_step_15
+};
 
-size_t html_parser_val_real_length(HTMLSTREAMPARSER *hsp) { return hsp->attr_value_real_len; }
+/*
+ * Returns a pointer to the first occurrence of the char c
+ * or d in the range [p, end) or end if there is no such char.
+ */
+static const char *html_parser_scan(const char *p, const char *end, char c, char d) {
+#if defined(__AVX2__)
+	const __m256i n = _mm256_set1_epi8(c), o = _mm256_set1_epi8(d);
+	while (end - p >= 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) p);
+		unsigned int m = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, n), _mm256_cmpeq_epi8(v, o)));
+		if (m) return p + __builtin_ctz(m);
+		p += 32;
+	}
+#endif
+#if defined(__SSE2__)
+	const __m128i x = _mm_set1_epi8(c), y = _mm_set1_epi8(d);
+	while (end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) p);
+		unsigned int m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, x), _mm_cmpeq_epi8(v, y)));
+		if (m) return p + __builtin_ctz(m);
+		p += 16;
+	}
+#endif
+	while (p < end && *p != c && *p != d) p++;
+	return p;
+}
 
-char* html_parser_val(HTMLSTREAMPARSER *hsp) { return hsp->attr_value; }
+/*
+ * Appends the run of n chars to a capture buffer
+ * exactly like n calls of html_parser_char_parse would do.
+ */
+static void html_parser_capture_run(char *buf, size_t *len, size_t *real_len, size_t max_len, const char *p, size_t n, char to_lower) {
+	size_t i, room = max_len - *len;
+	if (room > n) room = n;
+	if (to_lower) for (i = 0; i < room; i++) buf[*len + i] = html_parser_tolower(p[i]);
+	else if (room) memcpy(buf + *len, p, room);
+	*len += room;
+	*real_len += n;
+}
 
-int html_parser_cmp_val(HTMLSTREAMPARSER *hsp, char *p, size_t l) { if (html_parser_val_length(hsp) == l) if (strncmp(p, hsp->attr_value, l) == 0) return 1; return 0; }
+/*
+ * Appends the n chars pointed by p to the carry buffer.
+ * The chars not fitting into the buffer are lost
+ * if the buffer can't grow.
+ */
+static void html_parser_carry(HTMLSTREAMPARSER *hsp, const char *p, size_t n) {
+	char *carry;
+	size_t size = hsp->carry_max_len ? hsp->carry_max_len : 256;
+	if (hsp->carry_len + n > hsp->carry_max_len) {
+		while (size < hsp->carry_len + n) size *= 2;
+		carry = (char *) realloc(hsp->carry, size);
+		if (carry) { hsp->carry = carry; hsp->carry_max_len = size; }
+		else n = hsp->carry_max_len - hsp->carry_len;
+	}
+	if (n) memcpy(hsp->carry + hsp->carry_len, p, n);
+	hsp->carry_len += n;
+}
+
+static void html_parser_span_begin(HTMLSTREAMPARSER *hsp, int kind, const char *p) {
+	HTMLSTREAMPARSER_SPAN *t = &hsp->span[kind];
+	t->state = 1;
+	t->begin = p;
+	t->carry_offset = hsp->carry_len;
+	t->carry_len = 0;
+}
+
+/*
+ * Closes the span at the char pointed by p.
+ * A span having a part in the carry buffer
+ * is moved there as a whole.
+ */
+static void html_parser_span_close(HTMLSTREAMPARSER *hsp, int kind, const char *p) {
+	HTMLSTREAMPARSER_SPAN *t = &hsp->span[kind];
+	t->state = 2;
+	t->end = p;
+	if (t->carry_len) {
+		html_parser_carry(hsp, t->begin, p - t->begin);
+		t->carry_len = hsp->carry_len - t->carry_offset;
+		t->begin = t->end = NULL;
+	}
+}
+
+/*
+ * Returns a reference to the closed span content
+ * and sets the len argument to the content length.
+ */
+static const char *html_parser_span(HTMLSTREAMPARSER *hsp, int kind, size_t *len) {
+	HTMLSTREAMPARSER_SPAN *t = &hsp->span[kind];
+	if (t->begin) { *len = t->end - t->begin; return t->begin; }
+	*len = t->carry_len;
+	// a span never begun is empty, there may be no carry buffer
+	return t->carry_len ? hsp->carry + t->carry_offset : "";
+}
 
+/*
+ * Moves the open and closed spans to the carry buffer
+ * at the end of the buffer pointed by end.
+ */
+static void html_parser_span_carry(HTMLSTREAMPARSER *hsp, const char *end) {
+	HTMLSTREAMPARSER_SPAN *t;
+	int kind;
+	for (kind = 0; kind < HTML_SPAN_SIZE; kind++) {
+		t = &hsp->span[kind];
+		if (!t->state || !t->begin) continue;
+		if (!t->carry_len) t->carry_offset = hsp->carry_len;
+		html_parser_carry(hsp, t->begin, (t->state == 1 ? end : t->end) - t->begin);
+		t->carry_len = hsp->carry_len - t->carry_offset;
+		t->begin = t->end = NULL;
+	}
+}
 
-void html_parser_set_inner_text_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->inner_text = buffer; hsp->inner_text_max_len = length; }
+/*
+ * The link extractor resolves the URLs of the link attributes
+ * against the base URL and appends them to the link buffer.
+ * The URL in the content of a meta element waits pending at
+ * the end of the buffer until the tag ends, as the http-equiv
+ * attribute telling it is a refresh can follow. The dedup set
+ * is an open addressing hash table of the list indexes plus
+ * one, at most half full.
+ */
+#define HTML_LINK_URL_SIZE 2048
 
-void html_parser_release_inner_text_buffer(HTMLSTREAMPARSER *hsp) { hsp->inner_text = NULL; hsp->inner_text_len = 0; hsp->inner_text_max_len = 0; }
+struct html_parser_links {
+	HTMLSTREAMPARSER_LINK *list;
+	size_t len;
+	size_t max_len;
+	char *buffer;
+	size_t buffer_len;
+	size_t buffer_max_len;
+	size_t *set;
+	size_t set_mask;
+	size_t dropped;
+	int tag;
+	char base_set;
+	char refresh;
+	size_t pending_len;
+	size_t url_len;
+	size_t base_len;
+	char url[HTML_LINK_URL_SIZE];
+	char base[HTML_LINK_URL_SIZE];
+};
 
-size_t html_parser_inner_text_length(HTMLSTREAMPARSER *hsp) { if (!hsp->html_part[HTML_INNER_TEXT]) return hsp->inner_text_len; else return 0; }
+// the length of a URL not fitting the link buffer
+#define HTML_LINK_DROPPED ((size_t) -1)
 
-size_t html_parser_inner_text_real_length(HTMLSTREAMPARSER *hsp) { return hsp->inner_text_real_len; }
+static inline int html_parser_isurlspace(int c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'; }
 
-char* html_parser_inner_text(HTMLSTREAMPARSER *hsp) { return hsp->inner_text; }
+/*
+ * Returns the index of the named reference of the n chars
+ * pointed by p or -1 if there is no such reference.
+ */
+static int html_parser_entity_find(const char *p, size_t n) {
+	int lo = 0, hi = HTML_ENTITY_COUNT, mid, r;
+	size_t l;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		l = html_entity_name_offsets[mid + 1] - html_entity_name_offsets[mid];
+		r = memcmp(html_entity_names + html_entity_name_offsets[mid], p, l < n ? l : n);
+		if (!r) r = (l > n) - (l < n);
+		if (!r) return mid;
+		if (r < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	return -1;
+}
 
-int html_parser_cmp_inner_text(HTMLSTREAMPARSER *hsp, char *p, size_t l) { if (html_parser_inner_text_length(hsp) == l) if (strncmp(p, hsp->inner_text, l) == 0) return 1; return 0; }
+/*
+ * Decodes the character reference at p before end, a numeric
+ * one or a named one ended by ';', setting the value argument
+ * to its chars, maybe put to u, and k to their number.
+ * Returns the end of the reference or NULL if there is none.
+ */
+static const char *html_parser_reference(const char *p, const char *end, const char **value, size_t *k, char *u) {
+	const char *q = p + 1;
+	unsigned long code;
+	int hex, i;
+	if (q < end && *q == '#') {
+		hex = q + 1 < end && (q[1] | 0x20) == 'x';
+		for (q += 1 + hex, code = 0, i = 0; q < end && (hex ? html_parser_isxdigit(*q) : html_parser_isdigit(*q)); q++, i++)
+			if (code <= 0x10FFFF) code = code * (hex ? 16 : 10) + (html_parser_isdigit(*q) ? *q - '0' : (*q | 0x20) - 'a' + 10);
+		if (!i) return NULL;
+		*value = u;
+		*k = html_parser_utf8_put(u, html_parser_reference_code(code));
+		return q < end && *q == ';' ? q + 1 : q;
+	}
+	while (q < end && q - p <= HTML_ENTITY_MAX_LEN && html_parser_isalnum(*q)) q++;
+	if (q == end || *q != ';' || (i = html_parser_entity_find(p + 1, q - p)) < 0) return NULL;
+	*value = html_entity_values + html_entity_value_offsets[i];
+	*k = html_entity_value_offsets[i + 1] - html_entity_value_offsets[i];
+	return q + 1;
+}
+
+/*
+ * Copies the URL of the n chars pointed by p to the max_len
+ * chars pointed by dst without the whitespace around it and
+ * the tabs and newlines inside, decoding the references.
+ * Returns the URL length or HTML_LINK_DROPPED if it does not fit.
+ */
+static size_t html_parser_url_decode(char *dst, size_t max_len, const char *p, size_t n) {
+	const char *end = p + n, *q, *value;
+	size_t len = 0, k;
+	char u[4];
+	while (p < end && html_parser_isurlspace(*p)) p++;
+	while (end > p && html_parser_isurlspace(end[-1])) end--;
+	while (p < end) {
+		if (*p != '&' || !(q = html_parser_reference(p, end, &value, &k, u))) {
+			value = p;
+			k = 1;
+			q = p + 1;
+		}
+		p = q;
+		if (k == 1 && (*value == '\t' || *value == '\n' || *value == '\r')) continue;
+		if (max_len - len < k) return HTML_LINK_DROPPED;
+		memcpy(dst + len, value, k);
+		len += k;
+	}
+	return len;
+}
+
+/*
+ * Returns the length of the scheme of the URL
+ * with the ':' after it or 0 if it has none.
+ */
+static size_t html_parser_url_scheme(const char *p, size_t n) {
+	size_t i;
+	if (!n || !html_parser_isalnum((unsigned char) p[0]) || html_parser_isdigit(p[0])) return 0;
+	for (i = 1; i < n && (html_parser_isalnum((unsigned char) p[i]) || p[i] == '+' || p[i] == '-' || p[i] == '.'); i++);
+	return i < n && p[i] == ':' ? i + 1 : 0;
+}
+
+/*
+ * Returns the end of the authority of the URL
+ * after its scheme of the length s, which is s
+ * if the URL has no authority.
+ */
+static size_t html_parser_url_authority(const char *p, size_t n, size_t s) {
+	if (n - s < 2 || p[s] != '/' || p[s + 1] != '/') return s;
+	for (s += 2; s < n && p[s] != '/' && p[s] != '?' && p[s] != '#'; s++);
+	return s;
+}
+
+/*
+ * Resolves the reference of the len chars at the beginning
+ * of the max_len chars pointed by p against the base URL
+ * in place as RFC 3986 does, removing the dot segments of
+ * the path. Returns the URL length or HTML_LINK_DROPPED.
+ */
+static size_t html_parser_url_resolve(const char *base, size_t base_len, char *p, size_t len, size_t max_len) {
+	size_t s = html_parser_url_scheme(base, base_len), a, q, f, prefix, slash = 0, i, e, o;
+	if (s && !html_parser_url_scheme(p, len)) {
+		a = html_parser_url_authority(base, base_len, s);
+		for (f = a; f < base_len && base[f] != '#'; f++);
+		for (q = a; q < f && base[q] != '?'; q++);
+		if (len >= 2 && p[0] == '/' && p[1] == '/') prefix = s;
+		else if (p[0] == '/') prefix = a;
+		else if (p[0] == '?') prefix = q;
+		else if (p[0] == '#') prefix = f;
+		else {
+			for (prefix = q; prefix > a && base[prefix - 1] != '/'; prefix--);
+			// the empty path after an authority is "/"
+			slash = prefix == a && a > s;
+		}
+		if (max_len - len < prefix + slash) return HTML_LINK_DROPPED;
+		memmove(p + prefix + slash, p, len);
+		memcpy(p, base, prefix);
+		if (slash) p[prefix] = '/';
+		len += prefix + slash;
+	}
+	s = html_parser_url_scheme(p, len);
+	if (!s || (a = html_parser_url_authority(p, len, s)) == s) return len;
+	for (q = a; q < len && p[q] != '?' && p[q] != '#'; q++);
+	// every segment is taken with the '/' before it
+	for (i = o = a; i < q; i = e) {
+		for (e = i + 1; e < q && p[e] != '/'; e++);
+		if (e - i == 2 && p[i + 1] == '.') {
+			if (e == q) p[o++] = '/';
+		} else if (e - i == 3 && p[i + 1] == '.' && p[i + 2] == '.') {
+			while (o > a && p[--o] != '/');
+			if (e == q) p[o++] = '/';
+		} else {
+			memmove(p + o, p + i, e - i);
+			o += e - i;
+		}
+	}
+	memmove(p + o, p + q, len - q);
+	return o + len - q;
+}
+
+/*
+ * Resolves the URL of the n chars pointed by p to the end
+ * of the link buffer. Returns its length, 0 if it is empty,
+ * or HTML_LINK_DROPPED.
+ */
+static size_t html_parser_link_resolve(struct html_parser_links *k, const char *p, size_t n) {
+	char *dst = k->buffer + k->buffer_len;
+	size_t max_len = k->buffer_max_len - k->buffer_len, len = html_parser_url_decode(dst, max_len, p, n);
+	if (!len || len == HTML_LINK_DROPPED) return len;
+	return html_parser_url_resolve(k->base, k->base_len, dst, len, max_len);
+}
+
+/*
+ * Appends the link of the len chars at the end of the buffer
+ * to the list, unless dedup finds it already there.
+ */
+static void html_parser_link_add(struct html_parser_links *k, char kind, size_t len) {
+	const char *p = k->buffer + k->buffer_len;
+	HTMLSTREAMPARSER_LINK *l;
+	unsigned int h = 2166136261u;
+	size_t i, *slot = NULL;
+	if (k->set) {
+		for (i = 0; i < len; i++) h = (h ^ (unsigned char) p[i]) * 16777619u;
+		for (slot = k->set + (h & k->set_mask); *slot; slot = k->set + ((slot - k->set + 1) & k->set_mask)) {
+			l = k->list + *slot - 1;
+			if (l->len == len && !memcmp(k->buffer + l->offset, p, len)) return;
+		}
+	}
+	if (k->len == k->max_len) { k->dropped++; return; }
+	l = k->list + k->len++;
+	l->offset = k->buffer_len;
+	l->len = len;
+	l->tag_id = k->tag;
+	l->kind = kind;
+	k->buffer_len += len;
+	if (slot) *slot = k->len;
+}
+
+static void html_parser_link_put(struct html_parser_links *k, char kind, const char *p, size_t n) {
+	size_t len = html_parser_link_resolve(k, p, n);
+	if (len == HTML_LINK_DROPPED) k->dropped++;
+	else if (len) html_parser_link_add(k, kind, len);
+}
+
+/*
+ * Puts every candidate URL of the srcset of the n chars pointed by p,
+ * each followed by its descriptors up to a comma not in parentheses.
+ */
+static void html_parser_link_srcset(struct html_parser_links *k, const char *p, size_t n) {
+	const char *end = p + n, *u, *e;
+	int depth;
+	while (p < end) {
+		while (p < end && (html_parser_isurlspace(*p) || *p == ',')) p++;
+		for (u = p; p < end && !html_parser_isurlspace(*p); p++);
+		// the commas ending a URL end the candidate
+		for (e = p; e > u && e[-1] == ','; e--);
+		if (e == p) for (depth = 0; p < end && (*p != ',' || depth > 0); p++) depth += (*p == '(') - (*p == ')');
+		html_parser_link_put(k, HTML_LINK_SRCSET, u, e - u);
+	}
+}
+
+/*
+ * Returns the URL in the content of a refresh meta
+ * of the n chars pointed by p, like "5; url='next'",
+ * and sets the n argument to its length.
+ */
+static const char *html_parser_refresh_url(const char *p, size_t *n) {
+	const char *end = p + *n, *q;
+	while (p < end && html_parser_isurlspace(*p)) p++;
+	while (p < end && (html_parser_isdigit(*p) || *p == '.')) p++;
+	while (p < end && html_parser_isurlspace(*p)) p++;
+	if (p < end && (*p == ';' || *p == ',')) p++;
+	while (p < end && html_parser_isurlspace(*p)) p++;
+	if (end - p > 3 && (p[0] | 0x20) == 'u' && (p[1] | 0x20) == 'r' && (p[2] | 0x20) == 'l') {
+		for (q = p + 3; q < end && html_parser_isurlspace(*q); q++);
+		if (q < end && *q == '=') for (p = q + 1; p < end && html_parser_isurlspace(*p); p++);
+	}
+	if (p < end && (*p == '"' || *p == '\'')) {
+		for (q = p + 1; q < end && *q != *p; q++);
+		*n = q - p - 1;
+		return p + 1;
+	}
+	*n = end - p;
+	return p;
+}
+
+static void html_parser_links_base(struct html_parser_links *k, const char *p, size_t n) {
+	size_t len = html_parser_link_resolve(k, p, n);
+	if (len == HTML_LINK_DROPPED) { k->dropped++; return; }
+	if (!len) return;
+	// only the first base element sets the base URL
+	if (!k->base_set && len < HTML_LINK_URL_SIZE) {
+		memcpy(k->base, k->buffer + k->buffer_len, len);
+		k->base_len = len;
+	}
+	k->base_set = 1;
+	html_parser_link_add(k, HTML_LINK_BASE, len);
+}
+
+static void html_parser_links_tag(struct html_parser_links *k, int tag) {
+	k->tag = tag;
+	k->refresh = 0;
+	k->pending_len = 0;
+}
+
+static void html_parser_links_attribute(struct html_parser_links *k, const char *name, size_t name_len, const char *value, size_t value_len) {
+	int tag = k->tag, i;
+	size_t len, max_len;
+	char kind, *dst;
+	if (!value || tag == HTML_TAG_ID_UNKNOWN || name_len < 3 || name_len > 10) return;
+	switch (html_parser_attr_name_id(name, name_len)) {
+		case HTML_ATTR_ID_HREF:
+			if (tag == HTML_TAG_ID_BASE) { html_parser_links_base(k, value, value_len); return; }
+			if (tag != HTML_TAG_ID_A && tag != HTML_TAG_ID_AREA && tag != HTML_TAG_ID_LINK) return;
+			kind = HTML_LINK_HREF;
+			break;
+		case HTML_ATTR_ID_SRC:
+			switch (tag) {
+				case HTML_TAG_ID_IMG: case HTML_TAG_ID_SCRIPT: case HTML_TAG_ID_IFRAME: case HTML_TAG_ID_FRAME: case HTML_TAG_ID_EMBED:
+				case HTML_TAG_ID_SOURCE: case HTML_TAG_ID_AUDIO: case HTML_TAG_ID_VIDEO: case HTML_TAG_ID_TRACK: case HTML_TAG_ID_INPUT:
+					break;
+				default:
+					return;
+			}
+			kind = HTML_LINK_SRC;
+			break;
+		case HTML_ATTR_ID_SRCSET:
+			if (tag == HTML_TAG_ID_IMG || tag == HTML_TAG_ID_SOURCE) html_parser_link_srcset(k, value, value_len);
+			return;
+		case HTML_ATTR_ID_ACTION:
+			if (tag != HTML_TAG_ID_FORM) return;
+			kind = HTML_LINK_ACTION;
+			break;
+		case HTML_ATTR_ID_FORMACTION:
+			if (tag != HTML_TAG_ID_BUTTON && tag != HTML_TAG_ID_INPUT) return;
+			kind = HTML_LINK_ACTION;
+			break;
+		case HTML_ATTR_ID_HTTP_EQUIV:
+			if (tag != HTML_TAG_ID_META) return;
+			while (value_len && html_parser_isurlspace(*value)) { value++; value_len--; }
+			while (value_len && html_parser_isurlspace(value[value_len - 1])) value_len--;
+			for (i = 0; i < 7 && (size_t) i < value_len && html_parser_tolower((unsigned char) value[i]) == "refresh"[i]; i++);
+			k->refresh = i == 7 && value_len == 7;
+			return;
+		case HTML_ATTR_ID_CONTENT:
+			if (tag != HTML_TAG_ID_META) return;
+			// the content is decoded before the URL is looked for
+			dst = k->buffer + k->buffer_len;
+			max_len = k->buffer_max_len - k->buffer_len;
+			if ((len = html_parser_url_decode(dst, max_len, value, value_len)) != HTML_LINK_DROPPED) {
+				value = html_parser_refresh_url(dst, &len);
+				memmove(dst, value, len);
+				if (len) len = html_parser_url_resolve(k->base, k->base_len, dst, len, max_len);
+			}
+			k->pending_len = len;
+			return;
+		default:
+			return;
+	}
+	html_parser_link_put(k, kind, value, value_len);
+}
+
+static void html_parser_links_tag_end(struct html_parser_links *k) {
+	if (k->refresh && k->pending_len == HTML_LINK_DROPPED) k->dropped++;
+	else if (k->refresh && k->pending_len) html_parser_link_add(k, HTML_LINK_REFRESH, k->pending_len);
+	k->tag = HTML_TAG_ID_UNKNOWN;
+	k->refresh = 0;
+	k->pending_len = 0;
+}
+
+// whether anything takes the events of html_parser_parse
+static int html_parser_events_set(HTMLSTREAMPARSER *hsp) { return hsp->callbacks || hsp->links || hsp->visible || hsp->tape; }
+
+/*
+ * Frees the carry buffer once none of the callbacks,
+ * the links, the visible text and the tape need it.
+ */
+static void html_parser_release_carry(HTMLSTREAMPARSER *hsp) {
+	if (html_parser_events_set(hsp)) return;
+	free(hsp->carry);
+	hsp->carry = NULL;
+	hsp->carry_len = 0;
+	hsp->carry_max_len = 0;
+}
+
+int html_parser_set_links(HTMLSTREAMPARSER *hsp, HTMLSTREAMPARSER_LINK *list, size_t length, char *buffer, size_t buffer_length, char dedup) {
+	struct html_parser_links *k;
+	size_t size = 16;
+	html_parser_release_links(hsp);
+	if (!(k = (struct html_parser_links *) calloc(1, sizeof(struct html_parser_links)))) return -1;
+	if (dedup) {
+		while (size < 2 * length) size *= 2;
+		if (!(k->set = (size_t *) calloc(size, sizeof(size_t)))) { free(k); return -1; }
+		k->set_mask = size - 1;
+	}
+	k->list = list;
+	k->max_len = length;
+	k->buffer = buffer;
+	k->buffer_max_len = buffer_length;
+	k->tag = HTML_TAG_ID_UNKNOWN;
+	if (!html_parser_events_set(hsp)) {
+		memset(hsp->span, 0, sizeof(hsp->span));
+		hsp->carry_len = 0;
+	}
+	hsp->links = k;
+	html_parser_configure(hsp);
+	return 0;
+}
+
+int html_parser_set_links_url(HTMLSTREAMPARSER *hsp, const char *url, size_t len) {
+	struct html_parser_links *k = hsp->links;
+	if (!k || len >= HTML_LINK_URL_SIZE) return -1;
+	memcpy(k->url, url, len);
+	k->url_len = len;
+	if (!k->base_set) {
+		memcpy(k->base, url, len);
+		k->base_len = len;
+	}
+	return 0;
+}
+
+size_t html_parser_links_length(HTMLSTREAMPARSER *hsp) { return hsp->links ? hsp->links->len : 0; }
+
+size_t html_parser_links_dropped(HTMLSTREAMPARSER *hsp) { return hsp->links ? hsp->links->dropped : 0; }
+
+void html_parser_clear_links(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_links *k = hsp->links;
+	if (!k) return;
+	// a pending meta content moves along
+	if (k->pending_len && k->pending_len != HTML_LINK_DROPPED) memmove(k->buffer, k->buffer + k->buffer_len, k->pending_len);
+	k->len = 0;
+	k->buffer_len = 0;
+	k->dropped = 0;
+	if (k->set) memset(k->set, 0, (k->set_mask + 1) * sizeof(size_t));
+}
+
+void html_parser_release_links(HTMLSTREAMPARSER *hsp) {
+	if (!hsp->links) return;
+	free(hsp->links->set);
+	free(hsp->links);
+	hsp->links = NULL;
+	html_parser_release_carry(hsp);
+	html_parser_configure(hsp);
+}
+
+static void html_parser_links_restart(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_links *k = hsp->links;
+	if (!k) return;
+	k->tag = HTML_TAG_ID_UNKNOWN;
+	k->refresh = 0;
+	k->pending_len = 0;
+	html_parser_clear_links(hsp);
+	k->base_set = 0;
+	memcpy(k->base, k->url, k->url_len);
+	k->base_len = k->url_len;
+}
+
+/*
+ * The state of the visible text extractor. The ring holds
+ * len chars from begin on, wrapping at its size. A separator
+ * waits for the next text, so none is written before the first
+ * text nor after the last one, a newline wins over a space.
+ * The head is 0 before the head element, 1 in it and 2 after it.
+ */
+struct html_parser_visible {
+	char *ring;
+	size_t size;
+	size_t begin;
+	size_t len;
+	size_t low_water;
+	void (*low)(HTMLSTREAMPARSER *hsp, void *user);
+	void *user;
+	size_t dropped;
+	int tag;
+	char head;
+	char separator;
+	char started;
+	char pre_begin;
+	unsigned int pre;
+	unsigned int skip;
+};
+
+/*
+ * Returns the separator written around the element
+ * of the tag id, a newline, a space or 0 if none.
+ */
+static char html_parser_visible_separator(int tag) {
+	switch (tag) {
+		case HTML_TAG_ID_ADDRESS: case HTML_TAG_ID_ARTICLE: case HTML_TAG_ID_ASIDE: case HTML_TAG_ID_BLOCKQUOTE: case HTML_TAG_ID_BR:
+		case HTML_TAG_ID_CAPTION: case HTML_TAG_ID_CENTER: case HTML_TAG_ID_DD: case HTML_TAG_ID_DETAILS: case HTML_TAG_ID_DIALOG:
+		case HTML_TAG_ID_DIR: case HTML_TAG_ID_DIV: case HTML_TAG_ID_DL: case HTML_TAG_ID_DT: case HTML_TAG_ID_FIELDSET:
+		case HTML_TAG_ID_FIGCAPTION: case HTML_TAG_ID_FIGURE: case HTML_TAG_ID_FOOTER: case HTML_TAG_ID_FORM: case HTML_TAG_ID_H1:
+		case HTML_TAG_ID_H2: case HTML_TAG_ID_H3: case HTML_TAG_ID_H4: case HTML_TAG_ID_H5: case HTML_TAG_ID_H6:
+		case HTML_TAG_ID_HEADER: case HTML_TAG_ID_HGROUP: case HTML_TAG_ID_HR: case HTML_TAG_ID_LEGEND: case HTML_TAG_ID_LI:
+		case HTML_TAG_ID_LISTING: case HTML_TAG_ID_MAIN: case HTML_TAG_ID_MENU: case HTML_TAG_ID_NAV: case HTML_TAG_ID_OL:
+		case HTML_TAG_ID_OPTION: case HTML_TAG_ID_P: case HTML_TAG_ID_PRE: case HTML_TAG_ID_SEARCH: case HTML_TAG_ID_SECTION:
+		case HTML_TAG_ID_SUMMARY: case HTML_TAG_ID_TABLE: case HTML_TAG_ID_TEXTAREA: case HTML_TAG_ID_TR: case HTML_TAG_ID_UL:
+		case HTML_TAG_ID_XMP:
+			return '\n';
+		case HTML_TAG_ID_TD: case HTML_TAG_ID_TH:
+			return ' ';
+		default:
+			return 0;
+	}
+}
+
+// the elements which can be in the head
+static int html_parser_visible_head_tag(int tag) {
+	return tag == HTML_TAG_ID_HEAD || tag == HTML_TAG_ID_TITLE || tag == HTML_TAG_ID_META || tag == HTML_TAG_ID_LINK || tag == HTML_TAG_ID_BASE
+		|| tag == HTML_TAG_ID_STYLE || tag == HTML_TAG_ID_SCRIPT || tag == HTML_TAG_ID_NOSCRIPT || tag == HTML_TAG_ID_TEMPLATE;
+}
+
+/*
+ * Writes the n chars pointed by p to the ring as a whole,
+ * calling the low function first if they do not fit.
+ */
+static void html_parser_visible_put(HTMLSTREAMPARSER *hsp, struct html_parser_visible *v, const char *p, size_t n) {
+	size_t room = v->size - v->len, end, k;
+	if (room < n && v->low) {
+		v->low(hsp, v->user);
+		room = v->size - v->len;
+	}
+	if (room < n) { v->dropped += n; return; }
+	end = (v->begin + v->len) % v->size;
+	k = v->size - end < n ? v->size - end : n;
+	memcpy(v->ring + end, p, k);
+	memcpy(v->ring, p + k, n - k);
+	v->len += n;
+	if (v->low && room >= v->low_water && room - n < v->low_water) v->low(hsp, v->user);
+}
+
+static void html_parser_visible_chars(HTMLSTREAMPARSER *hsp, struct html_parser_visible *v, const char *p, size_t n) {
+	if (v->separator && v->started) html_parser_visible_put(hsp, v, &v->separator, 1);
+	v->separator = 0;
+	v->started = 1;
+	html_parser_visible_put(hsp, v, p, n);
+}
+
+static void html_parser_visible_separate(struct html_parser_visible *v, char c) { if (c == '\n' || !v->separator) v->separator = c; }
+
+/*
+ * Writes the text of the n chars pointed by p, decoding
+ * the references if decode is set and collapsing the
+ * whitespace unless pre is set. A run of chars goes
+ * to the ring as a whole, so a ring too full
+ * leaves out whole words and characters.
+ */
+static void html_parser_visible_text_put(HTMLSTREAMPARSER *hsp, struct html_parser_visible *v, const char *p, size_t n, char decode, char pre) {
+	const char *end = p + n, *q, *value;
+	size_t k;
+	char u[4];
+	// a newline right after the start tag of pre is left out
+	if (pre && v->pre_begin && p < end && *p == '\r') p++;
+	if (pre && v->pre_begin && p < end && *p == '\n') p++;
+	v->pre_begin = 0;
+	while (p < end) {
+		if (!pre && html_parser_isurlspace(*p)) {
+			html_parser_visible_separate(v, ' ');
+			p++;
+		} else if (decode && *p == '&' && (q = html_parser_reference(p, end, &value, &k, u))) {
+			html_parser_visible_chars(hsp, v, value, k);
+			p = q;
+		} else {
+			for (q = p + 1; q < end && *q != '&' && (pre || !html_parser_isurlspace(*q)); q++);
+			html_parser_visible_chars(hsp, v, p, q - p);
+			p = q;
+		}
+	}
+}
+
+static void html_parser_visible_text_event(HTMLSTREAMPARSER *hsp, struct html_parser_visible *v, const char *p, size_t n) {
+	size_t i;
+	if (v->skip) return;
+	if (v->head == 1) {
+		// text in the head ends it, but whitespace
+		for (i = 0; i < n && html_parser_isurlspace(p[i]); i++);
+		if (i == n) return;
+		v->head = 2;
+	}
+	html_parser_visible_text_put(hsp, v, p, n, 1, v->pre != 0);
+}
+
+// the text of xmp and textarea, the only raw text elements shown
+static void html_parser_visible_raw_event(HTMLSTREAMPARSER *hsp, struct html_parser_visible *v, const char *p, size_t n) {
+	if (v->skip || (v->tag != HTML_TAG_ID_XMP && v->tag != HTML_TAG_ID_TEXTAREA)) return;
+	html_parser_visible_text_put(hsp, v, p, n, v->tag == HTML_TAG_ID_TEXTAREA, 1);
+}
+
+static void html_parser_visible_tag(struct html_parser_visible *v, int tag, char closing) {
+	char c = html_parser_visible_separator(tag);
+	if (!closing) {
+		v->tag = tag;
+		if (tag == HTML_TAG_ID_HEAD && !v->head) v->head = 1;
+		else if (v->head == 1 && !html_parser_visible_head_tag(tag)) v->head = 2;
+		if (tag == HTML_TAG_ID_TEMPLATE) v->skip++;
+		else if (tag == HTML_TAG_ID_PRE || tag == HTML_TAG_ID_LISTING) v->pre++;
+		v->pre_begin = tag == HTML_TAG_ID_PRE || tag == HTML_TAG_ID_LISTING || tag == HTML_TAG_ID_TEXTAREA;
+	} else {
+		v->tag = HTML_TAG_ID_UNKNOWN;
+		if (tag == HTML_TAG_ID_HEAD && v->head == 1) v->head = 2;
+		else if (tag == HTML_TAG_ID_TEMPLATE && v->skip) v->skip--;
+		else if ((tag == HTML_TAG_ID_PRE || tag == HTML_TAG_ID_LISTING) && v->pre) v->pre--;
+	}
+	if (c && !v->skip && v->head != 1) html_parser_visible_separate(v, c);
+}
+
+int html_parser_set_visible_text(HTMLSTREAMPARSER *hsp, char *ring, size_t size, size_t low_water, void (*low)(HTMLSTREAMPARSER *hsp, void *user), void *user) {
+	struct html_parser_visible *v;
+	if (!size) return -1;
+	html_parser_release_visible_text(hsp);
+	if (!(v = (struct html_parser_visible *) calloc(1, sizeof(struct html_parser_visible)))) return -1;
+	v->ring = ring;
+	v->size = size;
+	v->low_water = low_water;
+	v->low = low;
+	v->user = user;
+	v->tag = HTML_TAG_ID_UNKNOWN;
+	if (!html_parser_events_set(hsp)) {
+		memset(hsp->span, 0, sizeof(hsp->span));
+		hsp->carry_len = 0;
+	}
+	hsp->visible = v;
+	html_parser_configure(hsp);
+	return 0;
+}
+
+size_t html_parser_visible_text_length(HTMLSTREAMPARSER *hsp) { return hsp->visible ? hsp->visible->len : 0; }
+
+const char *html_parser_visible_text(HTMLSTREAMPARSER *hsp, size_t *len) {
+	struct html_parser_visible *v = hsp->visible;
+	if (!v) { *len = 0; return NULL; }
+	*len = v->size - v->begin < v->len ? v->size - v->begin : v->len;
+	return v->ring + v->begin;
+}
+
+void html_parser_consume_visible_text(HTMLSTREAMPARSER *hsp, size_t len) {
+	struct html_parser_visible *v = hsp->visible;
+	if (!v) return;
+	if (len > v->len) len = v->len;
+	v->begin = (v->begin + len) % v->size;
+	v->len -= len;
+}
+
+size_t html_parser_visible_text_dropped(HTMLSTREAMPARSER *hsp) { return hsp->visible ? hsp->visible->dropped : 0; }
+
+void html_parser_release_visible_text(HTMLSTREAMPARSER *hsp) {
+	if (!hsp->visible) return;
+	free(hsp->visible);
+	hsp->visible = NULL;
+	html_parser_release_carry(hsp);
+	html_parser_configure(hsp);
+}
+
+static void html_parser_visible_restart(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_visible *v = hsp->visible;
+	if (!v) return;
+	v->begin = 0;
+	v->len = 0;
+	v->dropped = 0;
+	v->tag = HTML_TAG_ID_UNKNOWN;
+	v->head = 0;
+	v->separator = 0;
+	v->started = 0;
+	v->pre_begin = 0;
+	v->pre = 0;
+	v->skip = 0;
+}
+
+/*
+ * The state of the tape. The chars of the stream from base
+ * on are in the buffer passed to html_parser_parse, unless
+ * they are decoded or inflated. The stack holds the open
+ * elements: the index of the start tag, the hash of its name
+ * an end tag is matched by and the tag id. A void element
+ * has its next set at the end of its start tag.
+ */
+#define HTML_TAPE_STACK_SIZE 64
+
+struct html_parser_tape_element {
+	unsigned int index;
+	unsigned int hash;
+	int id;
+};
+
+struct html_parser_tape {
+	HTMLSTREAMPARSER_TOKEN *tokens;
+	size_t len;
+	size_t max_len;
+	char *arena;
+	size_t arena_len;
+	size_t arena_max_len;
+	size_t dropped;
+	unsigned long long base;
+	const char *buf;
+	size_t buf_len;
+	char source;
+	size_t last_void;
+	struct html_parser_tape_element *stack;
+	unsigned int depth;
+	unsigned int tag_depth;
+	unsigned int stack_max_len;
+};
+
+static int html_parser_void_tag(int tag) {
+	switch (tag) {
+		case HTML_TAG_ID_AREA: case HTML_TAG_ID_BASE: case HTML_TAG_ID_BASEFONT: case HTML_TAG_ID_BGSOUND: case HTML_TAG_ID_BR:
+		case HTML_TAG_ID_COL: case HTML_TAG_ID_EMBED: case HTML_TAG_ID_FRAME: case HTML_TAG_ID_HR: case HTML_TAG_ID_IMAGE:
+		case HTML_TAG_ID_IMG: case HTML_TAG_ID_INPUT: case HTML_TAG_ID_KEYGEN: case HTML_TAG_ID_LINK: case HTML_TAG_ID_META:
+		case HTML_TAG_ID_PARAM: case HTML_TAG_ID_SOURCE: case HTML_TAG_ID_TRACK: case HTML_TAG_ID_WBR:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+static unsigned int html_parser_tape_hash(const char *p, size_t n) {
+	unsigned int h = 2166136261u;
+	while (n--) h = (h ^ (unsigned char) html_parser_tolower((unsigned char) *p++)) * 16777619u;
+	return h;
+}
+
+/*
+ * Sets the offset and len of the n chars pointed by p in
+ * the stream or, with the flag set, copied to the arena.
+ * Returns 0 or -1 if they fit neither.
+ */
+static int html_parser_tape_chars(struct html_parser_tape *k, const char *p, size_t n, unsigned int *offset, unsigned int *len, unsigned char *flags, unsigned char flag) {
+	size_t i = (size_t) p - (size_t) k->buf;
+	if (n > UINT_MAX) return -1;
+	if (k->source && i <= k->buf_len && n <= k->buf_len - i && k->base + i + n <= UINT_MAX) {
+		*offset = (unsigned int) (k->base + i);
+		*len = (unsigned int) n;
+		return 0;
+	}
+	if (k->arena_max_len - k->arena_len < n) return -1;
+	memcpy(k->arena + k->arena_len, p, n);
+	*offset = (unsigned int) k->arena_len;
+	*len = (unsigned int) n;
+	*flags |= flag;
+	k->arena_len += n;
+	return 0;
+}
+
+/*
+ * Appends the token, the value is the one of an attribute.
+ * Returns the token or NULL if the tape has ended.
+ */
+static HTMLSTREAMPARSER_TOKEN *html_parser_tape_put(struct html_parser_tape *k, char kind, int id, const char *p, size_t n, const char *value, size_t value_len) {
+	HTMLSTREAMPARSER_TOKEN *t = k->tokens + k->len;
+	size_t arena_len = k->arena_len;
+	if (k->dropped || k->len == k->max_len) { k->dropped++; return NULL; }
+	t->kind = kind;
+	t->flags = kind == HTML_TOKEN_ATTRIBUTE && !value ? HTML_TOKEN_NO_VALUE : 0;
+	t->id = id;
+	t->depth = kind == HTML_TOKEN_ATTRIBUTE ? k->tag_depth : k->depth;
+	t->value_offset = 0;
+	t->value_len = 0;
+	t->next = 0;
+	if (html_parser_tape_chars(k, p, n, &t->offset, &t->len, &t->flags, HTML_TOKEN_ARENA)
+		|| (value && html_parser_tape_chars(k, value, value_len, &t->value_offset, &t->value_len, &t->flags, HTML_TOKEN_VALUE_ARENA))) {
+		k->arena_len = arena_len;
+		k->dropped++;
+		return NULL;
+	}
+	k->len++;
+	return t;
+}
+
+static void html_parser_tape_start_tag(struct html_parser_tape *k, int id, const char *p, size_t n) {
+	struct html_parser_tape_element *e;
+	k->tag_depth = k->depth;
+	if (!html_parser_tape_put(k, HTML_TOKEN_START_TAG, id, p, n, NULL, 0)) return;
+	if (html_parser_void_tag(id)) { k->last_void = k->len; return; }
+	if (k->depth == k->stack_max_len) {
+		if (!(e = (struct html_parser_tape_element *) realloc(k->stack, 2 * k->stack_max_len * sizeof(struct html_parser_tape_element)))) {
+			// the tape ends without the element
+			k->len--;
+			k->dropped++;
+			return;
+		}
+		k->stack = e;
+		k->stack_max_len *= 2;
+	}
+	e = k->stack + k->depth++;
+	e->index = (unsigned int) (k->len - 1);
+	e->hash = html_parser_tape_hash(p, n);
+	e->id = id;
+}
+
+/*
+ * Closes the element of the end tag and the ones
+ * left open in it, a stray end tag closes none.
+ */
+static void html_parser_tape_end_tag(struct html_parser_tape *k, int id, const char *p, size_t n) {
+	unsigned int h = html_parser_tape_hash(p, n), top = k->depth, depth = k->depth;
+	while (depth && k->stack[depth - 1].hash != h) depth--;
+	if (!depth) {
+		html_parser_tape_put(k, HTML_TOKEN_END_TAG, id, p, n, NULL, 0);
+		return;
+	}
+	k->depth = --depth;
+	if (!html_parser_tape_put(k, HTML_TOKEN_END_TAG, id, p, n, NULL, 0)) { k->depth = top; return; }
+	k->tokens[k->stack[depth].index].next = (unsigned int) k->len;
+	// the elements left open in it end right before the end tag
+	while (--top > depth) k->tokens[k->stack[top].index].next = (unsigned int) (k->len - 1);
+}
+
+// the text is in the innermost open element
+static void html_parser_tape_text(struct html_parser_tape *k, char kind, const char *p, size_t n) {
+	html_parser_tape_put(k, kind, k->depth ? k->stack[k->depth - 1].id : HTML_TAG_ID_UNKNOWN, p, n, NULL, 0);
+}
+
+static void html_parser_tape_tag_end(struct html_parser_tape *k) {
+	if (k->last_void) k->tokens[k->last_void - 1].next = (unsigned int) k->len;
+	k->last_void = 0;
+}
+
+static void html_parser_tape_buffer(HTMLSTREAMPARSER *hsp, const char *buf, size_t len) {
+	struct html_parser_tape *k = hsp->tape;
+	k->buf = buf;
+	k->buf_len = len;
+	k->source = !hsp->charset && !hsp->inflate;
+}
+
+int html_parser_set_tape(HTMLSTREAMPARSER *hsp, HTMLSTREAMPARSER_TOKEN *tokens, size_t length, char *arena, size_t arena_length) {
+	struct html_parser_tape *k;
+	if (arena_length > UINT_MAX) return -1;
+	html_parser_release_tape(hsp);
+	if (!(k = (struct html_parser_tape *) calloc(1, sizeof(struct html_parser_tape)))) return -1;
+	if (!(k->stack = (struct html_parser_tape_element *) malloc(HTML_TAPE_STACK_SIZE * sizeof(struct html_parser_tape_element)))) { free(k); return -1; }
+	k->stack_max_len = HTML_TAPE_STACK_SIZE;
+	k->tokens = tokens;
+	k->max_len = length;
+	k->arena = arena;
+	k->arena_max_len = arena_length;
+	if (!html_parser_events_set(hsp)) {
+		memset(hsp->span, 0, sizeof(hsp->span));
+		hsp->carry_len = 0;
+	}
+	hsp->tape = k;
+	html_parser_configure(hsp);
+	return 0;
+}
+
+size_t html_parser_tape_length(HTMLSTREAMPARSER *hsp) { return hsp->tape ? hsp->tape->len : 0; }
+
+size_t html_parser_tape_dropped(HTMLSTREAMPARSER *hsp) { return hsp->tape ? hsp->tape->dropped : 0; }
+
+void html_parser_end_tape(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_tape *k = hsp->tape;
+	if (!k) return;
+	html_parser_tape_tag_end(k);
+	while (k->depth) k->tokens[k->stack[--k->depth].index].next = (unsigned int) k->len;
+}
+
+void html_parser_release_tape(HTMLSTREAMPARSER *hsp) {
+	if (!hsp->tape) return;
+	free(hsp->tape->stack);
+	free(hsp->tape);
+	hsp->tape = NULL;
+	html_parser_release_carry(hsp);
+	html_parser_configure(hsp);
+}
+
+static void html_parser_tape_restart(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_tape *k = hsp->tape;
+	if (!k) return;
+	k->len = 0;
+	k->arena_len = 0;
+	k->dropped = 0;
+	k->base = 0;
+	k->buf = NULL;
+	k->buf_len = 0;
+	k->last_void = 0;
+	k->depth = 0;
+	k->tag_depth = 0;
+}
+
+size_t html_parser_tape_find(const HTMLSTREAMPARSER_TOKEN *tape, size_t len, size_t from, int kind, int id) {
+	for (; from < len; from++) if (tape[from].kind == kind && (id < 0 || tape[from].id == id)) return from;
+	return len;
+}
+
+const char *html_parser_token_name(const HTMLSTREAMPARSER_TOKEN *token, const char *source, const char *arena) {
+	return (token->flags & HTML_TOKEN_ARENA ? arena : source) + token->offset;
+}
+
+const char *html_parser_token_value(const HTMLSTREAMPARSER_TOKEN *token, const char *source, const char *arena) {
+	if (token->kind != HTML_TOKEN_ATTRIBUTE || (token->flags & HTML_TOKEN_NO_VALUE)) return NULL;
+	return (token->flags & HTML_TOKEN_VALUE_ARENA ? arena : source) + token->value_offset;
+}
+
+static void html_parser_emit_attribute(HTMLSTREAMPARSER *hsp, char with_value) {
+	const char *name, *value = NULL;
+	size_t name_len, value_len = 0;
+	if (with_value) { value = html_parser_span(hsp, HTML_SPAN_VALUE, &value_len); hsp->span[HTML_SPAN_VALUE].state = 0; }
+	if (hsp->span[HTML_SPAN_ATTRIBUTE].state == 2) { name = html_parser_span(hsp, HTML_SPAN_ATTRIBUTE, &name_len); hsp->span[HTML_SPAN_ATTRIBUTE].state = 0; }
+	else { name = ""; name_len = 0; }
+	if (hsp->links) html_parser_links_attribute(hsp->links, name, name_len, value, value_len);
+	if (hsp->tape) html_parser_tape_put(hsp->tape, HTML_TOKEN_ATTRIBUTE, html_parser_attr_name_id(name, name_len), name, name_len, value, value_len);
+	if (hsp->callbacks && hsp->callbacks->attribute) hsp->callbacks->attribute(hsp->user, name, name_len, value, value_len);
+}
+
+// the callbacks of a parser taking the events only by the links, the visible text or the tape
+static const HTMLSTREAMPARSER_CALLBACKS html_parser_no_callbacks;
+
+/*
+ * Splits the span of a raw text element at the "</" of its
+ * end tag, returning the text length and setting the tag
+ * arguments to the name. A span begun inside the end tag,
+ * by a restore or by setting the callbacks, has no text.
+ */
+static size_t html_parser_raw_split(HTMLSTREAMPARSER *hsp, const char *b, size_t len, const char **tag, size_t *tag_len) {
+	size_t n = hsp->script_len <= len && len - hsp->script_len >= 2 ? hsp->script_len : 0;
+	*tag = b + (len >= n + 2 ? n + 2 : len);
+	*tag_len = b + len - *tag;
+	return n;
+}
+
+/*
+ * Calls the callbacks for the char pointed by p
+ * which has just moved the parser by the action.
+ */
+static void html_parser_events(HTMLSTREAMPARSER *hsp, int action, const char *p) {
+	const HTMLSTREAMPARSER_CALLBACKS *cb = hsp->callbacks ? hsp->callbacks : &html_parser_no_callbacks;
+	HTMLSTREAMPARSER_SPAN *t = hsp->span;
+	const char *b, *tag;
+	size_t len, n, tag_len;
+	int id = HTML_TAG_ID_UNKNOWN;
+	char closing;
+	switch (action) {
+		case HTML_ACTION_TAG_OPEN:
+			if (!t[HTML_SPAN_TEXT].state) break;
+			html_parser_span_close(hsp, HTML_SPAN_TEXT, p);
+			b = html_parser_span(hsp, HTML_SPAN_TEXT, &len);
+			t[HTML_SPAN_TEXT].state = 0;
+			if (hsp->visible) html_parser_visible_text_event(hsp, hsp->visible, b, len);
+			if (hsp->tape) html_parser_tape_text(hsp->tape, HTML_TOKEN_TEXT, b, len);
+			if (cb->text) cb->text(hsp->user, b, len);
+			break;
+		case HTML_ACTION_TEXT_OPEN:
+			hsp->carry_len = 0;
+			html_parser_span_begin(hsp, HTML_SPAN_TEXT, p);
+			break;
+		case HTML_ACTION_NAME_OPEN:
+		case HTML_ACTION_CLOSING:
+			hsp->carry_len = 0;
+			html_parser_span_begin(hsp, HTML_SPAN_TAG, action == HTML_ACTION_CLOSING ? p + 1 : p);
+			break;
+		case HTML_ACTION_NAME_END:
+		case HTML_ACTION_NAME_SPACE:
+			html_parser_span_close(hsp, HTML_SPAN_TAG, p);
+			b = html_parser_span(hsp, HTML_SPAN_TAG, &len);
+			t[HTML_SPAN_TAG].state = 0;
+			closing = (hsp->html_part & HTML_BIT(HTML_CLOSING_TAG)) != 0;
+			if (hsp->links || hsp->visible || hsp->tape) id = html_parser_tag_name_id(b, len);
+			if (hsp->links) html_parser_links_tag(hsp->links, closing ? HTML_TAG_ID_UNKNOWN : id);
+			if (hsp->visible) html_parser_visible_tag(hsp->visible, id, closing);
+			if (hsp->tape && closing) html_parser_tape_end_tag(hsp->tape, id, b, len);
+			else if (hsp->tape) html_parser_tape_start_tag(hsp->tape, id, b, len);
+			if (hsp->html_part & HTML_BIT(HTML_CLOSING_TAG)) { if (cb->end_tag) cb->end_tag(hsp->user, b, len); }
+			else if (cb->start_tag) cb->start_tag(hsp->user, b, len);
+			break;
+		case HTML_ACTION_ATTRIBUTE_OPEN:
+			if (t[HTML_SPAN_ATTRIBUTE].state) html_parser_emit_attribute(hsp, 0);
+			hsp->carry_len = 0;
+			html_parser_span_begin(hsp, HTML_SPAN_ATTRIBUTE, p);
+			break;
+		case HTML_ACTION_ATTRIBUTE_END:
+		case HTML_ACTION_ATTRIBUTE_EQUALITY:
+		case HTML_ACTION_ATTRIBUTE_SPACE:
+			html_parser_span_close(hsp, HTML_SPAN_ATTRIBUTE, p);
+			break;
+		case HTML_ACTION_DQ_OPEN:
+		case HTML_ACTION_SQ_OPEN:
+			html_parser_span_begin(hsp, HTML_SPAN_VALUE, p + 1);
+			break;
+		case HTML_ACTION_UNQUOTED_OPEN:
+			html_parser_span_begin(hsp, HTML_SPAN_VALUE, p);
+			break;
+		case HTML_ACTION_DQ_EMPTY:
+		case HTML_ACTION_VALUE_END:
+		case HTML_ACTION_UNQUOTED_END:
+		case HTML_ACTION_UNQUOTED_SPACE:
+			html_parser_span_close(hsp, HTML_SPAN_VALUE, p);
+			html_parser_emit_attribute(hsp, 1);
+			break;
+		case HTML_ACTION_COMMENT_OPEN:
+		case HTML_ACTION_COMMENT_BEGIN:
+			hsp->carry_len = 0;
+			html_parser_span_begin(hsp, HTML_SPAN_COMMENT, p + 1);
+			break;
+		case HTML_ACTION_CDATA_OPEN:
+		case HTML_ACTION_DOCTYPE_OPEN:
+			t[HTML_SPAN_COMMENT].state = 0;
+			break;
+		case HTML_ACTION_COMMENT_END:
+		case HTML_ACTION_COMMENT_FLUSH_END:
+			// the "--", "--!" or "]]" held back is not in the comment
+			if (!t[HTML_SPAN_COMMENT].state) break;
+			html_parser_span_close(hsp, HTML_SPAN_COMMENT, p);
+			b = html_parser_span(hsp, HTML_SPAN_COMMENT, &len);
+			t[HTML_SPAN_COMMENT].state = 0;
+			if (hsp->tape) html_parser_tape_text(hsp->tape, HTML_TOKEN_COMMENT, b, len - hsp->held_len);
+			if (cb->comment) cb->comment(hsp->user, b, len - hsp->held_len);
+			break;
+		case HTML_ACTION_SCRIPT_OPEN:
+			hsp->carry_len = 0;
+			html_parser_span_begin(hsp, HTML_SPAN_SCRIPT, p);
+			break;
+		case HTML_ACTION_SCRIPT_END:
+		case HTML_ACTION_SCRIPT_SPACE:
+			// the span holds the script followed by the closing tag chars
+			html_parser_span_close(hsp, HTML_SPAN_SCRIPT, p);
+			b = html_parser_span(hsp, HTML_SPAN_SCRIPT, &len);
+			t[HTML_SPAN_SCRIPT].state = 0;
+			n = html_parser_raw_split(hsp, b, len, &tag, &tag_len);
+			if (hsp->tape) {
+				html_parser_tape_text(hsp->tape, HTML_TOKEN_SCRIPT, b, n);
+				html_parser_tape_end_tag(hsp->tape, HTML_TAG_ID_SCRIPT, tag, tag_len);
+			}
+			if (cb->script) cb->script(hsp->user, b, n);
+			if (cb->end_tag) cb->end_tag(hsp->user, tag, tag_len);
+			break;
+		case HTML_ACTION_RAW_OPEN:
+		case HTML_ACTION_RAW_OPEN_LT:
+			hsp->carry_len = 0;
+			html_parser_span_begin(hsp, HTML_SPAN_TEXT, p);
+			break;
+		case HTML_ACTION_RAW_END:
+		case HTML_ACTION_RAW_SPACE:
+			// the same for the text of the other raw text elements
+			html_parser_span_close(hsp, HTML_SPAN_TEXT, p);
+			b = html_parser_span(hsp, HTML_SPAN_TEXT, &len);
+			t[HTML_SPAN_TEXT].state = 0;
+			n = html_parser_raw_split(hsp, b, len, &tag, &tag_len);
+			if (hsp->visible) {
+				html_parser_visible_raw_event(hsp, hsp->visible, b, n);
+				html_parser_visible_tag(hsp->visible, html_parser_tag_name_id(tag, tag_len), 1);
+			}
+			if (hsp->tape) {
+				if (n) html_parser_tape_text(hsp->tape, HTML_TOKEN_TEXT, b, n);
+				html_parser_tape_end_tag(hsp->tape, html_parser_tag_name_id(tag, tag_len), tag, tag_len);
+			}
+			if (cb->text && n) cb->text(hsp->user, b, n);
+			if (cb->end_tag) cb->end_tag(hsp->user, tag, tag_len);
+			break;
+	}
+	// the span is not open when the callbacks were set inside the text
+	if (hsp->parser_state == HTML_STATE_SCRIPT_LT) hsp->script_len = t[HTML_SPAN_SCRIPT].state == 1 ? t[HTML_SPAN_SCRIPT].carry_len + (p - t[HTML_SPAN_SCRIPT].begin) : 0;
+	else if (hsp->parser_state == HTML_STATE_RAW_LT) hsp->script_len = t[HTML_SPAN_TEXT].state == 1 ? t[HTML_SPAN_TEXT].carry_len + (p - t[HTML_SPAN_TEXT].begin) : 0;
+	if ((html_parser_actions[action].set & HTML_BIT(HTML_TAG_END)) && t[HTML_SPAN_ATTRIBUTE].state) html_parser_emit_attribute(hsp, 0);
+	if ((html_parser_actions[action].set & HTML_BIT(HTML_TAG_END)) && hsp->links) html_parser_links_tag_end(hsp->links);
+	if ((html_parser_actions[action].set & HTML_BIT(HTML_TAG_END)) && hsp->tape) html_parser_tape_tag_end(hsp->tape);
+}
+
+/*
+ * Moves the parser by the run of n chars staying
+ * in the current state, i.e. not containing the char
+ * scanned for in this state.
+ */
+static void html_parser_run(HTMLSTREAMPARSER *hsp, const char *p, size_t n) {
+	const struct html_parser_action *a = &html_parser_actions[html_parser_transitions[(int) hsp->parser_state][HTML_CLASS_OTHER] & 0xff];
+#ifdef HTML_PARSER_STATS
+	hsp->stats.state_bytes[(int) hsp->parser_state] += n;
+#endif
+	hsp->html_part = (hsp->html_part & ~a->clear) | a->set;
+	if (a->capture == HTML_CAPTURE_TEXT || a->capture == HTML_CAPTURE_RAW_TEXT) {
+		if (hsp->skip_text) { hsp->inner_text_real_len += n; return; }
+		if (hsp->inner_text_collapse) {
+			html_parser_text_collapse(hsp, p, n);
+			hsp->inner_text_real_len += n;
+			return;
+		}
+		if (hsp->inner_text_max_len - hsp->inner_text_len < n) html_parser_arena_grow(hsp, HTML_INNER_TEXT, n);
+#ifdef HTML_PARSER_STATS
+		if (hsp->inner_text_max_len - hsp->inner_text_len < n) html_parser_stats_truncate(hsp, HTML_BUFFER_INNER_TEXT, hsp->inner_text);
+#endif
+		html_parser_capture_run(hsp->inner_text, &hsp->inner_text_len, &hsp->inner_text_real_len, hsp->inner_text_max_len, p, n, 0);
+	} else if (a->capture == HTML_CAPTURE_COMMENT) {
+#ifdef HTML_PARSER_STATS
+		if (hsp->comment_max_len - hsp->comment_len < n) html_parser_stats_truncate(hsp, HTML_BUFFER_COMMENT, hsp->comment);
+#endif
+		html_parser_capture_run(hsp->comment, &hsp->comment_len, &hsp->comment_real_len, hsp->comment_max_len, p, n, 0);
+	} else if (a->capture == HTML_CAPTURE_VALUE) {
+		if (hsp->skip_value) { hsp->attr_value_real_len += n; return; }
+		if (hsp->attr_value_max_len - hsp->attr_value_len < n) html_parser_arena_grow(hsp, HTML_VALUE, n);
+#ifdef HTML_PARSER_STATS
+		if (hsp->attr_value_max_len - hsp->attr_value_len < n) html_parser_stats_truncate(hsp, HTML_BUFFER_VALUE, hsp->attr_value);
+#endif
+		html_parser_capture_run(hsp->attr_value, &hsp->attr_value_len, &hsp->attr_value_real_len, hsp->attr_value_max_len, p, n, hsp->attr_val_to_lower);
+	}
+}
+
+static HTML_ALWAYS_INLINE void html_parser_tokenize_variant(HTMLSTREAMPARSER *hsp, const char *buf, size_t len, const int v) {
+	const char *p = buf, *end = buf + len, *q;
+	char c;
+	int kind, action;
+	if (v & HTML_VARIANT_CALLBACKS) for (kind = 0; kind < HTML_SPAN_SIZE; kind++) if (hsp->span[kind].state == 1) hsp->span[kind].begin = buf;
+	while (p < end) {
+		if ((c = html_parser_scan_chars[(int) hsp->parser_state]) && !hsp->entity_len) {
+			// the references are decoded char by char, unless skipped
+			q = html_parser_scan(p, end, c, hsp->decode_entities && (c == '<' ? !hsp->skip_text : (c == '"' || c == '\'') && !hsp->skip_value) ? '&' : c);
+			if (q != p) { html_parser_run(hsp, p, q - p); p = q; }
+			if (p == end) break;
+		}
+		action = html_parser_step_variant(hsp, *p, v);
+		if (v & HTML_VARIANT_CALLBACKS) html_parser_events(hsp, action, p);
+		p++;
+	}
+	if (v & HTML_VARIANT_CALLBACKS) html_parser_span_carry(hsp, end);
+}
+
+#define HTML_PARSER_TOKENIZE(v) \
+	static void html_parser_tokenize_##v(HTMLSTREAMPARSER *hsp, const char *buf, size_t len) { html_parser_tokenize_variant(hsp, buf, len, v); }
+
+HTML_PARSER_TOKENIZE(0)
+HTML_PARSER_TOKENIZE(1)
+HTML_PARSER_TOKENIZE(3)
+HTML_PARSER_TOKENIZE(5)
+HTML_PARSER_TOKENIZE(7)
+HTML_PARSER_TOKENIZE(9)
+HTML_PARSER_TOKENIZE(11)
+HTML_PARSER_TOKENIZE(13)
+HTML_PARSER_TOKENIZE(15)
+HTML_PARSER_TOKENIZE(16)
+HTML_PARSER_TOKENIZE(17)
+HTML_PARSER_TOKENIZE(19)
+HTML_PARSER_TOKENIZE(21)
+HTML_PARSER_TOKENIZE(23)
+HTML_PARSER_TOKENIZE(25)
+HTML_PARSER_TOKENIZE(27)
+HTML_PARSER_TOKENIZE(29)
+HTML_PARSER_TOKENIZE(31)
+
+// the variants folding the case without capturing are never chosen
+static void (*const html_parser_tokenizers[HTML_VARIANT_SIZE])(HTMLSTREAMPARSER *hsp, const char *buf, size_t len) = {
+	html_parser_tokenize_0, html_parser_tokenize_1, html_parser_tokenize_0, html_parser_tokenize_3,
+	html_parser_tokenize_0, html_parser_tokenize_5, html_parser_tokenize_0, html_parser_tokenize_7,
+	html_parser_tokenize_0, html_parser_tokenize_9, html_parser_tokenize_0, html_parser_tokenize_11,
+	html_parser_tokenize_0, html_parser_tokenize_13, html_parser_tokenize_0, html_parser_tokenize_15,
+	html_parser_tokenize_16, html_parser_tokenize_17, html_parser_tokenize_16, html_parser_tokenize_19,
+	html_parser_tokenize_16, html_parser_tokenize_21, html_parser_tokenize_16, html_parser_tokenize_23,
+	html_parser_tokenize_16, html_parser_tokenize_25, html_parser_tokenize_16, html_parser_tokenize_27,
+	html_parser_tokenize_16, html_parser_tokenize_29, html_parser_tokenize_16, html_parser_tokenize_31
+};
+
+static void html_parser_configure(HTMLSTREAMPARSER *hsp) {
+	int v = html_parser_variant(hsp);
+	hsp->step = html_parser_steps[v & ~HTML_VARIANT_CALLBACKS];
+	hsp->tokenize = html_parser_tokenizers[v];
+}
+
+static void html_parser_tokenize(HTMLSTREAMPARSER *hsp, const char *buf, size_t len) { hsp->tokenize(hsp, buf, len); }
+
+/*
+ * The charset stage decodes the input to UTF-8 before the
+ * tokenizer. The valid runs of UTF-8 and the ASCII runs of
+ * the other ASCII compatible charsets are passed on as they
+ * are, the rest is transcoded into the window. The chars of
+ * a sequence cut by the end of a buffer wait in pending for
+ * the next one, the first chars of a document whose charset
+ * is sniffed wait in head.
+ */
+#define HTML_CHARSET_SNIFF_SIZE 1024
+#define HTML_CHARSET_WINDOW 4096
+
+struct html_parser_charset {
+	void (*sink)(HTMLSTREAMPARSER *hsp, const char *p, size_t n);
+	char charset;
+	char current;
+	unsigned char pending[4];
+	unsigned char pending_len;
+	size_t head_len;
+	char head[HTML_CHARSET_SNIFF_SIZE];
+	char window[HTML_CHARSET_WINDOW];
+};
+
+static const unsigned short *html_parser_charset_tables[HTML_CHARSET_SIZE] = {
+	[HTML_CHARSET_WINDOWS_1252] = html_charset_windows_1252,
+	[HTML_CHARSET_ISO_8859_2] = html_charset_iso_8859_2,
+	[HTML_CHARSET_ISO_8859_15] = html_charset_iso_8859_15,
+	[HTML_CHARSET_WINDOWS_1250] = html_charset_windows_1250,
+	[HTML_CHARSET_WINDOWS_1251] = html_charset_windows_1251,
+	[HTML_CHARSET_KOI8_R] = html_charset_koi8_r
+};
+
+/*
+ * The labels of the supported charsets as in the
+ * Encoding Standard, "utf-16" being little endian.
+ */
+static const struct html_parser_charset_label {
+	const char *label;
+	char charset;
+} html_parser_charset_labels[] = {
+	{ "utf-8", HTML_CHARSET_UTF_8 },
+	{ "utf8", HTML_CHARSET_UTF_8 },
+	{ "unicode-1-1-utf-8", HTML_CHARSET_UTF_8 },
+	{ "utf-16", HTML_CHARSET_UTF_16LE },
+	{ "utf-16le", HTML_CHARSET_UTF_16LE },
+	{ "utf-16be", HTML_CHARSET_UTF_16BE },
+	{ "windows-1252", HTML_CHARSET_WINDOWS_1252 },
+	{ "iso-8859-1", HTML_CHARSET_WINDOWS_1252 },
+	{ "iso8859-1", HTML_CHARSET_WINDOWS_1252 },
+	{ "iso88591", HTML_CHARSET_WINDOWS_1252 },
+	{ "iso_8859-1", HTML_CHARSET_WINDOWS_1252 },
+	{ "iso_8859-1:1987", HTML_CHARSET_WINDOWS_1252 },
+	{ "latin1", HTML_CHARSET_WINDOWS_1252 },
+	{ "l1", HTML_CHARSET_WINDOWS_1252 },
+	{ "ascii", HTML_CHARSET_WINDOWS_1252 },
+	{ "us-ascii", HTML_CHARSET_WINDOWS_1252 },
+	{ "ansi_x3.4-1968", HTML_CHARSET_WINDOWS_1252 },
+	{ "cp1252", HTML_CHARSET_WINDOWS_1252 },
+	{ "x-cp1252", HTML_CHARSET_WINDOWS_1252 },
+	{ "cp819", HTML_CHARSET_WINDOWS_1252 },
+	{ "ibm819", HTML_CHARSET_WINDOWS_1252 },
+	{ "iso-ir-100", HTML_CHARSET_WINDOWS_1252 },
+	{ "csisolatin1", HTML_CHARSET_WINDOWS_1252 },
+	{ "iso-8859-2", HTML_CHARSET_ISO_8859_2 },
+	{ "iso8859-2", HTML_CHARSET_ISO_8859_2 },
+	{ "iso88592", HTML_CHARSET_ISO_8859_2 },
+	{ "iso_8859-2", HTML_CHARSET_ISO_8859_2 },
+	{ "latin2", HTML_CHARSET_ISO_8859_2 },
+	{ "l2", HTML_CHARSET_ISO_8859_2 },
+	{ "csisolatin2", HTML_CHARSET_ISO_8859_2 },
+	{ "iso-8859-15", HTML_CHARSET_ISO_8859_15 },
+	{ "iso8859-15", HTML_CHARSET_ISO_8859_15 },
+	{ "iso885915", HTML_CHARSET_ISO_8859_15 },
+	{ "iso_8859-15", HTML_CHARSET_ISO_8859_15 },
+	{ "latin9", HTML_CHARSET_ISO_8859_15 },
+	{ "l9", HTML_CHARSET_ISO_8859_15 },
+	{ "csisolatin9", HTML_CHARSET_ISO_8859_15 },
+	{ "windows-1250", HTML_CHARSET_WINDOWS_1250 },
+	{ "cp1250", HTML_CHARSET_WINDOWS_1250 },
+	{ "x-cp1250", HTML_CHARSET_WINDOWS_1250 },
+	{ "windows-1251", HTML_CHARSET_WINDOWS_1251 },
+	{ "cp1251", HTML_CHARSET_WINDOWS_1251 },
+	{ "x-cp1251", HTML_CHARSET_WINDOWS_1251 },
+	{ "koi8-r", HTML_CHARSET_KOI8_R },
+	{ "koi8_r", HTML_CHARSET_KOI8_R },
+	{ "koi8", HTML_CHARSET_KOI8_R },
+	{ "koi", HTML_CHARSET_KOI8_R },
+	{ "cskoi8r", HTML_CHARSET_KOI8_R },
+	{ "shift_jis", HTML_CHARSET_SHIFT_JIS },
+	{ "shift-jis", HTML_CHARSET_SHIFT_JIS },
+	{ "sjis", HTML_CHARSET_SHIFT_JIS },
+	{ "ms_kanji", HTML_CHARSET_SHIFT_JIS },
+	{ "ms932", HTML_CHARSET_SHIFT_JIS },
+	{ "windows-31j", HTML_CHARSET_SHIFT_JIS },
+	{ "x-sjis", HTML_CHARSET_SHIFT_JIS },
+	{ "csshiftjis", HTML_CHARSET_SHIFT_JIS }
+};
+
+#define HTML_CHARSET_LABELS (sizeof(html_parser_charset_labels) / sizeof(html_parser_charset_labels[0]))
+
+static const char html_parser_replacement[] = "\xef\xbf\xbd";
+
+int html_parser_charset_id(const char *label, size_t len) {
+	size_t i, j;
+	while (len && ishtmlspace(*label)) { label++; len--; }
+	while (len && ishtmlspace(label[len - 1])) len--;
+	for (i = 0; i < HTML_CHARSET_LABELS; i++) {
+		const char *l = html_parser_charset_labels[i].label;
+		for (j = 0; j < len && l[j] && html_parser_tolower((unsigned char) label[j]) == l[j]; j++);
+		if (j == len && !l[j]) return html_parser_charset_labels[i].charset;
+	}
+	return HTML_CHARSET_NONE;
+}
+
+int html_parser_set_charset(HTMLSTREAMPARSER *hsp, int charset) {
+	struct html_parser_charset *f = hsp->charset;
+	if (charset <= HTML_CHARSET_NONE || charset >= HTML_CHARSET_SIZE) {
+		html_parser_release_charset(hsp);
+		return charset == HTML_CHARSET_NONE ? 0 : -1;
+	}
+	if (!f && !(f = (struct html_parser_charset *) malloc(sizeof(struct html_parser_charset)))) return -1;
+	f->sink = NULL;
+	f->charset = f->current = charset;
+	f->pending_len = 0;
+	f->head_len = 0;
+	hsp->charset = f;
+	return 0;
+}
+
+void html_parser_release_charset(HTMLSTREAMPARSER *hsp) {
+	free(hsp->charset);
+	hsp->charset = NULL;
+}
+
+int html_parser_charset(HTMLSTREAMPARSER *hsp) { return hsp->charset ? hsp->charset->current : HTML_CHARSET_NONE; }
+
+static void html_parser_charset_restart(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_charset *f = hsp->charset;
+	if (!f) return;
+	f->current = f->charset;
+	f->pending_len = 0;
+	f->head_len = 0;
+}
+
+/*
+ * Returns the length of the ASCII run the n chars
+ * pointed by p begin with.
+ */
+static size_t html_parser_ascii(const unsigned char *p, size_t n) {
+	const unsigned char *q = p, *end = p + n;
+#if defined(__AVX2__)
+	while (end - q >= 32) {
+		unsigned int m = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *) q));
+		if (m) return q - p + __builtin_ctz(m);
+		q += 32;
+	}
+#endif
+#if defined(__SSE2__)
+	while (end - q >= 16) {
+		unsigned int m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) q));
+		if (m) return q - p + __builtin_ctz(m);
+		q += 16;
+	}
+#endif
+	while (q < end && *q < 0x80) q++;
+	return q - p;
+}
+
+/*
+ * Returns the length of the valid UTF-8 the n chars pointed
+ * by p begin with. If a bad sequence follows, its length,
+ * the maximal subpart of the Encoding Standard, is put into
+ * bad, otherwise bad is 0 and the chars left, if any, are
+ * the beginning of a sequence cut by the end of the buffer.
+ */
+static size_t html_parser_utf8_prefix(const unsigned char *p, size_t n, size_t *bad) {
+	size_t i = 0, k, need;
+	unsigned char lo, hi;
+	*bad = 0;
+	while (i < n) {
+		if (p[i] < 0x80) { i += html_parser_ascii(p + i, n - i); continue; }
+		lo = 0x80;
+		hi = 0xbf;
+		if (p[i] >= 0xc2 && p[i] <= 0xdf) need = 1;
+		else if (p[i] >= 0xe0 && p[i] <= 0xef) {
+			need = 2;
+			if (p[i] == 0xe0) lo = 0xa0;
+			else if (p[i] == 0xed) hi = 0x9f;
+		} else if (p[i] >= 0xf0 && p[i] <= 0xf4) {
+			need = 3;
+			if (p[i] == 0xf0) lo = 0x90;
+			else if (p[i] == 0xf4) hi = 0x8f;
+		} else {
+			*bad = 1;
+			return i;
+		}
+		for (k = 1; k <= need && i + k < n; k++) {
+			if (p[i + k] < lo || p[i + k] > hi) {
+				*bad = k;
+				return i;
+			}
+			lo = 0x80;
+			hi = 0xbf;
+		}
+		if (k <= need) return i;
+		i += k;
+	}
+	return i;
+}
+
+/*
+ * Puts the code point c into the window as UTF-8 at w,
+ * passing the window on when full. Returns the new w.
+ */
+static size_t html_parser_window_put(HTMLSTREAMPARSER *hsp, struct html_parser_charset *f, size_t w, unsigned long c) {
+	if (w + 4 > HTML_CHARSET_WINDOW) {
+		f->sink(hsp, f->window, w);
+		w = 0;
+	}
+	return w + html_parser_utf8_put(f->window + w, c);
+}
+
+static void html_parser_decode_utf8(HTMLSTREAMPARSER *hsp, struct html_parser_charset *f, const unsigned char *p, size_t n) {
+	size_t v, bad;
+	while (f->pending_len && n) {
+		f->pending[f->pending_len++] = *p++;
+		n--;
+		v = html_parser_utf8_prefix(f->pending, f->pending_len, &bad);
+		if (v) {
+			f->sink(hsp, (const char *) f->pending, v);
+			f->pending_len = 0;
+		} else if (bad) {
+			// the last char is not a part of the bad sequence
+			f->sink(hsp, html_parser_replacement, 3);
+			f->pending_len = 0;
+			p--;
+			n++;
+		}
+	}
+	while (n) {
+		v = html_parser_utf8_prefix(p, n, &bad);
+		if (v) f->sink(hsp, (const char *) p, v);
+		p += v;
+		n -= v;
+		if (bad) {
+			f->sink(hsp, html_parser_replacement, 3);
+			p += bad;
+			n -= bad;
+		} else if (n) {
+			memcpy(f->pending, p, n);
+			f->pending_len = n;
+			n = 0;
+		}
+	}
+}
+
+static void html_parser_decode_single(HTMLSTREAMPARSER *hsp, struct html_parser_charset *f, const unsigned char *p, size_t n) {
+	const unsigned short *table = html_parser_charset_tables[(int) f->current];
+	size_t a, w;
+	while (n) {
+		if ((a = html_parser_ascii(p, n))) f->sink(hsp, (const char *) p, a);
+		p += a;
+		n -= a;
+		for (w = 0; n && *p >= 0x80; p++, n--) w = html_parser_window_put(hsp, f, w, table[*p - 0x80]);
+		if (w) f->sink(hsp, f->window, w);
+	}
+}
+
+/*
+ * Shift_JIS as in the Encoding Standard, the lead char
+ * of a double char waits in pending.
+ */
+static void html_parser_decode_shift_jis(HTMLSTREAMPARSER *hsp, struct html_parser_charset *f, const unsigned char *p, size_t n) {
+	size_t w = 0, a, ptr;
+	unsigned long c;
+	while (n) {
+		if (f->pending_len) {
+			f->pending_len = 0;
+			c = 0;
+			if (*p >= 0x40 && *p <= 0xfc && *p != 0x7f) {
+				ptr = (f->pending[0] - (f->pending[0] < 0xa0 ? 0x81 : 0xc1)) * 188 + *p - (*p < 0x7f ? 0x40 : 0x41);
+				c = ptr >= 8836 && ptr <= 10715 ? 0xe000 + ptr - 8836 : html_charset_jis0208[ptr];
+			}
+			// an ASCII char after a bad lead char is taken again
+			if (c || *p >= 0x80) {
+				p++;
+				n--;
+			}
+			w = html_parser_window_put(hsp, f, w, c ? c : 0xfffd);
+		} else if (*p < 0x80) {
+			if (w) f->sink(hsp, f->window, w);
+			w = 0;
+			a = html_parser_ascii(p, n);
+			f->sink(hsp, (const char *) p, a);
+			p += a;
+			n -= a;
+		} else {
+			c = *p++;
+			n--;
+			if (c == 0x80) w = html_parser_window_put(hsp, f, w, 0x80);
+			else if (c >= 0xa1 && c <= 0xdf) w = html_parser_window_put(hsp, f, w, 0xff61 + c - 0xa1);
+			else if ((c >= 0x81 && c <= 0x9f) || (c >= 0xe0 && c <= 0xfc)) {
+				f->pending[0] = c;
+				f->pending_len = 1;
+			} else w = html_parser_window_put(hsp, f, w, 0xfffd);
+		}
+	}
+	if (w) f->sink(hsp, f->window, w);
+}
+
+/*
+ * UTF-16 of either byte order, a char cut by the end of
+ * a buffer and a high surrogate wait in pending.
+ */
+static void html_parser_decode_utf16(HTMLSTREAMPARSER *hsp, struct html_parser_charset *f, const unsigned char *p, size_t n) {
+	int be = f->current == HTML_CHARSET_UTF_16BE;
+	unsigned char *q;
+	unsigned long u, hi;
+	size_t w = 0;
+	while (n--) {
+		f->pending[f->pending_len++] = *p++;
+		if (f->pending_len & 1) continue;
+		q = f->pending + f->pending_len - 2;
+		u = be ? q[0] << 8 | q[1] : q[1] << 8 | q[0];
+		if (f->pending_len == 4) {
+			hi = be ? f->pending[0] << 8 | f->pending[1] : f->pending[1] << 8 | f->pending[0];
+			if (u >= 0xdc00 && u <= 0xdfff) {
+				w = html_parser_window_put(hsp, f, w, 0x10000 + ((hi - 0xd800) << 10) + u - 0xdc00);
+				f->pending_len = 0;
+				continue;
+			}
+			// an unpaired high surrogate, u is taken again
+			w = html_parser_window_put(hsp, f, w, 0xfffd);
+			f->pending[0] = q[0];
+			f->pending[1] = q[1];
+		}
+		if (u >= 0xd800 && u <= 0xdbff) f->pending_len = 2;
+		else {
+			f->pending_len = 0;
+			w = html_parser_window_put(hsp, f, w, u >= 0xdc00 && u <= 0xdfff ? 0xfffd : u);
+		}
+	}
+	if (w) f->sink(hsp, f->window, w);
+}
+
+static void html_parser_decode_run(HTMLSTREAMPARSER *hsp, struct html_parser_charset *f, const unsigned char *p, size_t n) {
+	switch (f->current) {
+		case HTML_CHARSET_UTF_8:
+			html_parser_decode_utf8(hsp, f, p, n);
+			break;
+		case HTML_CHARSET_UTF_16LE:
+		case HTML_CHARSET_UTF_16BE:
+			html_parser_decode_utf16(hsp, f, p, n);
+			break;
+		case HTML_CHARSET_SHIFT_JIS:
+			html_parser_decode_shift_jis(hsp, f, p, n);
+			break;
+		default:
+			html_parser_decode_single(hsp, f, p, n);
+	}
+}
+
+static int html_parser_meta_match(const char *p, const char *end, const char *name) {
+	for (; *name; p++, name++) if (p == end || html_parser_tolower((unsigned char) *p) != *name) return 0;
+	return 1;
+}
+
+/*
+ * Looks for a charset in the meta tags of the n chars
+ * pointed by p, after "charset" and an '=' either in
+ * its own attribute or in the content of the tag.
+ * The comments are skipped.
+ */
+static int html_parser_charset_meta(const char *p, size_t n) {
+	const char *end = p + n, *q, *v;
+	int charset;
+	while ((p = (const char *) memchr(p, '<', end - p))) {
+		if (html_parser_meta_match(p, end, "<!--")) {
+			for (q = p + 4; q + 3 <= end && memcmp(q, "-->", 3); q++);
+			if (q + 3 > end) return HTML_CHARSET_NONE;
+			p = q + 3;
+			continue;
+		}
+		p++;
+		if (!html_parser_meta_match(p, end, "meta") || p + 4 == end || (!ishtmlspace(p[4]) && p[4] != '/')) continue;
+		for (q = p + 4; q < end && *q != '>'; q++) {
+			if (!html_parser_meta_match(q, end, "charset")) continue;
+			for (v = q + 7; v < end && ishtmlspace(*v); v++);
+			if (v == end || *v != '=') continue;
+			for (v++; v < end && ishtmlspace(*v); v++);
+			if (v < end && (*v == '"' || *v == '\'')) v++;
+			for (q = v; q < end && *q != '"' && *q != '\'' && *q != ';' && *q != '>' && !ishtmlspace(*q); q++);
+			if ((charset = html_parser_charset_id(v, q - v))) return charset;
+			if (q == end) break;
+		}
+		p = q;
+	}
+	return HTML_CHARSET_NONE;
+}
+
+/*
+ * Chooses the charset of the document by the chars
+ * in head: by its byte order mark, skipped, by a meta
+ * tag, or as UTF-8 if they are valid UTF-8 and else as
+ * windows-1252. Then the chars in head are decoded.
+ */
+static void html_parser_charset_sniff(HTMLSTREAMPARSER *hsp, struct html_parser_charset *f) {
+	const unsigned char *h = (const unsigned char *) f->head;
+	size_t bom = 0, bad;
+	if (f->head_len >= 3 && h[0] == 0xef && h[1] == 0xbb && h[2] == 0xbf) {
+		f->current = HTML_CHARSET_UTF_8;
+		bom = 3;
+	} else if (f->head_len >= 2 && h[0] == 0xff && h[1] == 0xfe) {
+		f->current = HTML_CHARSET_UTF_16LE;
+		bom = 2;
+	} else if (f->head_len >= 2 && h[0] == 0xfe && h[1] == 0xff) {
+		f->current = HTML_CHARSET_UTF_16BE;
+		bom = 2;
+	} else if ((f->current = html_parser_charset_meta(f->head, f->head_len))) {
+		// a document read as ASCII cannot really be UTF-16
+		if (f->current == HTML_CHARSET_UTF_16LE || f->current == HTML_CHARSET_UTF_16BE) f->current = HTML_CHARSET_UTF_8;
+	} else {
+		// a sequence cut by the end is bad unless it is the end of head
+		f->current = html_parser_utf8_prefix(h, f->head_len, &bad) == f->head_len || (!bad && f->head_len == HTML_CHARSET_SNIFF_SIZE) ? HTML_CHARSET_UTF_8 : HTML_CHARSET_WINDOWS_1252;
+	}
+	html_parser_decode_run(hsp, f, h + bom, f->head_len - bom);
+	f->head_len = 0;
+}
+
+static void html_parser_decode(HTMLSTREAMPARSER *hsp, const char *buf, size_t len, void (*sink)(HTMLSTREAMPARSER *hsp, const char *p, size_t n)) {
+	struct html_parser_charset *f = hsp->charset;
+	size_t k;
+	f->sink = sink;
+	if (f->current == HTML_CHARSET_AUTO) {
+		k = HTML_CHARSET_SNIFF_SIZE - f->head_len;
+		if (k > len) k = len;
+		memcpy(f->head + f->head_len, buf, k);
+		f->head_len += k;
+		buf += k;
+		len -= k;
+		if (f->head_len < HTML_CHARSET_SNIFF_SIZE) return;
+		html_parser_charset_sniff(hsp, f);
+	}
+	if (len) html_parser_decode_run(hsp, f, (const unsigned char *) buf, len);
+}
+
+void html_parser_flush(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_charset *f = hsp->charset;
+	if (!f) return;
+	if (f->current == HTML_CHARSET_AUTO) html_parser_charset_sniff(hsp, f);
+	if (f->pending_len) f->sink(hsp, html_parser_replacement, 3);
+	f->pending_len = 0;
+}
+
+static void html_parser_char_run(HTMLSTREAMPARSER *hsp, const char *p, size_t n) {
+	int (*step)(HTMLSTREAMPARSER *hsp, const char c) = hsp->step;
+	while (n--) step(hsp, *p++);
+}
+
+void html_parser_char_parse(HTMLSTREAMPARSER *hsp, const char c) {
+	if (hsp->charset) html_parser_decode(hsp, &c, 1, html_parser_char_run);
+	else hsp->step(hsp, c);
+}
+
+void html_parser_parse(HTMLSTREAMPARSER *hsp, const char *buf, size_t len) {
+	if (hsp->tape) html_parser_tape_buffer(hsp, buf, len);
+	if (hsp->charset) html_parser_decode(hsp, buf, len, html_parser_tokenize);
+	else html_parser_tokenize(hsp, buf, len);
+	if (hsp->tape) hsp->tape->base += len;
+}
+
+void html_parser_set_callbacks(HTMLSTREAMPARSER *hsp, const HTMLSTREAMPARSER_CALLBACKS *callbacks, void *user) {
+	hsp->callbacks = callbacks;
+	hsp->user = user;
+	memset(hsp->span, 0, sizeof(hsp->span));
+	hsp->carry_len = 0;
+	html_parser_configure(hsp);
+}
+
+void html_parser_release_callbacks(HTMLSTREAMPARSER *hsp) {
+	hsp->callbacks = NULL;
+	hsp->user = NULL;
+	html_parser_release_carry(hsp);
+	html_parser_configure(hsp);
+}
+
+/*
+ * The size of the chunks a file not mapped is read in.
+ */
+#define HTML_FILE_CHUNK (64 * 1024)
+
+int html_parser_parse_file(HTMLSTREAMPARSER *hsp, const char *path) {
+	struct stat st;
+	char *buf;
+	ssize_t n;
+	int fd, err = 0;
+	if ((fd = open(path, O_RDONLY)) < 0) return -1;
+	if (fstat(fd, &st)) { err = errno; close(fd); errno = err; return -1; }
+#ifdef HAVE_SYS_MMAN_H
+	if (S_ISREG(st.st_mode) && st.st_size > 0 && (off_t) (size_t) st.st_size == st.st_size
+		&& (buf = (char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+		madvise(buf, st.st_size, MADV_SEQUENTIAL);
+#endif
+		// the spans pending at the end are carried, so the mapping can go
+		html_parser_parse(hsp, buf, st.st_size);
+		html_parser_flush(hsp);
+		munmap(buf, st.st_size);
+		close(fd);
+		return 0;
+	}
+#endif
+	if (!(buf = (char *) malloc(HTML_FILE_CHUNK))) { close(fd); errno = ENOMEM; return -1; }
+	while ((n = read(fd, buf, HTML_FILE_CHUNK)) > 0 || (n < 0 && errno == EINTR)) if (n > 0) html_parser_parse(hsp, buf, n);
+	if (n < 0) err = errno;
+	else html_parser_flush(hsp);
+	free(buf);
+	close(fd);
+	if (err) { errno = err; return -1; }
+	return 0;
+}
+
+#ifdef HTML_PARSER_ZLIB
+#define HTML_INFLATE_WINDOW (16 * 1024)
+
+/*
+ * The state of the stream is 0 until its first two
+ * chars, kept in head, tell the format, then 1 while
+ * inflating, 2 after the end of a gzip member until
+ * the two chars of the next one and 3 after the end
+ * of the stream, when the chars left are ignored.
+ */
+struct html_parser_inflate {
+	z_stream z;
+	char *window;
+	size_t window_len;
+	unsigned char head[2];
+	char head_len;
+	char state;
+};
+
+int html_parser_set_inflate(HTMLSTREAMPARSER *hsp, size_t window) {
+	struct html_parser_inflate *f;
+	html_parser_release_inflate(hsp);
+	if (!window) window = HTML_INFLATE_WINDOW;
+	if (window > UINT_MAX) window = UINT_MAX;
+	if (!(f = (struct html_parser_inflate *) calloc(1, sizeof(struct html_parser_inflate)))) return -1;
+	if (!(f->window = (char *) malloc(window))) { free(f); return -1; }
+	f->window_len = window;
+	hsp->inflate = f;
+	return 0;
+}
+
+void html_parser_release_inflate(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_inflate *f = hsp->inflate;
+	if (!f) return;
+	if (f->state) inflateEnd(&f->z);
+	free(f->window);
+	free(f);
+	hsp->inflate = NULL;
+}
+
+static void html_parser_inflate_restart(HTMLSTREAMPARSER *hsp) {
+	struct html_parser_inflate *f = hsp->inflate;
+	if (!f) return;
+	if (f->state) inflateEnd(&f->z);
+	memset(&f->z, 0, sizeof(z_stream));
+	f->head_len = 0;
+	f->state = 0;
+}
+
+/*
+ * Inflates the n chars into the window and parses
+ * it every time it is filled. Returns -1 if the stream
+ * is corrupt.
+ */
+static int html_parser_inflate_run(HTMLSTREAMPARSER *hsp, const unsigned char *p, size_t n) {
+	struct html_parser_inflate *f = hsp->inflate;
+	uInt in;
+	int ret;
+	while (n) {
+		if (f->state == 3) return 0;
+		// the next gzip member follows, anything else is trailing garbage
+		if (f->state == 2) {
+			while (n && f->head_len < 2) { f->head[(int) f->head_len++] = *p++; n--; }
+			if (f->head_len < 2) return 0;
+			if (f->head[0] != 0x1f || f->head[1] != 0x8b) { f->state = 3; return 0; }
+			if (inflateReset(&f->z) != Z_OK) return -1;
+			f->state = 1;
+			if (html_parser_inflate_run(hsp, f->head, 2)) return -1;
+			continue;
+		}
+		f->z.next_in = (Bytef *) p;
+		f->z.avail_in = in = n < UINT_MAX ? n : UINT_MAX;
+		do {
+			f->z.next_out = (Bytef *) f->window;
+			f->z.avail_out = f->window_len;
+			ret = inflate(&f->z, Z_NO_FLUSH);
+			if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) return -1;
+			if (f->z.avail_out < f->window_len) html_parser_parse(hsp, f->window, f->window_len - f->z.avail_out);
+		} while (ret == Z_OK && (f->z.avail_in || !f->z.avail_out));
+		if (ret == Z_STREAM_END) {
+			f->state = f->head[0] == 0x1f && f->head[1] == 0x8b ? 2 : 3;
+			f->head_len = 0;
+		}
+		p += in - f->z.avail_in;
+		n -= in - f->z.avail_in;
+	}
+	return 0;
+}
+
+int html_parser_inflate(HTMLSTREAMPARSER *hsp, const char *buf, size_t len) {
+	struct html_parser_inflate *f = hsp->inflate;
+	const unsigned char *p = (const unsigned char *) buf;
+	int bits;
+	if (!f) return -1;
+	if (!f->state) {
+		while (len && f->head_len < 2) { f->head[(int) f->head_len++] = *p++; len--; }
+		if (f->head_len < 2) return 0;
+		// a zlib header is a multiple of 31, anything else is raw deflate
+		if (f->head[0] == 0x1f && f->head[1] == 0x8b) bits = 16 + MAX_WBITS;
+		else if ((f->head[0] & 0x0f) == Z_DEFLATED && (f->head[0] << 8 | f->head[1]) % 31 == 0) bits = MAX_WBITS;
+		else bits = -MAX_WBITS;
+		if (inflateInit2(&f->z, bits) != Z_OK) return -1;
+		f->state = 1;
+		if (html_parser_inflate_run(hsp, f->head, 2)) return -1;
+	}
+	if (html_parser_inflate_run(hsp, p, len)) return -1;
+	return f->state >= 2;
+}
+#else
+int html_parser_set_inflate(HTMLSTREAMPARSER *hsp, size_t window) { return -1; }
+
+void html_parser_release_inflate(HTMLSTREAMPARSER *hsp) { }
+
+static void html_parser_inflate_restart(HTMLSTREAMPARSER *hsp) { }
+
+int html_parser_inflate(HTMLSTREAMPARSER *hsp, const char *buf, size_t len) { return -1; }
+#endif
+
+/*
+ * The parallel parsing splits the buffer into chunks
+ * beginning after a '>' and parses them on worker threads
+ * from the state right after a tag, recording the events.
+ * Then the chunks are gone through in order: a chunk whose
+ * previous chunk really ended after a tag has its events
+ * replayed and its worker parser becomes the one holding
+ * the real state, any other chunk is parsed again from the
+ * real state. So script, comment, quoted value or text
+ * which contains the '>' just costs a sequential chunk.
+ */
+#define HTML_PARALLEL_MIN_CHUNK (64 * 1024)
+
+enum {
+	HTML_EVENT_START_TAG,
+	HTML_EVENT_ATTRIBUTE,
+	HTML_EVENT_END_TAG,
+	HTML_EVENT_TEXT,
+	HTML_EVENT_COMMENT,
+	HTML_EVENT_SCRIPT
+};
+
+struct html_parser_event {
+	char kind;
+	const char *text;
+	size_t len;
+	const char *value;
+	size_t value_len;
+};
+
+struct html_parser_chunk {
+	HTMLSTREAMPARSER *hsp;
+	const char *begin;
+	const char *end;
+	struct html_parser_event *events;
+	size_t events_len;
+	size_t events_max_len;
+	char failed;
+	char started;
+	pthread_t thread;
+};
+
+static void html_parser_record(void *user, char kind, const char *text, size_t len, const char *value, size_t value_len) {
+	struct html_parser_chunk *k = (struct html_parser_chunk *) user;
+	struct html_parser_event *e;
+	size_t size = k->events_max_len ? k->events_max_len * 2 : 1024;
+	if (k->failed) return;
+	if (k->events_len == k->events_max_len) {
+		if (!(e = (struct html_parser_event *) realloc(k->events, size * sizeof(struct html_parser_event)))) { k->failed = 1; return; }
+		k->events = e;
+		k->events_max_len = size;
+	}
+	e = k->events + k->events_len++;
+	e->kind = kind; e->text = text; e->len = len; e->value = value; e->value_len = value_len;
+}
+
+static void html_parser_record_start_tag(void *user, const char *name, size_t len) { html_parser_record(user, HTML_EVENT_START_TAG, name, len, NULL, 0); }
+
+static void html_parser_record_attribute(void *user, const char *name, size_t name_len, const char *value, size_t value_len) { html_parser_record(user, HTML_EVENT_ATTRIBUTE, name, name_len, value, value_len); }
+
+static void html_parser_record_end_tag(void *user, const char *name, size_t len) { html_parser_record(user, HTML_EVENT_END_TAG, name, len, NULL, 0); }
+
+static void html_parser_record_text(void *user, const char *text, size_t len) { html_parser_record(user, HTML_EVENT_TEXT, text, len, NULL, 0); }
+
+static void html_parser_record_comment(void *user, const char *text, size_t len) { html_parser_record(user, HTML_EVENT_COMMENT, text, len, NULL, 0); }
+
+static void html_parser_record_script(void *user, const char *text, size_t len) { html_parser_record(user, HTML_EVENT_SCRIPT, text, len, NULL, 0); }
+
+static const HTMLSTREAMPARSER_CALLBACKS html_parser_recorder = {
+	html_parser_record_start_tag,
+	html_parser_record_attribute,
+	html_parser_record_end_tag,
+	html_parser_record_text,
+	html_parser_record_comment,
+	html_parser_record_script
+};
+
+static void *html_parser_chunk_run(void *arg) {
+	struct html_parser_chunk *k = (struct html_parser_chunk *) arg;
+	html_parser_parse(k->hsp, k->begin, k->end - k->begin);
+	return NULL;
+}
+
+/*
+ * Returns 1 if the parser is right after a tag
+ * with no name or text pending, as the workers start.
+ */
+static int html_parser_synced(HTMLSTREAMPARSER *hsp) {
+	int kind;
+	if (hsp->parser_state != HTML_STATE_START) return 0;
+	for (kind = 0; kind < HTML_SPAN_SIZE; kind++) if (hsp->span[kind].state) return 0;
+	return 1;
+}
+
+static void html_parser_replay(HTMLSTREAMPARSER *hsp, const struct html_parser_chunk *k) {
+	const HTMLSTREAMPARSER_CALLBACKS *cb = hsp->callbacks;
+	const struct html_parser_event *e;
+	for (e = k->events; e < k->events + k->events_len; e++) {
+		switch (e->kind) {
+			case HTML_EVENT_START_TAG: if (cb->start_tag) cb->start_tag(hsp->user, e->text, e->len); break;
+			case HTML_EVENT_ATTRIBUTE: if (cb->attribute) cb->attribute(hsp->user, e->text, e->len, e->value, e->value_len); break;
+			case HTML_EVENT_END_TAG: if (cb->end_tag) cb->end_tag(hsp->user, e->text, e->len); break;
+			case HTML_EVENT_TEXT: if (cb->text) cb->text(hsp->user, e->text, e->len); break;
+			case HTML_EVENT_COMMENT: if (cb->comment) cb->comment(hsp->user, e->text, e->len); break;
+			case HTML_EVENT_SCRIPT: if (cb->script) cb->script(hsp->user, e->text, e->len); break;
+		}
+	}
+}
+
+#ifdef HTML_PARSER_STATS
+/*
+ * Adds the statistics of the parser x which parsed
+ * a part of the same buffer.
+ */
+static void html_parser_stats_add(HTMLSTREAMPARSER *hsp, HTMLSTREAMPARSER *x) {
+	const HTMLSTREAMPARSER_STATS *s = html_parser_stats(x);
+	int i;
+	for (i = 0; i < HTML_PARSER_STATE_SIZE; i++) hsp->stats.state_bytes[i] += s->state_bytes[i];
+	hsp->stats.tags += s->tags;
+	hsp->stats.attributes += s->attributes;
+	hsp->stats.scripts += s->scripts;
+	hsp->stats.comments += s->comments;
+	hsp->stats.resets += s->resets;
+	for (i = 0; i < HTML_BUFFER_SIZE; i++) {
+		hsp->stats.truncations[i] += s->truncations[i];
+		if (hsp->stats.max_real_len[i] < s->max_real_len[i]) hsp->stats.max_real_len[i] = s->max_real_len[i];
+	}
+}
+#endif
+
+void html_parser_parse_parallel(HTMLSTREAMPARSER *hsp, const char *buf, size_t len, int threads) {
+	struct html_parser_chunk *chunks;
+	HTMLSTREAMPARSER *x = hsp;
+	const char *p = buf, *end = buf + len, *q;
+	int n = 0, i;
+	if (threads > (int) (len / HTML_PARALLEL_MIN_CHUNK)) threads = len / HTML_PARALLEL_MIN_CHUNK;
+	if (!hsp->callbacks || hsp->charset || hsp->links || hsp->visible || hsp->tape || threads < 2 || !(chunks = (struct html_parser_chunk *) calloc(threads, sizeof(struct html_parser_chunk)))) {
+		html_parser_parse(hsp, buf, len);
+		return;
+	}
+	for (i = 1; i <= threads && p < end; i++) {
+		q = i == threads ? end : buf + len / threads * i;
+		if (q < p) continue;
+		if (q < end) q = (const char *) memchr(q, '>', end - q);
+		q = q && q < end ? q + 1 : end;
+		chunks[n].begin = p;
+		chunks[n++].end = q;
+		p = q;
+	}
+	for (i = 1; i < n; i++) {
+		if (!(chunks[i].hsp = html_parser_init())) continue;
+		html_parser_set_callbacks(chunks[i].hsp, &html_parser_recorder, chunks + i);
+		chunks[i].started = !pthread_create(&chunks[i].thread, NULL, html_parser_chunk_run, chunks + i);
+	}
+	html_parser_parse(hsp, chunks[0].begin, chunks[0].end - chunks[0].begin);
+	for (i = 1; i < n; i++) {
+		if (chunks[i].started) pthread_join(chunks[i].thread, NULL);
+		if (chunks[i].started && !chunks[i].failed && html_parser_synced(x)) {
+			html_parser_replay(hsp, chunks + i);
+#ifdef HTML_PARSER_STATS
+			if (x != hsp) html_parser_stats_add(hsp, x);
+#endif
+			if (x != hsp) html_parser_cleanup(x);
+			x = chunks[i].hsp;
+			chunks[i].hsp = NULL;
+		} else {
+			x->callbacks = hsp->callbacks;
+			x->user = hsp->user;
+			html_parser_configure(x);
+			html_parser_parse(x, chunks[i].begin, chunks[i].end - chunks[i].begin);
+		}
+		if (chunks[i].hsp) html_parser_cleanup(chunks[i].hsp);
+		free(chunks[i].events);
+	}
+	if (x != hsp) {
+		// the spans pending at the end are in the carry of x
+		hsp->parser_state = x->parser_state;
+		hsp->html_part = x->html_part;
+		hsp->script_len = x->script_len;
+		hsp->tag_name_real_len = x->tag_name_real_len;
+		hsp->raw = x->raw;
+		memcpy(hsp->held, x->held, sizeof(hsp->held));
+		hsp->held_len = x->held_len;
+		memcpy(hsp->span, x->span, sizeof(hsp->span));
+		hsp->carry_len = 0;
+		html_parser_carry(hsp, x->carry, x->carry_len);
+#ifdef HTML_PARSER_STATS
+		html_parser_stats_add(hsp, x);
+#endif
+		html_parser_cleanup(x);
+	}
+	free(chunks);
+}
+
+void html_parser_restart(HTMLSTREAMPARSER *hsp) {
+#ifdef HTML_PARSER_STATS
+	html_parser_stats(hsp);
+	hsp->stats_truncated = 0;
+#endif
+	hsp->html_part = 0;
+	hsp->parser_state = 0;
+	hsp->tag_name_len = 0;
+	hsp->attr_name_len = 0;
+	hsp->attr_value_len = 0;
+	hsp->inner_text_len = 0;
+	hsp->tag_name_real_len = 0;
+	hsp->attr_name_real_len = 0;
+	hsp->attr_value_real_len = 0;
+	hsp->inner_text_real_len = 0;
+	hsp->inner_text_space = 0;
+	hsp->comment_len = 0;
+	hsp->comment_real_len = 0;
+	hsp->entity_len = 0;
+	hsp->raw = 0;
+	hsp->held_len = 0;
+	memset(hsp->span, 0, sizeof(hsp->span));
+	hsp->script_len = 0;
+	hsp->carry_len = 0;
+	if (hsp->arena_max_len) html_parser_tag_arena_layout(hsp, HTML_NAME);
+	hsp->attr_list_len = 0;
+	hsp->attr_pool_len = 0;
+	hsp->attr_pending = 0;
+	hsp->attr_value_begin = 0;
+	html_parser_set_interest(hsp, hsp->interest);
+	html_parser_inflate_restart(hsp);
+	html_parser_charset_restart(hsp);
+	html_parser_links_restart(hsp);
+	html_parser_visible_restart(hsp);
+	html_parser_tape_restart(hsp);
+}
+
+/*
+ * The snapshot is a version byte after the magic "HSP"
+ * followed by the numbers of the state, each in 7 bit
+ * groups from the lowest one, the high bit set on all
+ * but the last group, and the chars of the captured parts,
+ * the carry buffer and the attribute list, each after
+ * its length. The snapshot does not depend on the word
+ * size nor the byte order.
+ */
+#define HTML_SNAPSHOT_VERSION 1
+
+struct html_parser_out {
+	char *p;
+	size_t len;
+	size_t max_len;
+};
+
+struct html_parser_in {
+	const unsigned char *p;
+	const unsigned char *end;
+	char bad;
+};
+
+static void html_parser_put(struct html_parser_out *o, const char *p, size_t n) {
+	if (n && o->len + n <= o->max_len) memcpy(o->p + o->len, p, n);
+	o->len += n;
+}
+
+static void html_parser_put_number(struct html_parser_out *o, unsigned long long x) {
+	char c;
+	do {
+		c = (x & 0x7f) | (x > 0x7f ? 0x80 : 0);
+		html_parser_put(o, &c, 1);
+		x >>= 7;
+	} while (x);
+}
+
+static void html_parser_put_chars(struct html_parser_out *o, const char *p, size_t n) { html_parser_put_number(o, n); html_parser_put(o, p, n); }
+
+/*
+ * Returns the next number, which must not be greater than
+ * max, else the snapshot is bad and the number is 0.
+ */
+static unsigned long long html_parser_get_number(struct html_parser_in *in, unsigned long long max) {
+	unsigned long long x = 0;
+	int shift = 0;
+	unsigned char c;
+	do {
+		if (in->p == in->end || shift > 63) { in->bad = 1; return 0; }
+		c = *in->p++;
+		x |= (unsigned long long) (c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	if (x > max) { in->bad = 1; return 0; }
+	return x;
+}
+
+/*
+ * Returns the chars after their length, setting the len
+ * argument to it, or NULL if the snapshot is bad.
+ */
+static const char *html_parser_get_chars(struct html_parser_in *in, size_t *len) {
+	const char *p;
+	*len = html_parser_get_number(in, in->end - in->p);
+	if (in->bad || *len > (size_t) (in->end - in->p)) { in->bad = 1; *len = 0; return NULL; }
+	p = (const char *) in->p;
+	in->p += *len;
+	return p;
+}
+
+/*
+ * Captures the n chars of the part (HTML_INNER_TEXT,
+ * HTML_NAME, HTML_ATTRIBUTE, HTML_VALUE or -1 with no arena)
+ * to its buffer, as many as fit.
+ */
+static void html_parser_restore_part(HTMLSTREAMPARSER *hsp, char part, char **buf, size_t *len, size_t *max_len, const char *p, size_t n) {
+	*len = 0;
+	if (part >= 0) html_parser_arena_grow(hsp, part, n);
+	if (n > *max_len) n = *max_len;
+	if (n) memcpy(*buf, p, n);
+	*len = n;
+}
+
+size_t html_parser_snapshot(HTMLSTREAMPARSER *hsp, char *buf, size_t len) {
+	struct html_parser_out o = { buf, 0, len };
+	struct html_parser_charset *f = hsp->charset;
+	HTMLSTREAMPARSER_ATTRIBUTE *a;
+	int i;
+#ifdef HTML_PARSER_ZLIB
+	// the inflate state of zlib cannot be serialized
+	if (hsp->inflate && (hsp->inflate->state || hsp->inflate->head_len)) return 0;
+#endif
+	html_parser_put(&o, "HSP", 3);
+	html_parser_put_number(&o, HTML_SNAPSHOT_VERSION);
+	html_parser_put_number(&o, hsp->parser_state);
+	html_parser_put_number(&o, hsp->html_part);
+	html_parser_put_number(&o, hsp->raw);
+	html_parser_put_chars(&o, hsp->held, hsp->held_len);
+	html_parser_put_chars(&o, hsp->entity, hsp->entity_len);
+	// the rest of a reference is set when it begins
+	if (hsp->entity_len) {
+		html_parser_put_number(&o, hsp->entity_part);
+		html_parser_put_number(&o, hsp->entity_digits);
+		html_parser_put_number(&o, hsp->entity_lo);
+		html_parser_put_number(&o, hsp->entity_hi);
+		html_parser_put_number(&o, hsp->entity_match);
+		html_parser_put_number(&o, hsp->entity_match_len);
+		html_parser_put_number(&o, hsp->entity_code);
+	}
+	html_parser_put_number(&o, hsp->inner_text_space);
+	html_parser_put_number(&o, hsp->tag_name_real_len);
+	html_parser_put_chars(&o, hsp->tag_name, hsp->tag_name_len);
+	html_parser_put_number(&o, hsp->attr_name_real_len);
+	html_parser_put_chars(&o, hsp->attr_name, hsp->attr_name_len);
+	html_parser_put_number(&o, hsp->attr_value_real_len);
+	html_parser_put_chars(&o, hsp->attr_value, hsp->attr_value_len);
+	html_parser_put_number(&o, hsp->inner_text_real_len);
+	html_parser_put_chars(&o, hsp->inner_text, hsp->inner_text_len);
+	html_parser_put_number(&o, hsp->comment_real_len);
+	html_parser_put_chars(&o, hsp->comment, hsp->comment_len);
+	html_parser_put_number(&o, hsp->arena_tail);
+	html_parser_put_number(&o, hsp->script_len);
+	for (i = 0; i < HTML_SPAN_SIZE; i++) {
+		html_parser_put_number(&o, hsp->span[i].state);
+		html_parser_put_number(&o, hsp->span[i].carry_offset);
+		html_parser_put_number(&o, hsp->span[i].carry_len);
+	}
+	html_parser_put_chars(&o, hsp->carry, hsp->carry_len);
+	html_parser_put_number(&o, hsp->attr_pending);
+	html_parser_put_number(&o, hsp->attr_value_begin);
+	html_parser_put_number(&o, hsp->attr_list_len);
+	for (a = hsp->attr_list; a < hsp->attr_list + hsp->attr_list_len; a++) {
+		html_parser_put_chars(&o, a->name, a->name_len);
+		html_parser_put_number(&o, a->value != NULL);
+		if (a->value) html_parser_put_chars(&o, a->value, a->value_len);
+	}
+	html_parser_put_number(&o, hsp->interest_tag);
+	html_parser_put_number(&o, hsp->skip_text);
+	html_parser_put_number(&o, hsp->skip_attr);
+	html_parser_put_number(&o, hsp->skip_value);
+	html_parser_put_number(&o, f ? f->charset : HTML_CHARSET_NONE);
+	if (f) {
+		html_parser_put_number(&o, f->current);
+		html_parser_put_number(&o, f->sink == html_parser_char_run);
+		html_parser_put_chars(&o, (const char *) f->pending, f->pending_len);
+		html_parser_put_chars(&o, f->head, f->head_len);
+	}
+	return o.len;
+}
+
+int html_parser_restore(HTMLSTREAMPARSER *hsp, const char *buf, size_t len) {
+	struct html_parser_in in = { (const unsigned char *) buf, (const unsigned char *) buf + len, 0 };
+	struct html_parser_charset *f;
+	HTMLSTREAMPARSER_ATTRIBUTE *a;
+	const char *p, *value;
+	size_t n, value_len = 0, count, pool_len;
+	int i, charset;
+	char tail;
+	if (len < 4 || memcmp(buf, "HSP", 3)) return -1;
+	in.p += 3;
+	if (html_parser_get_number(&in, HTML_SNAPSHOT_VERSION) != HTML_SNAPSHOT_VERSION) return -1;
+	html_parser_restart(hsp);
+	hsp->parser_state = html_parser_get_number(&in, HTML_STATE_SIZE - 1);
+	hsp->html_part = html_parser_get_number(&in, HTML_ALL);
+	hsp->raw = html_parser_get_number(&in, HTML_RAW_SIZE - 1);
+	if ((p = html_parser_get_chars(&in, &n)) && n <= HTML_HELD_SIZE) memcpy(hsp->held, p, hsp->held_len = n);
+	else in.bad = 1;
+	if ((p = html_parser_get_chars(&in, &n)) && n <= HTML_ENTITY_SIZE) memcpy(hsp->entity, p, hsp->entity_len = n);
+	else in.bad = 1;
+	if (hsp->entity_len) {
+		hsp->entity_part = html_parser_get_number(&in, HTML_PART_SIZE - 1);
+		hsp->entity_digits = html_parser_get_number(&in, 1);
+		hsp->entity_lo = html_parser_get_number(&in, 0xffff);
+		hsp->entity_hi = html_parser_get_number(&in, 0xffff);
+		hsp->entity_match = html_parser_get_number(&in, 0xffff);
+		hsp->entity_match_len = html_parser_get_number(&in, 0xff);
+		hsp->entity_code = html_parser_get_number(&in, (unsigned long) -1);
+		// the range and the match index the reference tables and the held chars
+		if (hsp->entity_lo > hsp->entity_hi || hsp->entity_hi > HTML_ENTITY_COUNT || hsp->entity_match >= HTML_ENTITY_COUNT
+			|| hsp->entity_match_len >= hsp->entity_len || (hsp->entity_part != HTML_INNER_TEXT && hsp->entity_part != HTML_VALUE)) in.bad = 1;
+	}
+	hsp->inner_text_space = html_parser_get_number(&in, 1);
+	hsp->tag_name_real_len = html_parser_get_number(&in, (size_t) -1);
+	p = html_parser_get_chars(&in, &n);
+	html_parser_restore_part(hsp, HTML_NAME, &hsp->tag_name, &hsp->tag_name_len, &hsp->tag_name_max_len, p, n);
+	hsp->attr_name_real_len = html_parser_get_number(&in, (size_t) -1);
+	p = html_parser_get_chars(&in, &n);
+	html_parser_restore_part(hsp, HTML_ATTRIBUTE, &hsp->attr_name, &hsp->attr_name_len, &hsp->attr_name_max_len, p, n);
+	hsp->attr_value_real_len = html_parser_get_number(&in, (size_t) -1);
+	p = html_parser_get_chars(&in, &n);
+	html_parser_restore_part(hsp, HTML_VALUE, &hsp->attr_value, &hsp->attr_value_len, &hsp->attr_value_max_len, p, n);
+	hsp->inner_text_real_len = html_parser_get_number(&in, (size_t) -1);
+	p = html_parser_get_chars(&in, &n);
+	html_parser_restore_part(hsp, HTML_INNER_TEXT, &hsp->inner_text, &hsp->inner_text_len, &hsp->inner_text_max_len, p, n);
+	hsp->comment_real_len = html_parser_get_number(&in, (size_t) -1);
+	p = html_parser_get_chars(&in, &n);
+	html_parser_restore_part(hsp, -1, &hsp->comment, &hsp->comment_len, &hsp->comment_max_len, p, n);
+	// the tail is 0 in a parser never laid out
+	tail = html_parser_get_number(&in, HTML_VALUE);
+	html_parser_tag_arena_layout(hsp, tail < HTML_NAME ? HTML_NAME : tail);
+	hsp->script_len = html_parser_get_number(&in, (size_t) -1);
+	for (i = 0; i < HTML_SPAN_SIZE; i++) {
+		hsp->span[i].state = html_parser_get_number(&in, 2);
+		hsp->span[i].carry_offset = html_parser_get_number(&in, (size_t) -1);
+		hsp->span[i].carry_len = html_parser_get_number(&in, (size_t) -1);
+	}
+	p = html_parser_get_chars(&in, &n);
+	html_parser_carry(hsp, p, n);
+	// the spans emitted already can be left past the carry buffer
+	for (i = 0; i < HTML_SPAN_SIZE; i++) {
+		if (hsp->span[i].carry_offset > hsp->carry_len) hsp->span[i].carry_offset = hsp->carry_len;
+		if (hsp->span[i].carry_len > hsp->carry_len - hsp->span[i].carry_offset) hsp->span[i].carry_len = hsp->carry_len - hsp->span[i].carry_offset;
+	}
+	// the text before the end tag of a raw text element is in its span
+	i = hsp->parser_state == HTML_STATE_SCRIPT_LT || hsp->parser_state == HTML_STATE_SCRIPT_NAME ? HTML_SPAN_SCRIPT : HTML_SPAN_TEXT;
+	if (hsp->script_len > hsp->span[i].carry_len) hsp->script_len = hsp->span[i].carry_len;
+	hsp->attr_pending = html_parser_get_number(&in, 1);
+	hsp->attr_value_begin = html_parser_get_number(&in, (size_t) -1);
+	if (hsp->attr_value_begin > hsp->attr_value_len) hsp->attr_value_begin = hsp->attr_value_len;
+	count = html_parser_get_number(&in, len);
+	while (count-- && !in.bad) {
+		p = html_parser_get_chars(&in, &n);
+		value = html_parser_get_number(&in, 1) ? html_parser_get_chars(&in, &value_len) : NULL;
+		if (in.bad || hsp->attr_list_len == hsp->attr_list_max_len) continue;
+		// the attributes not fitting the list or the pool are dropped
+		a = hsp->attr_list + hsp->attr_list_len;
+		pool_len = hsp->attr_pool_len;
+		a->name_len = n;
+		a->value_len = value ? value_len : 0;
+		a->value = NULL;
+		if (!(a->name = html_parser_attr_pool_put(hsp, p, n)) || (value && !(a->value = html_parser_attr_pool_put(hsp, value, value_len)))) hsp->attr_pool_len = pool_len;
+		else hsp->attr_list_len++;
+	}
+	hsp->interest_tag = html_parser_get_number(&in, HTML_TAG_ID_SIZE - 1);
+	hsp->skip_text = html_parser_get_number(&in, 1);
+	hsp->skip_attr = html_parser_get_number(&in, 1);
+	hsp->skip_value = html_parser_get_number(&in, 1);
+	charset = html_parser_get_number(&in, HTML_CHARSET_SIZE - 1);
+	if (charset == HTML_CHARSET_NONE || in.bad) html_parser_release_charset(hsp);
+	else if (html_parser_set_charset(hsp, charset)) in.bad = 1;
+	else {
+		f = hsp->charset;
+		f->current = html_parser_get_number(&in, HTML_CHARSET_SIZE - 1);
+		f->sink = html_parser_get_number(&in, 1) ? html_parser_char_run : html_parser_tokenize;
+		if ((p = html_parser_get_chars(&in, &n)) && n <= sizeof(f->pending)) memcpy(f->pending, p, f->pending_len = n);
+		else in.bad = 1;
+		if ((p = html_parser_get_chars(&in, &n)) && n <= HTML_CHARSET_SNIFF_SIZE) memcpy(f->head, p, f->head_len = n);
+		else in.bad = 1;
+	}
+	if (in.bad || in.p != in.end) {
+		html_parser_restart(hsp);
+		return -1;
+	}
+	return 0;
+}
+
+int html_parser_clone_state(HTMLSTREAMPARSER *dst, HTMLSTREAMPARSER *src) {
+	char local[4096], *buf = local;
+	size_t len = html_parser_snapshot(src, local, sizeof(local));
+	int ret;
+	if (!len) return -1;
+	if (len > sizeof(local)) {
+		if (!(buf = (char *) malloc(len))) return -1;
+		html_parser_snapshot(src, buf, len);
+	}
+	ret = html_parser_restore(dst, buf, len);
+	if (buf != local) free(buf);
+	return ret;
+}
+
+/*
+ * The batch pool. Every worker keeps a stack of job ranges
+ * of the submitted batches and takes its jobs from the top
+ * one. An idle worker steals the upper half of the bottom
+ * range of another worker, which is the oldest and the
+ * longest one. The jobs not yet taken are counted
+ * in pending, so an idle worker sleeps only when there is
+ * nothing to steal. A worker reading the files by io_uring
+ * takes its next job before parsing the current one,
+ * to have the next file read meanwhile into the other
+ * of its two file buffers.
+ */
+
+struct html_parser_batch {
+	HTMLSTREAMPARSER_JOB *jobs;
+	size_t left;
+	void (*done)(void *arg);
+	void *arg;
+};
+
+struct html_parser_range {
+	struct html_parser_batch *batch;
+	size_t begin;
+	size_t end;
+};
+
+/*
+ * The buffer of a file read by a worker. The file is open
+ * from html_parser_file_open until all of it is read.
+ */
+struct html_parser_file {
+	char *buf;
+	size_t len;
+	size_t max_len;
+	int fd;
+	int error;
+	char opened;
+	char started;
+};
+
+#ifdef HTML_PARSER_IO_URING
+struct html_parser_ring {
+	int fd;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq;
+	void *cq;
+	size_t sq_len;
+	size_t cq_len;
+	size_t sqes_len;
+};
+#endif
+
+struct html_parser_worker {
+	HTMLSTREAMPARSER hsp;
+	struct html_parser_pool *pool;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct html_parser_range *ranges;
+	size_t ranges_len;
+	size_t ranges_max_len;
+	struct html_parser_file files[2];
+	int file;
+#ifdef HTML_PARSER_IO_URING
+	struct html_parser_ring ring;
+#endif
+};
+
+struct html_parser_pool {
+	struct html_parser_worker *workers;
+	int threads;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t idle;
+	size_t pending;
+	size_t batches;
+	char stop;
+	void (*teardown)(HTMLSTREAMPARSER *hsp, void *arg);
+	void *arg;
+};
+
+/*
+ * Makes room for one more range in the worker stack,
+ * the worker must be locked. Returns -1 if there is none.
+ */
+static int html_parser_worker_room(struct html_parser_worker *w) {
+	size_t size = w->ranges_max_len ? w->ranges_max_len * 2 : 16;
+	struct html_parser_range *r;
+	if (w->ranges_len < w->ranges_max_len) return 0;
+	if (!(r = (struct html_parser_range *) realloc(w->ranges, size * sizeof(struct html_parser_range)))) return -1;
+	w->ranges = r;
+	w->ranges_max_len = size;
+	return 0;
+}
+
+static void html_parser_worker_push(struct html_parser_worker *w, struct html_parser_batch *batch, size_t begin, size_t end) {
+	struct html_parser_range *r = w->ranges + w->ranges_len++;
+	r->batch = batch; r->begin = begin; r->end = end;
+}
+
+/*
+ * Takes a job from the top range of the worker stack
+ * or steals from another worker. The workers are locked
+ * in the order of their addresses, at most two at once.
+ * Returns NULL if no job is found.
+ */
+static HTMLSTREAMPARSER_JOB *html_parser_worker_take(struct html_parser_worker *w, struct html_parser_batch **batch) {
+	struct html_parser_pool *pool = w->pool;
+	struct html_parser_worker *v;
+	struct html_parser_range *r;
+	HTMLSTREAMPARSER_JOB *job = NULL;
+	size_t half;
+	int i;
+	pthread_mutex_lock(&w->lock);
+	if (w->ranges_len) {
+		r = w->ranges + w->ranges_len - 1;
+		*batch = r->batch;
+		job = r->batch->jobs + r->begin++;
+		if (r->begin == r->end) w->ranges_len--;
+	}
+	pthread_mutex_unlock(&w->lock);
+	for (i = 1; !job && i < pool->threads; i++) {
+		v = pool->workers + (w - pool->workers + i) % pool->threads;
+		pthread_mutex_lock(v < w ? &v->lock : &w->lock);
+		pthread_mutex_lock(v < w ? &w->lock : &v->lock);
+		if (v->ranges_len) {
+			r = v->ranges;
+			*batch = r->batch;
+			half = (r->end - r->begin) / 2;
+			// the rest of the upper half goes to the own stack
+			if (half > 1 && !html_parser_worker_room(w)) {
+				html_parser_worker_push(w, r->batch, r->end - half + 1, r->end);
+				r->end -= half;
+				job = r->batch->jobs + r->end;
+			} else {
+				job = r->batch->jobs + --r->end;
+			}
+			if (r->begin == r->end) memmove(r, r + 1, --v->ranges_len * sizeof(struct html_parser_range));
+		}
+		pthread_mutex_unlock(&w->lock);
+		pthread_mutex_unlock(&v->lock);
+	}
+	if (job) __sync_fetch_and_sub(&pool->pending, 1);
+	return job;
+}
+
+/*
+ * Opens the regular file of the argument path and makes
+ * room for all of it in the buffer. Returns -1 with
+ * the error set if it fails.
+ */
+static int html_parser_file_open(struct html_parser_file *f, const char *path) {
+	struct stat st;
+	size_t size = f->max_len ? f->max_len : HTML_FILE_CHUNK;
+	char *buf;
+	f->opened = 1;
+	f->error = 0;
+	f->len = 0;
+	if ((f->fd = open(path, O_RDONLY)) < 0) { f->error = errno; return -1; }
+	if (fstat(f->fd, &st)) f->error = errno;
+	else if (!S_ISREG(st.st_mode) || (off_t) (size_t) st.st_size != st.st_size) f->error = EINVAL;
+	else f->len = st.st_size;
+	if (!f->error && f->len > f->max_len) {
+		while (size < f->len) size *= 2;
+		if ((buf = (char *) realloc(f->buf, size))) { f->buf = buf; f->max_len = size; }
+		else f->error = ENOMEM;
+	}
+	if (!f->error) return 0;
+	close(f->fd);
+	return -1;
+}
+
+/*
+ * Reads the rest of the open file from the offset done
+ * by pread and closes it. A file shrunk meanwhile
+ * ends at the end of file.
+ */
+static void html_parser_file_read(struct html_parser_file *f, size_t done) {
+	ssize_t n;
+	while (done < f->len) {
+		if ((n = pread(f->fd, f->buf + done, f->len - done, done)) > 0) done += n;
+		else if (!n) f->len = done;
+		else if (errno != EINTR) { f->error = errno; break; }
+	}
+	close(f->fd);
+}
+
+#ifdef HTML_PARSER_IO_URING
+/*
+ * Sets up the ring of the worker. Leaves the fd -1
+ * if io_uring is not available.
+ */
+static void html_parser_ring_init(struct html_parser_ring *r) {
+	struct io_uring_params p;
+	char *sq, *cq = MAP_FAILED;
+	int fd;
+	memset(&p, 0, sizeof(p));
+	r->fd = -1;
+	if ((fd = syscall(__NR_io_uring_setup, 2, &p)) < 0) return;
+	r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	// both the rings are in one mapping where the kernel can do so
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->sq_len < r->cq_len) r->sq_len = r->cq_len;
+		r->cq_len = 0;
+	}
+	sq = (char *) mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq != MAP_FAILED) cq = r->cq_len ? (char *) mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING) : sq;
+	if (cq != MAP_FAILED) r->sqes = (struct io_uring_sqe *) mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (cq == MAP_FAILED || r->sqes == MAP_FAILED) {
+		if (r->cq_len && cq != MAP_FAILED) munmap(cq, r->cq_len);
+		if (sq != MAP_FAILED) munmap(sq, r->sq_len);
+		close(fd);
+		return;
+	}
+	r->sq = sq;
+	r->cq = cq;
+	r->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+	r->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+	r->sq_array = (unsigned *) (sq + p.sq_off.array);
+	r->cq_head = (unsigned *) (cq + p.cq_off.head);
+	r->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+	r->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+	r->fd = fd;
+}
+
+static void html_parser_ring_cleanup(struct html_parser_ring *r) {
+	if (r->fd < 0) return;
+	munmap(r->sqes, r->sqes_len);
+	if (r->cq_len) munmap(r->cq, r->cq_len);
+	munmap(r->sq, r->sq_len);
+	close(r->fd);
+	r->fd = -1;
+}
+
+/*
+ * Submits the read of the open file into its buffer.
+ * Returns -1 if the read is not submitted.
+ */
+static int html_parser_ring_read(struct html_parser_ring *r, struct html_parser_file *f) {
+	unsigned tail = *r->sq_tail, i = tail & *r->sq_mask;
+	struct io_uring_sqe *sqe = r->sqes + i;
+	int n;
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = f->fd;
+	sqe->addr = (unsigned long) f->buf;
+	// the rest of a longer file is read by pread
+	sqe->len = f->len < 0x7ffff000 ? f->len : 0x7ffff000;
+	r->sq_array[i] = i;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	while ((n = syscall(__NR_io_uring_enter, r->fd, 1, 0, 0, NULL, 0)) < 0 && errno == EINTR);
+	return n == 1 ? 0 : -1;
+}
+
+/*
+ * Waits for the read submitted and returns its result,
+ * the count of chars read or the negative errno value.
+ */
+static int html_parser_ring_wait(struct html_parser_ring *r) {
+	unsigned head = *r->cq_head;
+	int res;
+	while (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+		if (syscall(__NR_io_uring_enter, r->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) return -errno;
+	res = r->cqes[head & *r->cq_mask].res;
+	__atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+	return res;
+}
+
+/*
+ * Starts reading the file of the job into the file buffer
+ * not in use. A ring which fails to submit is given up.
+ */
+static void html_parser_worker_start(struct html_parser_worker *w, HTMLSTREAMPARSER_JOB *job) {
+	struct html_parser_file *f = w->files + !w->file;
+	if (html_parser_file_open(f, job->path) || !f->len) return;
+	if (html_parser_ring_read(&w->ring, f)) html_parser_ring_cleanup(&w->ring);
+	else f->started = 1;
+}
+#endif
+
+/*
+ * Reads the file of the job into the next file buffer,
+ * or waits for the read started by html_parser_worker_start,
+ * and sets the job error.
+ */
+static void html_parser_worker_read(struct html_parser_worker *w, HTMLSTREAMPARSER_JOB *job) {
+	struct html_parser_file *f = w->files + (w->file = !w->file);
+	size_t done = 0;
+#ifdef HTML_PARSER_IO_URING
+	int res;
+	if (f->started) {
+		// a failed read is done again by pread to get its error
+		if ((res = html_parser_ring_wait(&w->ring)) > 0) done = res;
+		f->started = 0;
+	}
+#endif
+	if (f->opened || !html_parser_file_open(f, job->path)) {
+		if (!f->error) html_parser_file_read(f, done);
+	}
+	f->opened = 0;
+	job->error = f->error;
+}
+
+static void *html_parser_worker_run(void *arg) {
+	struct html_parser_worker *w = (struct html_parser_worker *) arg;
+	struct html_parser_pool *pool = w->pool;
+	struct html_parser_batch *batch, *next_batch = NULL;
+	HTMLSTREAMPARSER_JOB *job, *next = NULL;
+#ifdef HTML_PARSER_IO_URING
+	html_parser_ring_init(&w->ring);
+#endif
+	for (;;) {
+		if ((job = next)) batch = next_batch;
+		else if (!(job = html_parser_worker_take(w, &batch))) {
+			pthread_mutex_lock(&pool->lock);
+			while (!__sync_add_and_fetch(&pool->pending, 0) && !pool->stop) pthread_cond_wait(&pool->work, &pool->lock);
+			if (!__sync_add_and_fetch(&pool->pending, 0) && pool->stop) { pthread_mutex_unlock(&pool->lock); break; }
+			pthread_mutex_unlock(&pool->lock);
+			// a job is being submitted or stolen
+			sched_yield();
+			continue;
+		}
+		next = NULL;
+		html_parser_restart(&w->hsp);
+		html_parser_set_callbacks(&w->hsp, job->callbacks, job->user);
+		if (job->path) {
+			html_parser_worker_read(w, job);
+#ifdef HTML_PARSER_IO_URING
+			if (w->ring.fd >= 0 && (next = html_parser_worker_take(w, &next_batch)) && next->path) html_parser_worker_start(w, next);
+#endif
+			if (!job->error) html_parser_parse(&w->hsp, w->files[w->file].buf, w->files[w->file].len);
+		} else {
+			html_parser_parse(&w->hsp, job->buf, job->len);
+		}
+		html_parser_flush(&w->hsp);
+		if (job->done) job->done(&w->hsp, job->user);
+		if (__sync_sub_and_fetch(&batch->left, 1)) continue;
+		if (batch->done) batch->done(batch->arg);
+		free(batch);
+		pthread_mutex_lock(&pool->lock);
+		if (!--pool->batches) pthread_cond_broadcast(&pool->idle);
+		pthread_mutex_unlock(&pool->lock);
+	}
+#ifdef HTML_PARSER_IO_URING
+	html_parser_ring_cleanup(&w->ring);
+#endif
+	return NULL;
+}
+
+/*
+ * Stops the started workers, which must have nothing
+ * to do, tears down all the parsers and deallocates the pool.
+ */
+static void html_parser_pool_stop(HTMLSTREAMPARSER_POOL *pool, int started) {
+	int i;
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < started; i++) pthread_join(pool->workers[i].thread, NULL);
+	for (i = 0; i < pool->threads; i++) {
+		struct html_parser_worker *w = pool->workers + i;
+		if (pool->teardown) pool->teardown(&w->hsp, pool->arg);
+		html_parser_release_callbacks(&w->hsp);
+		html_parser_release_arena(&w->hsp);
+		html_parser_release_inflate(&w->hsp);
+		html_parser_release_charset(&w->hsp);
+		pthread_mutex_destroy(&w->lock);
+		free(w->ranges);
+		free(w->files[0].buf);
+		free(w->files[1].buf);
+	}
+	pthread_cond_destroy(&pool->idle);
+	pthread_cond_destroy(&pool->work);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->workers);
+	free(pool);
+}
+
+HTMLSTREAMPARSER_POOL *html_parser_pool_init(int threads, void (*setup)(HTMLSTREAMPARSER *hsp, void *arg), void (*teardown)(HTMLSTREAMPARSER *hsp, void *arg), void *arg) {
+	HTMLSTREAMPARSER_POOL *pool;
+	int i;
+	if (threads < 1) threads = 1;
+	if (!(pool = (HTMLSTREAMPARSER_POOL *) malloc(sizeof(HTMLSTREAMPARSER_POOL)))) return NULL;
+	if (!(pool->workers = (struct html_parser_worker *) calloc(threads, sizeof(struct html_parser_worker)))) { free(pool); return NULL; }
+	pool->threads = threads;
+	pool->pending = 0;
+	pool->batches = 0;
+	pool->stop = 0;
+	pool->teardown = teardown;
+	pool->arg = arg;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+	// the workers steal from each other, so all are set up before any starts
+	for (i = 0; i < threads; i++) {
+		html_parser_reset(&pool->workers[i].hsp);
+		if (setup) setup(&pool->workers[i].hsp, arg);
+		pool->workers[i].pool = pool;
+		pthread_mutex_init(&pool->workers[i].lock, NULL);
+	}
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&pool->workers[i].thread, NULL, html_parser_worker_run, pool->workers + i)) {
+			html_parser_pool_stop(pool, i);
+			return NULL;
+		}
+	}
+	return pool;
+}
+
+int html_parser_pool_submit(HTMLSTREAMPARSER_POOL *pool, HTMLSTREAMPARSER_JOB *jobs, size_t count, void (*done)(void *arg), void *arg) {
+	struct html_parser_batch *batch;
+	size_t n = count < (size_t) pool->threads ? count : (size_t) pool->threads, i, begin = 0, end;
+	int ret = 0;
+	if (!count) { if (done) done(arg); return 0; }
+	if (!(batch = (struct html_parser_batch *) malloc(sizeof(struct html_parser_batch)))) return -1;
+	batch->jobs = jobs; batch->left = count; batch->done = done; batch->arg = arg;
+	// all the ranges are pushed at once or none is
+	for (i = 0; i < n; i++) {
+		pthread_mutex_lock(&pool->workers[i].lock);
+		if (html_parser_worker_room(pool->workers + i)) ret = -1;
+	}
+	if (!ret) {
+		pthread_mutex_lock(&pool->lock);
+		pool->batches++;
+		__sync_fetch_and_add(&pool->pending, count);
+		pthread_mutex_unlock(&pool->lock);
+		for (i = 0; i < n; i++, begin = end) {
+			end = begin + count / n + (i < count % n);
+			html_parser_worker_push(pool->workers + i, batch, begin, end);
+		}
+	}
+	for (i = n; i > 0; i--) pthread_mutex_unlock(&pool->workers[i - 1].lock);
+	if (ret) { free(batch); return -1; }
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+void html_parser_pool_wait(HTMLSTREAMPARSER_POOL *pool) {
+	pthread_mutex_lock(&pool->lock);
+	while (pool->batches) pthread_cond_wait(&pool->idle, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void html_parser_pool_cleanup(HTMLSTREAMPARSER_POOL *pool) {
+	html_parser_pool_wait(pool);
+	html_parser_pool_stop(pool, pool->threads);
+}
+
+/*
+ * The loop waits on its epoll instance for the connections
+ * to be readable and reads each by readv into the chunks,
+ * which all its connections share since the chars are parsed
+ * right after they are read. A connection is read at most
+ * HTML_LOOP_READS times in a row, so a fast one does not
+ * starve the others, the level triggered epoll reports it
+ * again. A paused connection is out of the epoll instance.
+ * The stopped connections are finished after the events
+ * of a wait are gone through, so an event of a connection
+ * stopped meanwhile does not get freed memory.
+ */
+#ifdef HTML_PARSER_EPOLL
+#define HTML_LOOP_EVENTS 256
+#define HTML_LOOP_READS 4
+
+struct html_parser_connection {
+	HTMLSTREAMPARSER_LOOP *loop;
+	int fd;
+	HTMLSTREAMPARSER *hsp;
+	void (*done)(HTMLSTREAMPARSER_CONNECTION *c, HTMLSTREAMPARSER *hsp, int error, void *user);
+	void *user;
+	int error;
+	char paused;
+	char stopped;
+	HTMLSTREAMPARSER_CONNECTION *prev;
+	HTMLSTREAMPARSER_CONNECTION *next;
+	HTMLSTREAMPARSER_CONNECTION *next_stopped;
+};
+
+struct html_parser_loop {
+	int fd;
+	size_t chunk;
+	int chunks;
+	struct iovec *iov;
+	struct epoll_event events[HTML_LOOP_EVENTS];
+	HTMLSTREAMPARSER_CONNECTION *connections;
+	HTMLSTREAMPARSER_CONNECTION *stopped;
+	size_t len;
+};
+
+HTMLSTREAMPARSER_LOOP *html_parser_loop_init(size_t chunk, int chunks) {
+	HTMLSTREAMPARSER_LOOP *loop;
+	int i;
+	if (!chunk) chunk = HTML_FILE_CHUNK;
+	if (chunks < 1) chunks = 1;
+	if (chunks > IOV_MAX) chunks = IOV_MAX;
+	if (!(loop = (HTMLSTREAMPARSER_LOOP *) calloc(1, sizeof(HTMLSTREAMPARSER_LOOP)))) return NULL;
+	loop->chunk = chunk;
+	loop->chunks = chunks;
+	if ((loop->fd = epoll_create1(EPOLL_CLOEXEC)) < 0 || !(loop->iov = (struct iovec *) calloc(chunks, sizeof(struct iovec)))) {
+		html_parser_loop_cleanup(loop);
+		return NULL;
+	}
+	for (i = 0; i < chunks; i++) {
+		if (!(loop->iov[i].iov_base = malloc(chunk))) { html_parser_loop_cleanup(loop); return NULL; }
+		loop->iov[i].iov_len = chunk;
+	}
+	return loop;
+}
+
+static void html_parser_connection_stop(HTMLSTREAMPARSER_CONNECTION *c, int error) {
+	if (c->stopped) return;
+	c->stopped = 1;
+	c->error = error;
+	c->next_stopped = c->loop->stopped;
+	c->loop->stopped = c;
+}
+
+static void html_parser_loop_finish(HTMLSTREAMPARSER_LOOP *loop) {
+	HTMLSTREAMPARSER_CONNECTION *c;
+	// the done functions can stop more connections
+	while ((c = loop->stopped)) {
+		loop->stopped = c->next_stopped;
+		if (!c->paused) epoll_ctl(loop->fd, EPOLL_CTL_DEL, c->fd, NULL);
+		close(c->fd);
+		if (c->prev) c->prev->next = c->next;
+		else loop->connections = c->next;
+		if (c->next) c->next->prev = c->prev;
+		loop->len--;
+		if (c->done) c->done(c, c->hsp, c->error, c->user);
+		free(c);
+	}
+}
+
+HTMLSTREAMPARSER_CONNECTION *html_parser_loop_add(HTMLSTREAMPARSER_LOOP *loop, int fd, HTMLSTREAMPARSER *hsp,
+	void (*done)(HTMLSTREAMPARSER_CONNECTION *c, HTMLSTREAMPARSER *hsp, int error, void *user), void *user) {
+	HTMLSTREAMPARSER_CONNECTION *c;
+	struct epoll_event e;
+	int flags;
+	if ((flags = fcntl(fd, F_GETFL)) < 0 || (!(flags & O_NONBLOCK) && fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)) return NULL;
+	if (!(c = (HTMLSTREAMPARSER_CONNECTION *) calloc(1, sizeof(HTMLSTREAMPARSER_CONNECTION)))) return NULL;
+	c->loop = loop;
+	c->fd = fd;
+	c->hsp = hsp;
+	c->done = done;
+	c->user = user;
+	memset(&e, 0, sizeof(e));
+	e.events = EPOLLIN;
+	e.data.ptr = c;
+	if (epoll_ctl(loop->fd, EPOLL_CTL_ADD, fd, &e)) { free(c); return NULL; }
+	if ((c->next = loop->connections)) c->next->prev = c;
+	loop->connections = c;
+	loop->len++;
+	return c;
+}
+
+void html_parser_loop_pause(HTMLSTREAMPARSER_CONNECTION *c) {
+	if (c->paused || c->stopped) return;
+	// a hang up would be reported again and again if it stayed in
+	if (epoll_ctl(c->loop->fd, EPOLL_CTL_DEL, c->fd, NULL)) html_parser_connection_stop(c, errno);
+	else c->paused = 1;
+}
+
+void html_parser_loop_resume(HTMLSTREAMPARSER_CONNECTION *c) {
+	struct epoll_event e;
+	if (!c->paused || c->stopped) return;
+	memset(&e, 0, sizeof(e));
+	e.events = EPOLLIN;
+	e.data.ptr = c;
+	c->paused = 0;
+	if (epoll_ctl(c->loop->fd, EPOLL_CTL_ADD, c->fd, &e)) {
+		c->paused = 1;
+		html_parser_connection_stop(c, errno);
+	}
+}
+
+void html_parser_loop_stop(HTMLSTREAMPARSER_CONNECTION *c) { html_parser_connection_stop(c, ECANCELED); }
+
+/*
+ * Parses the n chars read to the chunks, until
+ * the connection is stopped by a callback.
+ */
+static void html_parser_connection_parse(HTMLSTREAMPARSER_CONNECTION *c, size_t n) {
+	struct iovec *iov = c->loop->iov;
+	size_t k;
+	for (; n && !c->stopped; iov++, n -= k) {
+		k = n < iov->iov_len ? n : iov->iov_len;
+		if (!c->hsp->inflate) html_parser_parse(c->hsp, (const char *) iov->iov_base, k);
+		else if (html_parser_inflate(c->hsp, (const char *) iov->iov_base, k) < 0) html_parser_connection_stop(c, EILSEQ);
+	}
+}
+
+static void html_parser_connection_read(HTMLSTREAMPARSER_CONNECTION *c) {
+	HTMLSTREAMPARSER_LOOP *loop = c->loop;
+	ssize_t n;
+	int i;
+	for (i = 0; i < HTML_LOOP_READS && !c->paused && !c->stopped; i++) {
+		if ((n = readv(c->fd, loop->iov, loop->chunks)) < 0) {
+			if (errno == EINTR) continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) html_parser_connection_stop(c, errno);
+			return;
+		}
+		if (!n) { html_parser_connection_stop(c, 0); return; }
+		html_parser_connection_parse(c, n);
+		if ((size_t) n < loop->chunk * loop->chunks) return;
+	}
+}
+
+int html_parser_loop_run(HTMLSTREAMPARSER_LOOP *loop, int timeout) {
+	HTMLSTREAMPARSER_CONNECTION *c;
+	int i, n;
+	html_parser_loop_finish(loop);
+	if (!loop->len) return 0;
+	if ((n = epoll_wait(loop->fd, loop->events, HTML_LOOP_EVENTS, timeout)) < 0) {
+		if (errno != EINTR) return -1;
+		n = 0;
+	}
+	for (i = 0; i < n; i++) {
+		c = (HTMLSTREAMPARSER_CONNECTION *) loop->events[i].data.ptr;
+		if (!c->stopped && !c->paused) html_parser_connection_read(c);
+	}
+	html_parser_loop_finish(loop);
+	return loop->len > INT_MAX ? INT_MAX : (int) loop->len;
+}
+
+void html_parser_loop_cleanup(HTMLSTREAMPARSER_LOOP *loop) {
+	HTMLSTREAMPARSER_CONNECTION *c;
+	int i;
+	html_parser_loop_finish(loop);
+	for (c = loop->connections; c; c = c->next) html_parser_connection_stop(c, ECANCELED);
+	html_parser_loop_finish(loop);
+	if (loop->fd >= 0) close(loop->fd);
+	for (i = 0; loop->iov && i < loop->chunks; i++) free(loop->iov[i].iov_base);
+	free(loop->iov);
+	free(loop);
+}
+#else
+HTMLSTREAMPARSER_LOOP *html_parser_loop_init(size_t chunk, int chunks) { return NULL; }
+
+HTMLSTREAMPARSER_CONNECTION *html_parser_loop_add(HTMLSTREAMPARSER_LOOP *loop, int fd, HTMLSTREAMPARSER *hsp,
+	void (*done)(HTMLSTREAMPARSER_CONNECTION *c, HTMLSTREAMPARSER *hsp, int error, void *user), void *user) { return NULL; }
+
+void html_parser_loop_pause(HTMLSTREAMPARSER_CONNECTION *c) { }
+
+void html_parser_loop_resume(HTMLSTREAMPARSER_CONNECTION *c) { }
+
+void html_parser_loop_stop(HTMLSTREAMPARSER_CONNECTION *c) { }
+
+int html_parser_loop_run(HTMLSTREAMPARSER_LOOP *loop, int timeout) { return -1; }
+
+void html_parser_loop_cleanup(HTMLSTREAMPARSER_LOOP *loop) { }
+#endif
+
+/*
+ * The tape cache keeps the tape of every document parsed
+ * in a file of its directory named by the 64 bit xxHash of
+ * the document. The tokens point into the document, so the
+ * file is just a header and the tokens and the same document
+ * given again has the events replayed from the mapped file.
+ * A file is written under a temporary name and renamed, so
+ * the readers see whole files only, and never changed, so
+ * a file removed by another process stays mapped. A file read
+ * gets its time updated and the oldest files go when the
+ * directory gets over its size, down to three quarters of it.
+ */
+#ifdef HAVE_SYS_MMAN_H
+#define HTML_CACHE_VERSION 1
+#define HTML_CACHE_ORDER 0x01020304u
+#define HTML_CACHE_NAME_SIZE 32
+// a temporary file older than this is left by a crashed process
+#define HTML_CACHE_STALE 3600
+
+struct html_parser_cache_header {
+	char magic[4];
+	unsigned int order;
+	unsigned int version;
+	unsigned int token_size;
+	unsigned long long hash;
+	unsigned long long len;
+	unsigned long long tokens;
+};
+
+struct html_parser_cache {
+	char *dir;
+	unsigned long long max_size;
+	unsigned long long size;
+	unsigned long temp;
+	HTMLSTREAMPARSER *hsp;
+	HTMLSTREAMPARSER_TOKEN *tokens;
+	size_t tokens_max_len;
+};
+
+struct html_parser_cache_file {
+	time_t time;
+	unsigned long long size;
+	char name[HTML_CACHE_NAME_SIZE];
+};
+
+#define HTML_XXH_P1 11400714785074694791ULL
+#define HTML_XXH_P2 14029467366897019727ULL
+#define HTML_XXH_P3 1609587929392839161ULL
+#define HTML_XXH_P4 9650029242287828579ULL
+#define HTML_XXH_P5 2870177450012600261ULL
+
+static inline unsigned long long html_parser_rotl(unsigned long long x, int r) { return x << r | x >> (64 - r); }
+
+static inline unsigned long long html_parser_read64(const unsigned char *p) { unsigned long long x; memcpy(&x, p, 8); return x; }
+
+static inline unsigned int html_parser_read32(const unsigned char *p) { unsigned int x; memcpy(&x, p, 4); return x; }
+
+static inline unsigned long long html_parser_xxh_round(unsigned long long acc, unsigned long long x) { return html_parser_rotl(acc + x * HTML_XXH_P2, 31) * HTML_XXH_P1; }
+
+static inline unsigned long long html_parser_xxh_merge(unsigned long long h, unsigned long long v) { return (h ^ html_parser_xxh_round(0, v)) * HTML_XXH_P1 + HTML_XXH_P4; }
+
+// XXH64 with seed 0, the words read in the native byte order
+static unsigned long long html_parser_hash(const char *buf, size_t len) {
+	const unsigned char *p = (const unsigned char *) buf, *end = p + len;
+	unsigned long long h, v1, v2, v3, v4;
+	if (len >= 32) {
+		v1 = HTML_XXH_P1 + HTML_XXH_P2;
+		v2 = HTML_XXH_P2;
+		v3 = 0;
+		v4 = -HTML_XXH_P1;
+		for (; end - p >= 32; p += 32) {
+			v1 = html_parser_xxh_round(v1, html_parser_read64(p));
+			v2 = html_parser_xxh_round(v2, html_parser_read64(p + 8));
+			v3 = html_parser_xxh_round(v3, html_parser_read64(p + 16));
+			v4 = html_parser_xxh_round(v4, html_parser_read64(p + 24));
+		}
+		h = html_parser_rotl(v1, 1) + html_parser_rotl(v2, 7) + html_parser_rotl(v3, 12) + html_parser_rotl(v4, 18);
+		h = html_parser_xxh_merge(html_parser_xxh_merge(html_parser_xxh_merge(html_parser_xxh_merge(h, v1), v2), v3), v4);
+	} else h = HTML_XXH_P5;
+	h += len;
+	for (; end - p >= 8; p += 8) h = html_parser_rotl(h ^ html_parser_xxh_round(0, html_parser_read64(p)), 27) * HTML_XXH_P1 + HTML_XXH_P4;
+	if (end - p >= 4) { h = html_parser_rotl(h ^ html_parser_read32(p) * HTML_XXH_P1, 23) * HTML_XXH_P2 + HTML_XXH_P3; p += 4; }
+	for (; p < end; p++) h = html_parser_rotl(h ^ *p * HTML_XXH_P5, 11) * HTML_XXH_P1;
+	h ^= h >> 33;
+	h *= HTML_XXH_P2;
+	h ^= h >> 29;
+	h *= HTML_XXH_P3;
+	return h ^ h >> 32;
+}
+
+static int html_parser_cache_file_cmp(const void *a, const void *b) {
+	time_t x = ((const struct html_parser_cache_file *) a)->time, y = ((const struct html_parser_cache_file *) b)->time;
+	return x < y ? -1 : x > y;
+}
+
+static int html_parser_cache_name(const char *name, size_t *len) {
+	*len = strlen(name);
+	return *len > 5 && !strcmp(name + *len - 5, ".tape");
+}
+
+/*
+ * Sums the size of the files in the directory and, over
+ * the max_size, removes the oldest ones down to limit.
+ */
+static void html_parser_cache_evict(HTMLSTREAMPARSER_CACHE *cache, unsigned long long limit) {
+	struct html_parser_cache_file *files = NULL, *f;
+	size_t len = 0, max_len = 0, i, n;
+	unsigned long long size = 0;
+	struct dirent *e;
+	struct stat st;
+	DIR *d;
+	int fd;
+	if (!(d = opendir(cache->dir))) return;
+	fd = dirfd(d);
+	while ((e = readdir(d))) {
+		if (fstatat(fd, e->d_name, &st, AT_SYMLINK_NOFOLLOW) || !S_ISREG(st.st_mode)) continue;
+		if (!html_parser_cache_name(e->d_name, &n)) {
+			if (strstr(e->d_name, ".tape.") && st.st_mtime + HTML_CACHE_STALE < time(NULL)) unlinkat(fd, e->d_name, 0);
+			continue;
+		}
+		size += st.st_size;
+		if (n >= HTML_CACHE_NAME_SIZE) continue;
+		if (len == max_len) {
+			if (!(f = (struct html_parser_cache_file *) realloc(files, (max_len ? 2 * max_len : 256) * sizeof(struct html_parser_cache_file)))) break;
+			files = f;
+			max_len = max_len ? 2 * max_len : 256;
+		}
+		files[len].time = st.st_mtime;
+		files[len].size = st.st_size;
+		memcpy(files[len++].name, e->d_name, n + 1);
+	}
+	if (size > cache->max_size) {
+		qsort(files, len, sizeof(struct html_parser_cache_file), html_parser_cache_file_cmp);
+		// another process can have removed a file already
+		for (i = 0; i < len && size > limit; i++) {
+			unlinkat(fd, files[i].name, 0);
+			size -= files[i].size;
+		}
+	}
+	cache->size = size;
+	free(files);
+	closedir(d);
+}
+
+HTMLSTREAMPARSER_CACHE *html_parser_cache_open(const char *dir, unsigned long long max_size) {
+	HTMLSTREAMPARSER_CACHE *cache;
+	size_t len = strlen(dir);
+	if (mkdir(dir, 0755) && errno != EEXIST) return NULL;
+	if (!(cache = (HTMLSTREAMPARSER_CACHE *) calloc(1, sizeof(HTMLSTREAMPARSER_CACHE)))) return NULL;
+	if (!(cache->dir = (char *) malloc(len + 1)) || !(cache->hsp = html_parser_init())) {
+		html_parser_cache_close(cache);
+		return NULL;
+	}
+	memcpy(cache->dir, dir, len + 1);
+	cache->max_size = max_size;
+	html_parser_cache_evict(cache, max_size / 4 * 3);
+	return cache;
+}
+
+void html_parser_cache_close(HTMLSTREAMPARSER_CACHE *cache) {
+	if (cache->hsp) html_parser_cleanup(cache->hsp);
+	free(cache->tokens);
+	free(cache->dir);
+	free(cache);
+}
+
+/*
+ * Calls the callbacks for the tokens of the document of
+ * len chars pointed by buf, if they are all in the document.
+ * Returns 0 or -1 if a token is not, calling none.
+ */
+static int html_parser_cache_replay(HTMLSTREAMPARSER *hsp, const HTMLSTREAMPARSER_TOKEN *tokens, size_t n, const char *buf, size_t len) {
+	const HTMLSTREAMPARSER_CALLBACKS *cb = hsp->callbacks;
+	const HTMLSTREAMPARSER_TOKEN *t, *end = tokens + n;
+	for (t = tokens; t < end; t++) {
+		if (t->kind >= HTML_TOKEN_KIND_SIZE || (t->flags & (HTML_TOKEN_ARENA | HTML_TOKEN_VALUE_ARENA)) || t->offset > len || t->len > len - t->offset) return -1;
+		if (t->kind == HTML_TOKEN_ATTRIBUTE && !(t->flags & HTML_TOKEN_NO_VALUE) && (t->value_offset > len || t->value_len > len - t->value_offset)) return -1;
+	}
+	if (!cb) return 0;
+	for (t = tokens; t < end; t++) {
+		switch (t->kind) {
+			case HTML_TOKEN_START_TAG: if (cb->start_tag) cb->start_tag(hsp->user, buf + t->offset, t->len); break;
+			case HTML_TOKEN_ATTRIBUTE:
+				if (cb->attribute) cb->attribute(hsp->user, buf + t->offset, t->len, t->flags & HTML_TOKEN_NO_VALUE ? NULL : buf + t->value_offset, t->value_len);
+				break;
+			case HTML_TOKEN_END_TAG: if (cb->end_tag) cb->end_tag(hsp->user, buf + t->offset, t->len); break;
+			case HTML_TOKEN_TEXT: if (cb->text) cb->text(hsp->user, buf + t->offset, t->len); break;
+			case HTML_TOKEN_COMMENT: if (cb->comment) cb->comment(hsp->user, buf + t->offset, t->len); break;
+			default: if (cb->script) cb->script(hsp->user, buf + t->offset, t->len);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Replays the tape of the cache file of the name if it is
+ * the one of the document. Returns 0 or -1 if it is not.
+ */
+static int html_parser_cache_read(HTMLSTREAMPARSER *hsp, const char *name, unsigned long long hash, const char *buf, size_t len) {
+	struct html_parser_cache_header *h;
+	struct stat st;
+	void *p;
+	int fd, ret = -1;
+	if ((fd = open(name, O_RDONLY)) < 0) return -1;
+	if (!fstat(fd, &st) && (size_t) st.st_size >= sizeof(struct html_parser_cache_header) && (off_t) (size_t) st.st_size == st.st_size
+		&& (p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED) {
+		h = (struct html_parser_cache_header *) p;
+		if (!memcmp(h->magic, "HSPT", 4) && h->order == HTML_CACHE_ORDER && h->version == HTML_CACHE_VERSION
+			&& h->token_size == sizeof(HTMLSTREAMPARSER_TOKEN) && h->hash == hash && h->len == len
+			&& h->tokens == (st.st_size - sizeof(struct html_parser_cache_header)) / sizeof(HTMLSTREAMPARSER_TOKEN)
+			&& (st.st_size - sizeof(struct html_parser_cache_header)) % sizeof(HTMLSTREAMPARSER_TOKEN) == 0) {
+			ret = html_parser_cache_replay(hsp, (const HTMLSTREAMPARSER_TOKEN *) (h + 1), h->tokens, buf, len);
+		}
+		munmap(p, st.st_size);
+		if (!ret) futimens(fd, NULL);
+	}
+	close(fd);
+	return ret;
+}
+
+static int html_parser_cache_write_all(int fd, const char *p, size_t n) {
+	ssize_t k;
+	while (n) {
+		if ((k = write(fd, p, n)) < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		p += k;
+		n -= k;
+	}
+	return 0;
+}
+
+static void html_parser_cache_write(HTMLSTREAMPARSER_CACHE *cache, const char *name, unsigned long long hash, size_t len, size_t n) {
+	struct html_parser_cache_header h;
+	size_t name_len = strlen(name);
+	char *temp;
+	int fd;
+	if (!(temp = (char *) malloc(name_len + 64))) return;
+	sprintf(temp, "%s.%ld.%lu", name, (long) getpid(), cache->temp++);
+	if ((fd = open(temp, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) { free(temp); return; }
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "HSPT", 4);
+	h.order = HTML_CACHE_ORDER;
+	h.version = HTML_CACHE_VERSION;
+	h.token_size = sizeof(HTMLSTREAMPARSER_TOKEN);
+	h.hash = hash;
+	h.len = len;
+	h.tokens = n;
+	if (html_parser_cache_write_all(fd, (const char *) &h, sizeof(h))
+		|| html_parser_cache_write_all(fd, (const char *) cache->tokens, n * sizeof(HTMLSTREAMPARSER_TOKEN)) || close(fd) || rename(temp, name)) {
+		unlink(temp);
+		free(temp);
+		return;
+	}
+	free(temp);
+	cache->size += sizeof(h) + n * sizeof(HTMLSTREAMPARSER_TOKEN);
+	if (cache->size > cache->max_size) html_parser_cache_evict(cache, cache->max_size / 4 * 3);
+}
+
+/*
+ * Builds the tape of the document by the cache parser,
+ * growing it until the tokens fit. Returns their number
+ * or -1 if the tape cannot be allocated.
+ */
+static long html_parser_cache_tape(HTMLSTREAMPARSER_CACHE *cache, const char *buf, size_t len) {
+	HTMLSTREAMPARSER_TOKEN *t;
+	size_t size = len / 8 + 64;
+	for (;;) {
+		if (cache->tokens_max_len < size) {
+			if (!(t = (HTMLSTREAMPARSER_TOKEN *) realloc(cache->tokens, size * sizeof(HTMLSTREAMPARSER_TOKEN)))) return -1;
+			cache->tokens = t;
+			cache->tokens_max_len = size;
+		}
+		if (html_parser_set_tape(cache->hsp, cache->tokens, cache->tokens_max_len, NULL, 0)) return -1;
+		html_parser_parse(cache->hsp, buf, len);
+		if (!html_parser_tape_dropped(cache->hsp)) return (long) html_parser_tape_length(cache->hsp);
+		html_parser_restart(cache->hsp);
+		size = cache->tokens_max_len * 4;
+	}
+}
+
+/*
+ * Parses the document without a tape by the cache parser
+ * restarted, with the charset and the callbacks of hsp.
+ */
+static void html_parser_cache_fallback(HTMLSTREAMPARSER_CACHE *cache, HTMLSTREAMPARSER *hsp, const char *buf, size_t len) {
+	HTMLSTREAMPARSER *x = cache->hsp;
+	html_parser_restart(x);
+	html_parser_release_tape(x);
+	if (hsp->charset && html_parser_set_charset(x, hsp->charset->charset)) return;
+	html_parser_set_callbacks(x, hsp->callbacks, hsp->user);
+	html_parser_parse(x, buf, len);
+	html_parser_release_callbacks(x);
+	html_parser_release_charset(x);
+}
+
+int html_parser_cache_parse(HTMLSTREAMPARSER_CACHE *cache, HTMLSTREAMPARSER *hsp, const char *buf, size_t len) {
+	unsigned long long hash;
+	char *name;
+	long n;
+	// the tape offsets are in the decoded chars, not in buf
+	if (hsp->charset || len >= UINT_MAX) { html_parser_cache_fallback(cache, hsp, buf, len); return 0; }
+	hash = html_parser_hash(buf, len);
+	if (!(name = (char *) malloc(strlen(cache->dir) + HTML_CACHE_NAME_SIZE))) { html_parser_cache_fallback(cache, hsp, buf, len); return 0; }
+	sprintf(name, "%s/%016llx.tape", cache->dir, hash);
+	if (!html_parser_cache_read(hsp, name, hash, buf, len)) { free(name); return 1; }
+	html_parser_restart(cache->hsp);
+	if ((n = html_parser_cache_tape(cache, buf, len)) < 0) {
+		html_parser_cache_fallback(cache, hsp, buf, len);
+		free(name);
+		return 0;
+	}
+	html_parser_cache_write(cache, name, hash, len, n);
+	html_parser_cache_replay(hsp, cache->tokens, n, buf, len);
+	free(name);
+	return 0;
+}
+#else
+HTMLSTREAMPARSER_CACHE *html_parser_cache_open(const char *dir, unsigned long long max_size) { return NULL; }
+
+void html_parser_cache_close(HTMLSTREAMPARSER_CACHE *cache) { }
+
+int html_parser_cache_parse(HTMLSTREAMPARSER_CACHE *cache, HTMLSTREAMPARSER *hsp, const char *buf, size_t len) { html_parser_parse(hsp, buf, len); return 0; }
+#endif
+
+void html_parser_set_arena(HTMLSTREAMPARSER *hsp, size_t length, size_t max_length) {
+	html_parser_release_arena(hsp);
+	hsp->arena_len = length ? length : 1;
+	hsp->arena_max_len = max_length;
+	if (hsp->arena_len > max_length) hsp->arena_len = max_length;
+	hsp->arena_tail = HTML_NAME;
+	html_parser_configure(hsp);
+}
+
+void html_parser_release_arena(HTMLSTREAMPARSER *hsp) {
+	html_parser_release_tag_buffer(hsp);
+	html_parser_release_attr_buffer(hsp);
+	html_parser_release_val_buffer(hsp);
+	html_parser_release_inner_text_buffer(hsp);
+	free(hsp->text_arena);
+	free(hsp->tag_arena);
+	hsp->text_arena = NULL;
+	hsp->text_arena_len = 0;
+	hsp->tag_arena = NULL;
+	hsp->tag_arena_len = 0;
+	hsp->arena_max_len = 0;
+	html_parser_configure(hsp);
+}
+
+void html_parser_set_tag_to_lower(HTMLSTREAMPARSER *hsp, char c) { hsp->tag_name_to_lower = c; html_parser_configure(hsp); }
+
+void html_parser_set_attr_to_lower(HTMLSTREAMPARSER *hsp, char c) { hsp->attr_name_to_lower = c; html_parser_configure(hsp); }
+
+void html_parser_set_val_to_lower(HTMLSTREAMPARSER *hsp, char c) { hsp->attr_val_to_lower = c; html_parser_configure(hsp); }
+
+void html_parser_set_inner_text_collapse(HTMLSTREAMPARSER *hsp, char c) { hsp->inner_text_collapse = c; }
+
+void html_parser_set_decode_entities(HTMLSTREAMPARSER *hsp, char c) { hsp->decode_entities = c; html_parser_configure(hsp); }
+
+
+void html_parser_set_tag_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->tag_name = buffer; hsp->tag_name_max_len = length; html_parser_configure(hsp); }
+
+void html_parser_release_tag_buffer(HTMLSTREAMPARSER *hsp) { hsp->tag_name = NULL; hsp->tag_name_len = 0; hsp->tag_name_max_len = 0; html_parser_configure(hsp); }
+
+size_t html_parser_tag_length(HTMLSTREAMPARSER *hsp) { if (!(hsp->html_part & HTML_BIT(HTML_NAME)) && hsp->parser_state < HTML_STATE_SCRIPT_NAME) return hsp->tag_name_len; else return 0; }
+
+size_t html_parser_tag_real_length(HTMLSTREAMPARSER *hsp) { return hsp->tag_name_real_len; }
+
+char* html_parser_tag(HTMLSTREAMPARSER *hsp) { return hsp->tag_name; }
+
+int html_parser_cmp_tag(HTMLSTREAMPARSER *hsp, char *p, size_t l) { if (html_parser_tag_length(hsp) == l) if (strncmp(p, hsp->tag_name, l) == 0) return 1; return 0; }
+
+
+void html_parser_set_attr_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->attr_name = buffer; hsp->attr_name_max_len = length; html_parser_configure(hsp); }
+
+void html_parser_release_attr_buffer(HTMLSTREAMPARSER *hsp) { hsp->attr_name = NULL; hsp->attr_name_len = 0; hsp->attr_name_max_len = 0; html_parser_configure(hsp); }
+
+size_t html_parser_attr_length(HTMLSTREAMPARSER *hsp) { if (!(hsp->html_part & HTML_BIT(HTML_ATTRIBUTE))) return hsp->attr_name_len; else return 0; }
+
+size_t html_parser_attr_real_length(HTMLSTREAMPARSER *hsp) { return hsp->attr_name_real_len; }
+
+char* html_parser_attr(HTMLSTREAMPARSER *hsp) { return hsp->attr_name; }
+
+int html_parser_cmp_attr(HTMLSTREAMPARSER *hsp, char *p, size_t l) { if (html_parser_attr_length(hsp) == l) if (strncmp(p, hsp->attr_name, l) == 0) return 1; return 0; }
+
+
+void html_parser_set_val_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->attr_value = buffer; hsp->attr_value_max_len = length; html_parser_configure(hsp); }
+
+void html_parser_release_val_buffer(HTMLSTREAMPARSER *hsp) { hsp->attr_value = NULL; hsp->attr_value_len = 0; hsp->attr_value_max_len = 0; html_parser_configure(hsp); }
+
+size_t html_parser_val_length(HTMLSTREAMPARSER *hsp) { if (!(hsp->html_part & HTML_BIT(HTML_VALUE))) return hsp->attr_value_len; else return 0; }
+
+size_t html_parser_val_real_length(HTMLSTREAMPARSER *hsp) { return hsp->attr_value_real_len; }
+
+char* html_parser_val(HTMLSTREAMPARSER *hsp) { return hsp->attr_value; }
+
+int html_parser_cmp_val(HTMLSTREAMPARSER *hsp, char *p, size_t l) { if (html_parser_val_length(hsp) == l) if (strncmp(p, hsp->attr_value, l) == 0) return 1; return 0; }
+
+
+void html_parser_set_inner_text_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->inner_text = buffer; hsp->inner_text_max_len = length; html_parser_configure(hsp); }
+
+void html_parser_release_inner_text_buffer(HTMLSTREAMPARSER *hsp) { hsp->inner_text = NULL; hsp->inner_text_len = 0; hsp->inner_text_max_len = 0; html_parser_configure(hsp); }
+
+size_t html_parser_inner_text_length(HTMLSTREAMPARSER *hsp) { if (!(hsp->html_part & HTML_BIT(HTML_INNER_TEXT))) return hsp->inner_text_len; else return 0; }
+
+size_t html_parser_inner_text_real_length(HTMLSTREAMPARSER *hsp) { return hsp->inner_text_real_len; }
+
+char* html_parser_inner_text(HTMLSTREAMPARSER *hsp) { return hsp->inner_text; }
+
+int html_parser_cmp_inner_text(HTMLSTREAMPARSER *hsp, char *p, size_t l) { if (html_parser_inner_text_length(hsp) == l) if (strncmp(p, hsp->inner_text, l) == 0) return 1; return 0; }
+
+void html_parser_set_comment_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length) { hsp->comment = buffer; hsp->comment_max_len = length; html_parser_configure(hsp); }
+
+void html_parser_release_comment_buffer(HTMLSTREAMPARSER *hsp) { hsp->comment = NULL; hsp->comment_len = 0; hsp->comment_max_len = 0; html_parser_configure(hsp); }
+
+size_t html_parser_comment_length(HTMLSTREAMPARSER *hsp) { if (!(hsp->html_part & HTML_COMMENT_PARTS) || (hsp->html_part & HTML_BIT(HTML_TAG_END))) return hsp->comment_len; else return 0; }
+
+size_t html_parser_comment_real_length(HTMLSTREAMPARSER *hsp) { return hsp->comment_real_len; }
+
+char* html_parser_comment(HTMLSTREAMPARSER *hsp) { return hsp->comment; }
+
+
+void html_parser_set_attr_list_buffer(HTMLSTREAMPARSER *hsp, HTMLSTREAMPARSER_ATTRIBUTE *list, size_t length, char *pool, size_t pool_length) {
+	hsp->attr_list = list; hsp->attr_list_max_len = length; hsp->attr_pool = pool; hsp->attr_pool_max_len = pool_length;
+	html_parser_configure(hsp);
+}
+
+void html_parser_release_attr_list_buffer(HTMLSTREAMPARSER *hsp) {
+	hsp->attr_list = NULL; hsp->attr_list_len = 0; hsp->attr_list_max_len = 0;
+	hsp->attr_pool = NULL; hsp->attr_pool_len = 0; hsp->attr_pool_max_len = 0; hsp->attr_pending = 0;
+	html_parser_configure(hsp);
+}
+
+size_t html_parser_attr_list_length(HTMLSTREAMPARSER *hsp) { return hsp->attr_list_len; }
+
+HTMLSTREAMPARSER_ATTRIBUTE *html_parser_attr_list(HTMLSTREAMPARSER *hsp) { return hsp->attr_list; }
+
+HTMLSTREAMPARSER_ATTRIBUTE *html_parser_find_attr(HTMLSTREAMPARSER *hsp, char *p, size_t l) {
+	size_t i;
+	for (i = 0; i < hsp->attr_list_len; i++)
+		if (hsp->attr_list[i].name_len == l && strncmp(p, hsp->attr_list[i].name, l) == 0) return hsp->attr_list + i;
+	return NULL;
+}
+
+/*
+ * Returns the id of the name of the l chars pointed by p
+ * in the perfect hash tables or 0 if it is not there.
+ */
+static int html_parser_name_id(const char *p, size_t l, const char *names, const unsigned short *offsets,
+	const unsigned short *displacements, unsigned int buckets, const unsigned short *slots, int bits) {
+	unsigned int h = 2166136261u, id;
+	size_t i;
+	for (i = 0; i < l; i++) h = (h ^ (unsigned char) html_parser_tolower((unsigned char) p[i])) * 16777619u;
+	id = slots[((h ^ displacements[h % buckets]) * 2654435761u) >> (32 - bits)];
+	if (!id || (size_t) (offsets[id] - offsets[id - 1]) != l) return 0;
+	for (i = 0; i < l; i++) if (html_parser_tolower((unsigned char) p[i]) != names[offsets[id - 1] + i]) return 0;
+	return id;
+}
+
+int html_parser_tag_name_id(const char *p, size_t l) {
+	return html_parser_name_id(p, l, html_tag_names, html_tag_name_offsets, html_tag_displacements, HTML_TAG_HASH_BUCKETS, html_tag_slots, HTML_TAG_HASH_BITS);
+}
+
+int html_parser_attr_name_id(const char *p, size_t l) {
+	return html_parser_name_id(p, l, html_attr_names, html_attr_name_offsets, html_attr_displacements, HTML_ATTR_HASH_BUCKETS, html_attr_slots, HTML_ATTR_HASH_BITS);
+}
+
+int html_parser_tag_id(HTMLSTREAMPARSER *hsp) {
+	size_t l = html_parser_tag_length(hsp);
+	if (!l || l != hsp->tag_name_real_len) return HTML_TAG_ID_UNKNOWN;
+	return html_parser_tag_name_id(hsp->tag_name, l);
+}
+
+int html_parser_attr_id(HTMLSTREAMPARSER *hsp) {
+	size_t l = html_parser_attr_length(hsp);
+	if (!l || l != hsp->attr_name_real_len) return HTML_ATTR_ID_UNKNOWN;
+	return html_parser_attr_name_id(hsp->attr_name, l);
+}
+
+void html_parser_interest_clear(HTMLSTREAMPARSER_INTEREST *interest) { memset(interest, 0, sizeof(HTMLSTREAMPARSER_INTEREST)); }
+
+void html_parser_interest_add_tag(HTMLSTREAMPARSER_INTEREST *interest, int tag_id, char text) {
+	if (tag_id <= HTML_TAG_ID_UNKNOWN || tag_id >= HTML_TAG_ID_SIZE) return;
+	interest->tags[tag_id] |= HTML_INTEREST_TAG;
+	if (text) interest->tags[tag_id] |= HTML_INTEREST_TEXT;
+}
+
+void html_parser_interest_add_attr(HTMLSTREAMPARSER_INTEREST *interest, int tag_id, int attr_id) {
+	if (tag_id <= HTML_TAG_ID_UNKNOWN || tag_id >= HTML_TAG_ID_SIZE || attr_id <= HTML_ATTR_ID_UNKNOWN || attr_id >= HTML_ATTR_ID_SIZE) return;
+	interest->tags[tag_id] |= HTML_INTEREST_TAG | HTML_INTEREST_LISTED;
+	interest->attrs[tag_id][attr_id >> 3] |= 1 << (attr_id & 7);
+}
+
+void html_parser_interest_set_all_text(HTMLSTREAMPARSER_INTEREST *interest, char c) { interest->all_text = c; }
+
+void html_parser_set_interest(HTMLSTREAMPARSER *hsp, const HTMLSTREAMPARSER_INTEREST *interest) {
+	hsp->interest = interest;
+	hsp->interest_tag = HTML_TAG_ID_UNKNOWN;
+	hsp->skip_text = interest && !interest->all_text;
+	hsp->skip_attr = interest != NULL;
+	hsp->skip_value = interest != NULL;
+	html_parser_configure(hsp);
+}
+
+const HTMLSTREAMPARSER_STATS *html_parser_stats(HTMLSTREAMPARSER *hsp) {
+#ifdef HTML_PARSER_STATS
+	// the captures not ended yet count too
+	if (hsp->stats.max_real_len[HTML_BUFFER_TAG] < hsp->tag_name_real_len) hsp->stats.max_real_len[HTML_BUFFER_TAG] = hsp->tag_name_real_len;
+	if (hsp->stats.max_real_len[HTML_BUFFER_ATTRIBUTE] < hsp->attr_name_real_len) hsp->stats.max_real_len[HTML_BUFFER_ATTRIBUTE] = hsp->attr_name_real_len;
+	if (hsp->stats.max_real_len[HTML_BUFFER_VALUE] < hsp->attr_value_real_len) hsp->stats.max_real_len[HTML_BUFFER_VALUE] = hsp->attr_value_real_len;
+	if (hsp->stats.max_real_len[HTML_BUFFER_INNER_TEXT] < hsp->inner_text_real_len) hsp->stats.max_real_len[HTML_BUFFER_INNER_TEXT] = hsp->inner_text_real_len;
+	if (hsp->stats.max_real_len[HTML_BUFFER_COMMENT] < hsp->comment_real_len) hsp->stats.max_real_len[HTML_BUFFER_COMMENT] = hsp->comment_real_len;
+#endif
+	return &hsp->stats;
+}
 
+void html_parser_reset_stats(HTMLSTREAMPARSER *hsp) { memset(&hsp->stats, 0, sizeof(HTMLSTREAMPARSER_STATS)); hsp->stats_truncated = 0; }
 
+const char *html_parser_state_name(int state) { return state >= 0 && state < HTML_STATE_SIZE ? html_parser_state_names[state] : NULL; }
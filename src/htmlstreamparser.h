@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <htmlnames.h>
 
 enum {
 	HTML_INNER_TEXT,
@@ -43,14 +44,152 @@ enum {
 	HTML_CLOSING_TAG,
 	HTML_SCRIPT,
 	HTML_COMMENT,
-	HTML_ENTITY //TODO
+	HTML_ENTITY,
+	HTML_CDATA,
+	HTML_DOCTYPE,
+	HTML_PROCESSING_INSTRUCTION
 };
 
-#define HTML_PART_SIZE 24
+#define HTML_PART_SIZE 27
+
+enum {
+	HTML_SPAN_SCRIPT,
+	HTML_SPAN_TEXT,
+	HTML_SPAN_COMMENT,
+	HTML_SPAN_TAG,
+	HTML_SPAN_ATTRIBUTE,
+	HTML_SPAN_VALUE
+};
+
+#define HTML_SPAN_SIZE 6
+
+#define HTML_ENTITY_SIZE 40
+
+#define HTML_HELD_SIZE 10
+
+enum {
+	HTML_CHARSET_NONE,
+	HTML_CHARSET_AUTO,
+	HTML_CHARSET_UTF_8,
+	HTML_CHARSET_UTF_16LE,
+	HTML_CHARSET_UTF_16BE,
+	HTML_CHARSET_WINDOWS_1252,
+	HTML_CHARSET_ISO_8859_2,
+	HTML_CHARSET_ISO_8859_15,
+	HTML_CHARSET_WINDOWS_1250,
+	HTML_CHARSET_WINDOWS_1251,
+	HTML_CHARSET_KOI8_R,
+	HTML_CHARSET_SHIFT_JIS
+};
+
+#define HTML_CHARSET_SIZE 12
+
+enum {
+	HTML_LINK_HREF,
+	HTML_LINK_SRC,
+	HTML_LINK_SRCSET,
+	HTML_LINK_ACTION,
+	HTML_LINK_BASE,
+	HTML_LINK_REFRESH
+};
+
+#define HTML_LINK_KIND_SIZE 6
+
+enum {
+	HTML_TOKEN_START_TAG,
+	HTML_TOKEN_ATTRIBUTE,
+	HTML_TOKEN_END_TAG,
+	HTML_TOKEN_TEXT,
+	HTML_TOKEN_COMMENT,
+	HTML_TOKEN_SCRIPT
+};
+
+#define HTML_TOKEN_KIND_SIZE 6
+
+// the token flags, telling the name or the value is in the arena
+#define HTML_TOKEN_ARENA 1
+#define HTML_TOKEN_VALUE_ARENA 2
+#define HTML_TOKEN_NO_VALUE 4
+
+enum {
+	HTML_BUFFER_TAG,
+	HTML_BUFFER_ATTRIBUTE,
+	HTML_BUFFER_VALUE,
+	HTML_BUFFER_INNER_TEXT,
+	HTML_BUFFER_COMMENT
+};
+
+#define HTML_BUFFER_SIZE 5
+
+#define HTML_PARSER_STATE_SIZE 38
+
+typedef struct {
+	unsigned long long state_bytes[HTML_PARSER_STATE_SIZE];
+	unsigned long tags;
+	unsigned long attributes;
+	unsigned long scripts;
+	unsigned long comments;
+	unsigned long resets;
+	unsigned long truncations[HTML_BUFFER_SIZE];
+	size_t max_real_len[HTML_BUFFER_SIZE];
+} HTMLSTREAMPARSER_STATS;
+
+typedef struct {
+	void (*start_tag)(void *user, const char *name, size_t len);
+	void (*attribute)(void *user, const char *name, size_t name_len, const char *value, size_t value_len);
+	void (*end_tag)(void *user, const char *name, size_t len);
+	void (*text)(void *user, const char *text, size_t len);
+	void (*comment)(void *user, const char *text, size_t len);
+	void (*script)(void *user, const char *text, size_t len);
+} HTMLSTREAMPARSER_CALLBACKS;
+
+typedef struct {
+	char state;
+	const char *begin;
+	const char *end;
+	size_t carry_offset;
+	size_t carry_len;
+} HTMLSTREAMPARSER_SPAN;
+
+#define HTML_INTEREST_TAG 1
+#define HTML_INTEREST_LISTED 2
+#define HTML_INTEREST_TEXT 4
+
+typedef struct {
+	unsigned char tags[HTML_TAG_ID_SIZE];
+	unsigned char attrs[HTML_TAG_ID_SIZE][(HTML_ATTR_ID_SIZE + 7) / 8];
+	char all_text;
+} HTMLSTREAMPARSER_INTEREST;
+
+typedef struct {
+	const char *name;
+	size_t name_len;
+	const char *value;
+	size_t value_len;
+} HTMLSTREAMPARSER_ATTRIBUTE;
 
 typedef struct {
+	size_t offset;
+	size_t len;
+	int tag_id;
+	char kind;
+} HTMLSTREAMPARSER_LINK;
+
+typedef struct {
+	unsigned char kind;
+	unsigned char flags;
+	unsigned short id;
+	unsigned int depth;
+	unsigned int offset;
+	unsigned int len;
+	unsigned int value_offset;
+	unsigned int value_len;
+	unsigned int next;
+} HTMLSTREAMPARSER_TOKEN;
+
+typedef struct html_parser {
 	char parser_state;
-	char html_part[HTML_PART_SIZE];
+	unsigned long html_part;
 	char *tag_name;
 	size_t tag_name_len;
 	size_t tag_name_real_len;
@@ -67,18 +206,100 @@ typedef struct {
 	size_t inner_text_len;
 	size_t inner_text_real_len;
 	size_t inner_text_max_len;
+	char *comment;
+	size_t comment_len;
+	size_t comment_real_len;
+	size_t comment_max_len;
 	char tag_name_to_lower;
 	char attr_name_to_lower;
 	char attr_val_to_lower;
-	char script_equality_len;
+	char inner_text_collapse;
+	char inner_text_space;
+	char decode_entities;
+	char entity[HTML_ENTITY_SIZE];
+	unsigned char entity_len;
+	char entity_part;
+	char entity_digits;
+	unsigned short entity_lo;
+	unsigned short entity_hi;
+	unsigned short entity_match;
+	unsigned char entity_match_len;
+	unsigned long entity_code;
+	char raw;
+	char held[HTML_HELD_SIZE];
+	unsigned char held_len;
+	const HTMLSTREAMPARSER_CALLBACKS *callbacks;
+	void *user;
+	HTMLSTREAMPARSER_SPAN span[HTML_SPAN_SIZE];
+	size_t script_len;
+	char *carry;
+	size_t carry_len;
+	size_t carry_max_len;
+	char *text_arena;
+	size_t text_arena_len;
+	char *tag_arena;
+	size_t tag_arena_len;
+	size_t arena_len;
+	size_t arena_max_len;
+	char arena_tail;
+	HTMLSTREAMPARSER_ATTRIBUTE *attr_list;
+	size_t attr_list_len;
+	size_t attr_list_max_len;
+	char *attr_pool;
+	size_t attr_pool_len;
+	size_t attr_pool_max_len;
+	char attr_pending;
+	size_t attr_value_begin;
+	const HTMLSTREAMPARSER_INTEREST *interest;
+	int interest_tag;
+	char skip_text;
+	char skip_attr;
+	char skip_value;
+	struct html_parser_inflate *inflate;
+	struct html_parser_charset *charset;
+	struct html_parser_links *links;
+	struct html_parser_visible *visible;
+	struct html_parser_tape *tape;
+	int (*step)(struct html_parser *hsp, const char c);
+	void (*tokenize)(struct html_parser *hsp, const char *buf, size_t len);
+	HTMLSTREAMPARSER_STATS stats;
+	unsigned char stats_truncated;
 } HTMLSTREAMPARSER;
 
+typedef struct {
+	const char *buf;
+	size_t len;
+	const HTMLSTREAMPARSER_CALLBACKS *callbacks;
+	void *user;
+	void (*done)(HTMLSTREAMPARSER *hsp, void *user);
+	const char *path;
+	int error;
+} HTMLSTREAMPARSER_JOB;
+
+typedef struct html_parser_pool HTMLSTREAMPARSER_POOL;
+
+typedef struct html_parser_loop HTMLSTREAMPARSER_LOOP;
+
+typedef struct html_parser_connection HTMLSTREAMPARSER_CONNECTION;
+
+typedef struct html_parser_cache HTMLSTREAMPARSER_CACHE;
+
 /*
  * Resets the parser to its initial state
  * and release all the buffers.
+ * The memory allocated by the parser itself
+ * is not freed, see html_parser_release_callbacks
+ * and html_parser_release_arena.
  */
 HTMLSTREAMPARSER *html_parser_reset(HTMLSTREAMPARSER *hsp);
 
+/*
+ * Makes the parser ready for a new document.
+ * Unlike html_parser_reset it keeps the buffers, arenas,
+ * callbacks, interest and all the options set.
+ */
+void html_parser_restart(HTMLSTREAMPARSER *hsp);
+
 /*
  * Initializes a new parser instance.
  * Returns a pointer to the new instance
@@ -98,7 +319,7 @@ void html_parser_cleanup(HTMLSTREAMPARSER *hsp);
  * Returns 1 if the char specified by the chr argument
  * is the HTML whitespace otherwise returns 0.
  */
-inline int ishtmlspace(char chr);
+int ishtmlspace(char chr);
 
 /*
  * Strip HTML whitespace from the end of a string
@@ -141,9 +362,512 @@ int html_parser_is_in(HTMLSTREAMPARSER *hsp, int html_part);
  * Parse the char specified by the chr argument.
  * For correct parsing all the HTML code
  * must be passed with correct order.
+ * A comment ends only at "-->" or "--!>" and is in
+ * HTML_COMMENT, as are the "<!" not followed by "--",
+ * "[CDATA[" or "DOCTYPE" in any case, up to the first '>'.
+ * A CDATA section ends at "]]>" and is in HTML_CDATA, a doctype
+ * and a processing instruction started by "<?" end at
+ * the first '>' and are in HTML_DOCTYPE and
+ * HTML_PROCESSING_INSTRUCTION.
+ * The text of script, style, xmp, iframe, noembed,
+ * noframes, noscript, title and textarea ends only
+ * at the end tag of the element in any case, the text
+ * of plaintext never ends. The script is in HTML_SCRIPT,
+ * the others are inner text, in which only the title
+ * and textarea have the references decoded.
  */
 void html_parser_char_parse(HTMLSTREAMPARSER *hsp, const char c);
 
+/*
+ * Parse the len chars of the buffer pointed by buf.
+ * The result is the same as calling html_parser_char_parse
+ * for every char of the buffer, but the long runs of inner text,
+ * quoted attribute values, comments and scripts are scanned
+ * as a whole. The parser state can be checked only
+ * after the whole buffer is parsed.
+ */
+void html_parser_parse(HTMLSTREAMPARSER *hsp, const char *buf, size_t len);
+
+/*
+ * Parses the file of the argument path by html_parser_parse.
+ * A regular file is mapped into memory and parsed as a whole,
+ * so the callbacks get the references into the mapping,
+ * any other is read in chunks. The mapping is gone
+ * when the function returns.
+ * Returns 0 or -1 with errno set if the file cannot be read.
+ */
+int html_parser_parse_file(HTMLSTREAMPARSER *hsp, const char *path);
+
+/*
+ * Makes the parser inflate the documents passed to
+ * html_parser_inflate into a window of the argument length
+ * chars, 16 kB if 0, and parse every window filled by
+ * html_parser_parse, so the memory used does not depend
+ * on the document size. Returns 0 or -1 if the window
+ * cannot be allocated or the library is built without zlib.
+ */
+int html_parser_set_inflate(HTMLSTREAMPARSER *hsp, size_t window);
+
+/*
+ * Inflates and parses the len chars pointed by buf,
+ * the next part of a gzip, zlib or raw deflate stream,
+ * told apart by its first two chars. The concatenated
+ * gzip members are inflated one after another, any
+ * other chars after the end of the stream are ignored.
+ * Returns 1 if the stream has ended with the buffer,
+ * 0 if more of it is expected or -1 if it is corrupt
+ * or html_parser_set_inflate was not called.
+ * The html_parser_restart function starts a new stream.
+ */
+int html_parser_inflate(HTMLSTREAMPARSER *hsp, const char *buf, size_t len);
+
+/*
+ * Frees the window and the inflate state.
+ */
+void html_parser_release_inflate(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Makes html_parser_parse and html_parser_char_parse decode
+ * the document from the argument charset to UTF-8 before
+ * parsing it, the bad sequences become U+FFFD. The valid
+ * UTF-8 and the ASCII runs of the other charsets are parsed
+ * in place, so the callbacks still get references into the
+ * buffer. HTML_CHARSET_AUTO chooses the charset by the first
+ * 1024 chars, held back until then: by a byte order mark,
+ * by a meta tag or as UTF-8 if they are valid UTF-8,
+ * else as windows-1252. HTML_CHARSET_NONE parses the chars
+ * as they are, like the parser did before.
+ * Returns 0 or -1 if the charset is unknown or the stage
+ * cannot be allocated.
+ */
+int html_parser_set_charset(HTMLSTREAMPARSER *hsp, int charset);
+
+/*
+ * Returns the charset the document is decoded from,
+ * HTML_CHARSET_AUTO while it is not chosen yet.
+ */
+int html_parser_charset(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the charset of the label of the len chars
+ * pointed by label, like "utf-8" or "latin1" in any case,
+ * or HTML_CHARSET_NONE if it is not supported.
+ */
+int html_parser_charset_id(const char *label, size_t len);
+
+/*
+ * Parses the chars the charset stage holds back, the
+ * beginning of a document whose charset is not chosen yet
+ * and a sequence cut by its end, which becomes U+FFFD.
+ * Must be called at the end of every document parsed
+ * with a charset set, html_parser_parse_file and the
+ * pool call it by themselves.
+ */
+void html_parser_flush(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Frees the charset stage, the chars are parsed as they are.
+ */
+void html_parser_release_charset(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Serializes the state of the parser to the buffer of len
+ * chars: the parts captured so far, the chars held back by
+ * the tokenizer, the callbacks and the charset stage, but
+ * not the statistics, the links, the visible text nor the
+ * tape. A stream stopped between two calls to
+ * html_parser_parse or html_parser_char_parse
+ * can go on in another parser restored from the snapshot.
+ * Returns the length of the snapshot, which is written only
+ * if it fits, so a call with a NULL buffer gets the length
+ * to allocate, or 0 while an inflated stream is in progress.
+ */
+size_t html_parser_snapshot(HTMLSTREAMPARSER *hsp, char *buf, size_t len);
+
+/*
+ * Restores the state serialized by html_parser_snapshot,
+ * maybe in another process or on another machine.
+ * The parser must have the buffers, callbacks, interest and
+ * options of the one serialized, the captured parts are
+ * truncated to its buffers. The charset stage is set up or
+ * released like in the snapshot. Returns 0 or -1 if the
+ * snapshot is corrupt, leaving the parser restarted.
+ */
+int html_parser_restore(HTMLSTREAMPARSER *hsp, const char *buf, size_t len);
+
+/*
+ * Copies the state of the src parser to the dst parser
+ * like html_parser_snapshot and html_parser_restore do.
+ * Returns 0 or -1 on failure.
+ */
+int html_parser_clone_state(HTMLSTREAMPARSER *dst, HTMLSTREAMPARSER *src);
+
+/*
+ * Sets the functions called by html_parser_parse
+ * at the end of every start tag name, attribute,
+ * end tag name, inner text, comment and script.
+ * Any of the functions can be NULL. The user argument
+ * is passed to every call. Names and texts are passed
+ * as pointers to the buffer given to html_parser_parse
+ * without case changing, so they are valid only during
+ * the call. A name or text split between two buffers is
+ * copied to the internal carry buffer, which grows as
+ * needed.
+ * An attribute without a value is passed with NULL value.
+ * A comment is passed without the "<!--" and "-->" around,
+ * the CDATA sections, doctypes and processing instructions
+ * are not passed.
+ * Inner text at the end of the stream is not passed.
+ * The html_parser_char_parse function does not call
+ * the callbacks.
+ */
+void html_parser_set_callbacks(HTMLSTREAMPARSER *hsp, const HTMLSTREAMPARSER_CALLBACKS *callbacks, void *user);
+
+/*
+ * Stops calling the callbacks
+ * and frees the internal carry buffer.
+ */
+void html_parser_release_callbacks(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Makes html_parser_parse extract the links of the document:
+ * the href of a, area and link, the src of img, script,
+ * iframe, frame, embed, source, audio, video, track and input,
+ * every candidate of the srcset of img and source, the action
+ * of form, the formaction of button and input, the href
+ * of base and the URL in the content of a refresh meta.
+ * The argument list points to an array of the length entries
+ * and the argument buffer to an array of the buffer_length
+ * chars, where the URLs are stored one after another,
+ * each at the offset of its entry. The references are decoded
+ * and the URLs resolved against the base URL, which is
+ * the document URL until the first base element.
+ * Empty URLs are left out. Setting dedup to non zero value
+ * leaves out the URLs already in the list. The extractor works
+ * with or without the callbacks set, but not
+ * in html_parser_char_parse. Returns 0 or -1 if its state
+ * cannot be allocated.
+ */
+int html_parser_set_links(HTMLSTREAMPARSER *hsp, HTMLSTREAMPARSER_LINK *list, size_t length, char *buffer, size_t buffer_length, char dedup);
+
+/*
+ * Sets the URL of the document, the len chars pointed by url
+ * are copied. Returns 0 or -1 if the links are not set
+ * or the URL is longer than 2047 chars.
+ */
+int html_parser_set_links_url(HTMLSTREAMPARSER *hsp, const char *url, size_t len);
+
+/*
+ * Returns the number of links in the list.
+ */
+size_t html_parser_links_length(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the number of links left out
+ * since the list or the buffer was full.
+ */
+size_t html_parser_links_dropped(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Empties the list and the buffer to take the next links
+ * of the document, the base URL stays.
+ */
+void html_parser_clear_links(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Stops extracting the links and frees the extractor state.
+ */
+void html_parser_release_links(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Makes html_parser_parse write the visible text of the
+ * document to the ring buffer of the size chars pointed by
+ * ring: the inner text out of the head, script, style,
+ * template and the other raw text elements but xmp and
+ * textarea, with the references decoded and the whitespace
+ * collapsed to one space, but in pre, listing, xmp and
+ * textarea. Block elements like p, div, br and li are
+ * separated by a newline, table cells by a space. The
+ * function low is called with the user argument when the
+ * free space in the ring gets under the low_water chars and
+ * when a text does not fit, so it can take the text out;
+ * a text which still does not fit is left out. The low
+ * function can be NULL. Like the links, the visible text
+ * is not written in html_parser_char_parse. Returns 0 or -1
+ * if its state cannot be allocated.
+ */
+int html_parser_set_visible_text(HTMLSTREAMPARSER *hsp, char *ring, size_t size, size_t low_water, void (*low)(HTMLSTREAMPARSER *hsp, void *user), void *user);
+
+/*
+ * Returns the number of chars in the ring.
+ */
+size_t html_parser_visible_text_length(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the oldest chars in the ring and sets len
+ * to the number of them up to the end of the ring,
+ * the rest is at its beginning.
+ */
+const char *html_parser_visible_text(HTMLSTREAMPARSER *hsp, size_t *len);
+
+/*
+ * Removes the len oldest chars from the ring.
+ */
+void html_parser_consume_visible_text(HTMLSTREAMPARSER *hsp, size_t len);
+
+/*
+ * Returns the number of chars left out
+ * since the ring was full.
+ */
+size_t html_parser_visible_text_dropped(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Stops writing the visible text and frees its state.
+ */
+void html_parser_release_visible_text(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Makes html_parser_parse write a token to the tape, the
+ * array of the length entries pointed by tokens, for every
+ * start tag, attribute, end tag, inner text, comment and
+ * script it would pass to the callbacks, so a document
+ * parsed once can be queried many times. The id of a token
+ * is the tag id of a tag, the tag id of the element a text
+ * is in and the attribute id of an attribute. The depth is
+ * the number of the elements the token is in, the one of an
+ * attribute is the depth of its start tag. The offset and
+ * len of a token, and the value_offset and value_len of an
+ * attribute, are the chars in the stream passed to
+ * html_parser_parse since the restart, or in the arena of
+ * the arena_length chars if the flag HTML_TOKEN_ARENA or
+ * HTML_TOKEN_VALUE_ARENA is set: the chars split between
+ * two buffers, decoded from a charset or inflated are
+ * copied to the arena. The next of a start tag is the index
+ * of the token after the element, i.e. after its end tag or
+ * where it was closed by the end tag of a parent, or 0
+ * while it is open. The tape ends at the first token which
+ * does not fit the tape or the arena. Returns 0 or -1
+ * if its state cannot be allocated or the arena is
+ * larger than 4 GB.
+ */
+int html_parser_set_tape(HTMLSTREAMPARSER *hsp, HTMLSTREAMPARSER_TOKEN *tokens, size_t length, char *arena, size_t arena_length);
+
+/*
+ * Returns the number of tokens on the tape.
+ */
+size_t html_parser_tape_length(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the number of tokens left out
+ * since the tape or the arena was full.
+ */
+size_t html_parser_tape_dropped(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Closes the elements left open at the end of the document,
+ * setting their next to the tape length.
+ */
+void html_parser_end_tape(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Stops writing the tape and frees its state.
+ */
+void html_parser_release_tape(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the index of the first token of the len tokens of
+ * the tape from the index from on which has the kind and
+ * the id, any id if it is negative, or len if there is
+ * none. The elements can be skipped by going on from the
+ * next of a start tag.
+ */
+size_t html_parser_tape_find(const HTMLSTREAMPARSER_TOKEN *tape, size_t len, size_t from, int kind, int id);
+
+/*
+ * Returns the name or the text of the token,
+ * in the source stream or in the arena.
+ */
+const char *html_parser_token_name(const HTMLSTREAMPARSER_TOKEN *token, const char *source, const char *arena);
+
+/*
+ * Returns the value of the attribute token, in the source
+ * stream or in the arena, or NULL if it has no value.
+ */
+const char *html_parser_token_value(const HTMLSTREAMPARSER_TOKEN *token, const char *source, const char *arena);
+
+/*
+ * Parses the buffer like html_parser_parse, splitting it
+ * into chunks parsed by up to the argument threads threads
+ * at once. The chunks are guessed to begin right after a tag
+ * and a chunk guessed wrong is parsed again, so the callbacks
+ * are called in the document order from the calling thread
+ * with the same arguments as html_parser_parse would do.
+ * Only the callbacks and the parser state are kept up
+ * to date, the buffers and the attribute list are not.
+ * A buffer smaller than 128 kB, no callbacks set or
+ * the links, the visible text or the tape set makes it
+ * just call html_parser_parse.
+ */
+void html_parser_parse_parallel(HTMLSTREAMPARSER *hsp, const char *buf, size_t len, int threads);
+
+/*
+ * Starts a pool of the argument threads worker threads,
+ * each with its own parser passed once to the setup
+ * function to set the buffers and options it keeps
+ * for all the documents. The teardown function gets
+ * every parser before the pool frees it in the function
+ * html_parser_pool_cleanup. Both functions can be NULL.
+ * Returns NULL if the initialization fails.
+ */
+HTMLSTREAMPARSER_POOL *html_parser_pool_init(int threads, void (*setup)(HTMLSTREAMPARSER *hsp, void *arg), void (*teardown)(HTMLSTREAMPARSER *hsp, void *arg), void *arg);
+
+/*
+ * Submits a batch of the count jobs and returns at once.
+ * Every job document is parsed by html_parser_parse
+ * with the job callbacks and user after
+ * html_parser_restart, then the job done function,
+ * if not NULL, is called with the parser. The jobs
+ * are spread over the workers and an idle worker steals
+ * them from a busy one, so the jobs run in no particular
+ * order and the functions are called from the worker
+ * threads. When all the jobs of the batch are done,
+ * the done function, if not NULL, is called with the
+ * argument arg. The jobs must be kept until then.
+ * A job with the path not NULL has the regular file
+ * of the path as the document instead of the buffer.
+ * The worker reads the file into its own buffer and
+ * sets the job error to 0 or the errno value of the
+ * failed read, the done function is called either way.
+ * Where io_uring is available, a worker reads the file
+ * of its next job while parsing the current one,
+ * otherwise it reads the file by pread.
+ * Returns 0 or -1 if the batch cannot be submitted.
+ */
+int html_parser_pool_submit(HTMLSTREAMPARSER_POOL *pool, HTMLSTREAMPARSER_JOB *jobs, size_t count, void (*done)(void *arg), void *arg);
+
+/*
+ * Waits until all the submitted batches are done.
+ */
+void html_parser_pool_wait(HTMLSTREAMPARSER_POOL *pool);
+
+/*
+ * Waits for the batches, stops the worker threads
+ * and deallocates the pool.
+ */
+void html_parser_pool_cleanup(HTMLSTREAMPARSER_POOL *pool);
+
+/*
+ * Makes an event loop parsing many streams at once,
+ * like sockets, each by its own parser with its own
+ * callbacks. The streams are read by readv into the
+ * argument chunks buffers of the chunk bytes, shared by
+ * all of them, and parsed as soon as they are read. A loop
+ * and its connections are used by one thread, a process
+ * can run a loop on each of its threads. Returns NULL
+ * on failure or where epoll is not available.
+ */
+HTMLSTREAMPARSER_LOOP *html_parser_loop_init(size_t chunk, int chunks);
+
+/*
+ * Adds the file descriptor fd to the loop, made non-blocking,
+ * to be parsed by the argument parser: by html_parser_inflate
+ * if the inflate is set, otherwise by html_parser_parse.
+ * At the end of the stream, on a read error or when the
+ * connection is stopped, the loop closes the descriptor
+ * and calls the done function, if not NULL, with the error
+ * 0, the errno value of the failed read, EILSEQ for a corrupt
+ * deflate stream or ECANCELED, and the user argument.
+ * The parser is left to the caller. Returns the connection
+ * or NULL on failure.
+ */
+HTMLSTREAMPARSER_CONNECTION *html_parser_loop_add(HTMLSTREAMPARSER_LOOP *loop, int fd, HTMLSTREAMPARSER *hsp,
+	void (*done)(HTMLSTREAMPARSER_CONNECTION *c, HTMLSTREAMPARSER *hsp, int error, void *user), void *user);
+
+/*
+ * Stops reading the connection, so the sender
+ * gets blocked once the kernel buffers are full.
+ */
+void html_parser_loop_pause(HTMLSTREAMPARSER_CONNECTION *c);
+
+/*
+ * Reads the connection paused again.
+ */
+void html_parser_loop_resume(HTMLSTREAMPARSER_CONNECTION *c);
+
+/*
+ * Stops parsing the connection, e.g. from a callback
+ * which has found what it looked for. The connection
+ * is finished before html_parser_loop_run returns.
+ */
+void html_parser_loop_stop(HTMLSTREAMPARSER_CONNECTION *c);
+
+/*
+ * Waits up to timeout milliseconds, or forever for
+ * a negative timeout, for the connections to be readable
+ * and parses what they have. Returns the number of
+ * connections left, which are not waited for if 0,
+ * or -1 on failure.
+ */
+int html_parser_loop_run(HTMLSTREAMPARSER_LOOP *loop, int timeout);
+
+/*
+ * Stops all the connections
+ * and deallocates the loop.
+ */
+void html_parser_loop_cleanup(HTMLSTREAMPARSER_LOOP *loop);
+
+/*
+ * Opens the tape cache in the directory dir, made if it
+ * does not exist, keeping the size of its files around
+ * max_size bytes by removing the least recently used ones.
+ * Many processes can use the same directory at once, each
+ * thread opens its own cache. Returns NULL on failure
+ * or where mmap is not available.
+ */
+HTMLSTREAMPARSER_CACHE *html_parser_cache_open(const char *dir, unsigned long long max_size);
+
+/*
+ * Passes the whole document of the len chars pointed by buf to
+ * the callbacks of the parser like html_parser_parse would do
+ * on a restarted parser. A document seen before, by the xxHash
+ * of its chars, has the callbacks called from the tape in the
+ * cache file, without parsing, otherwise the document is
+ * parsed to a tape stored in the cache. Only the callbacks
+ * are called, the parser state, buffers and extractors stay
+ * as they are. A document given to a parser with a charset
+ * set, a document of 4 GB or more and one whose tape cannot
+ * be allocated are parsed without a tape, by the parser of
+ * the cache with the charset and the callbacks of hsp.
+ * Returns 1 if the tape was in the cache or 0 otherwise.
+ */
+int html_parser_cache_parse(HTMLSTREAMPARSER_CACHE *cache, HTMLSTREAMPARSER *hsp, const char *buf, size_t len);
+
+/*
+ * Deallocates the cache, its files stay.
+ */
+void html_parser_cache_close(HTMLSTREAMPARSER_CACHE *cache);
+
+/*
+ * Makes the parser capture the tag name, attribute name,
+ * attribute value and inner text to arenas it allocates
+ * instead of the buffers set by the caller. The inner text
+ * has its own arena and the tag name, attribute name and
+ * value share the other one. An arena starts with the
+ * argument length bytes and doubles when it is full up to
+ * the argument max_length bytes, then the captured texts are
+ * truncated. The arenas are reused by every new tag and
+ * inner text, so the pointers returned by html_parser_tag,
+ * html_parser_attr, html_parser_val and
+ * html_parser_inner_text are valid only until the next char
+ * is parsed. The max_length 0 turns the arenas off.
+ */
+void html_parser_set_arena(HTMLSTREAMPARSER *hsp, size_t length, size_t max_length);
+
+/*
+ * Frees the arenas and releases all the buffers.
+ */
+void html_parser_release_arena(HTMLSTREAMPARSER *hsp);
+
 /*
  * Setting the argument c to non zero value
  * case changing a tag name char pssed to buffer
@@ -168,6 +892,19 @@ void html_parser_set_attr_to_lower(HTMLSTREAMPARSER *hsp, char c);
  */
 void html_parser_set_val_to_lower(HTMLSTREAMPARSER *hsp, char c);
 
+/*
+ * Setting the argument c to non zero value
+ * decoding the character references like &amp;
+ * or &#x27; in the inner text and attribute value
+ * passed to buffers. All the HTML5 named references
+ * and numeric references are decoded to UTF-8.
+ * The parser is in the HTML_ENTITY part while
+ * a reference is not decoded yet. The real length
+ * functions still return the length before decoding.
+ * The callbacks always get the chars not decoded.
+ */
+void html_parser_set_decode_entities(HTMLSTREAMPARSER *hsp, char c);
+
 /*
  * The argument buffer points to an array
  * to be used as the buffer of current tag name.
@@ -321,6 +1058,16 @@ void html_parser_set_inner_text_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size
  */
 void html_parser_release_inner_text_buffer(HTMLSTREAMPARSER *hsp);
 
+/*
+ * Setting the argument c to non zero value makes the parser
+ * collapse the runs of HTML whitespace of the inner text into
+ * a single space and drop the whitespace at its beginning and
+ * end while the text is written to the buffer, giving the same
+ * text as html_parser_trim after html_parser_replace_spaces.
+ * The real length still counts every char.
+ */
+void html_parser_set_inner_text_collapse(HTMLSTREAMPARSER *hsp, char c);
+
 /*
  * Returns the inner text length
  * not bigger then a buffer size
@@ -350,3 +1097,167 @@ char* html_parser_inner_text(HTMLSTREAMPARSER *hsp);
  */
 int html_parser_cmp_inner_text(HTMLSTREAMPARSER *hsp, char *p, size_t l);
 
+/*
+ * The argument buffer points to an array
+ * to be used as the buffer of the current comment.
+ * The comment text is captured without the "<!--"
+ * and "-->" around, and the buffer gets the text of
+ * a CDATA section, doctype or processing instruction
+ * too, the part bits tell which one it is.
+ * The text is truncated to the array size.
+ */
+void html_parser_set_comment_buffer(HTMLSTREAMPARSER *hsp, char *buffer, size_t length);
+
+/*
+ * Release a buffer of the comment.
+ * Now the comment length will be 0.
+ */
+void html_parser_release_comment_buffer(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the comment length not bigger
+ * then a buffer size or 0 if still parsing it.
+ */
+size_t html_parser_comment_length(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the comment real length
+ * can be bigger then a buffer size.
+ */
+size_t html_parser_comment_real_length(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns a reference to the comment buffer.
+ */
+char* html_parser_comment(HTMLSTREAMPARSER *hsp);
+
+/*
+ * The argument list points to an array of the length
+ * entries to be used as the list of all the attributes
+ * of current tag and the argument pool points to an array
+ * of the pool_length chars to store their names and values.
+ * The names and values are copied from the attribute name
+ * and value buffers, so these must be set too. An attribute
+ * not fitting the list or the pool is left out.
+ * An attribute without a value has NULL value.
+ */
+void html_parser_set_attr_list_buffer(HTMLSTREAMPARSER *hsp, HTMLSTREAMPARSER_ATTRIBUTE *list, size_t length, char *pool, size_t pool_length);
+
+/*
+ * Release the attribute list and pool.
+ * Now the list length will be 0.
+ */
+void html_parser_release_attr_list_buffer(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the number of attributes in the list.
+ * The list is complete when the parser is in HTML_TAG_END
+ * and a parser set the length to 0 at a tag beginning.
+ */
+size_t html_parser_attr_list_length(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns a reference to the attribute list.
+ */
+HTMLSTREAMPARSER_ATTRIBUTE *html_parser_attr_list(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the first attribute in the list with the name
+ * pointed by p or NULL if there is no such attribute.
+ * The argument l is a name length.
+ */
+HTMLSTREAMPARSER_ATTRIBUTE *html_parser_find_attr(HTMLSTREAMPARSER *hsp, char *p, size_t l);
+
+/*
+ * Returns the html_tag_id of the current tag name
+ * compared case insensitively or HTML_TAG_ID_UNKNOWN
+ * if the name is not a standard one, is truncated
+ * or still parsing the tag name.
+ */
+int html_parser_tag_id(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the html_attr_id of the current attribute name
+ * compared case insensitively or HTML_ATTR_ID_UNKNOWN
+ * if the name is not a standard one, is truncated
+ * or still parsing the attribute name.
+ */
+int html_parser_attr_id(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the html_tag_id of the tag name pointed by p
+ * or HTML_TAG_ID_UNKNOWN. The argument l is a name length.
+ * It suits the names passed to the callbacks.
+ */
+int html_parser_tag_name_id(const char *p, size_t l);
+
+/*
+ * Returns the html_attr_id of the attribute name pointed by p
+ * or HTML_ATTR_ID_UNKNOWN. The argument l is a name length.
+ */
+int html_parser_attr_name_id(const char *p, size_t l);
+
+/*
+ * Clears the interest set, so nothing is of interest.
+ */
+void html_parser_interest_clear(HTMLSTREAMPARSER_INTEREST *interest);
+
+/*
+ * Adds the tag of the tag_id with all its attributes
+ * to the interest set. Setting the argument text
+ * to non zero value adds the inner text after the tag too.
+ */
+void html_parser_interest_add_tag(HTMLSTREAMPARSER_INTEREST *interest, int tag_id, char text);
+
+/*
+ * Adds the attribute of the attr_id of the tag of the tag_id
+ * to the interest set. Once an attribute is added
+ * the other attributes of the tag are not of interest.
+ */
+void html_parser_interest_add_attr(HTMLSTREAMPARSER_INTEREST *interest, int tag_id, int attr_id);
+
+/*
+ * Setting the argument c to non zero value
+ * adds all the inner texts to the interest set.
+ */
+void html_parser_interest_set_all_text(HTMLSTREAMPARSER_INTEREST *interest, char c);
+
+/*
+ * Makes the parser capture only the attributes and inner
+ * texts in the interest set, which can be shared by many
+ * parsers and must not change while used. The tag names
+ * are always captured, so the tag buffer must be set
+ * to recognize the tags. Anything else leaves its buffer
+ * with the length 0 while the real length is still counted,
+ * and the bulk parsing skips over it. An attribute not
+ * of interest does not get into the attribute list.
+ * The callbacks are not affected. NULL interest turns
+ * the filtering off.
+ */
+void html_parser_set_interest(HTMLSTREAMPARSER *hsp, const HTMLSTREAMPARSER_INTEREST *interest);
+
+/*
+ * The statistics are counted when the library is
+ * configured with --enable-stats, otherwise they stay 0.
+ * Returns the statistics counted since the parser
+ * was initialized or the stats were reset: the bytes parsed
+ * in every parser state, the tags, attributes, scripts and
+ * comments started, where every "<!" and "<?" counts as
+ * a comment, the resets of the whole html_part, and for
+ * every buffer kind (HTML_BUFFER_TAG, HTML_BUFFER_ATTRIBUTE,
+ * HTML_BUFFER_VALUE, HTML_BUFFER_INNER_TEXT and
+ * HTML_BUFFER_COMMENT) the captures truncated
+ * by a full buffer and the maximum real length.
+ */
+const HTMLSTREAMPARSER_STATS *html_parser_stats(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Sets all the statistics to 0.
+ */
+void html_parser_reset_stats(HTMLSTREAMPARSER *hsp);
+
+/*
+ * Returns the name of the parser state,
+ * the index of the state_bytes statistics.
+ */
+const char *html_parser_state_name(int state);
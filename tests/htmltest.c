@@ -0,0 +1,1000 @@
+/*
+ *	HTML stream parser tests
+ *	Copyright (C) 2012 Michael Kowalczyk
+ *
+ *	This program is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	This program is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Parses small documents by every entry point and checks
+ * what the callbacks, the buffers and the extractors get.
+ * Prints every failed check and exits with 1 if there is
+ * any, so make check runs it. A feature the library is
+ * built without, like zlib or epoll, is skipped.
+ *
+ *	htmltest
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <htmlstreamparser.h>
+
+#if defined(HAVE_LIBZ) && defined(HAVE_ZLIB_H)
+#include <zlib.h>
+#define HTML_TEST_ZLIB
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+static int failed;
+
+#define CHECK(c) do { if (!(c)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #c); failed++; } } while (0)
+
+/*
+ * The callbacks write every event to the record as a line
+ * of its kind and chars, which are only hashed once the
+ * text is full, so long documents are compared too.
+ */
+#define RECORD_SIZE 4096
+
+typedef struct {
+	char text[RECORD_SIZE];
+	size_t len;
+	unsigned long long hash;
+	unsigned long events;
+} RECORD;
+
+static void record_put(RECORD *r, const char *kind, const char *p, size_t n, const char *v, size_t vn) {
+	size_t k = strlen(kind), i;
+	r->hash = r->hash * 31 + k;
+	for (i = 0; i < n; i++) r->hash = r->hash * 131 + (unsigned char) p[i];
+	if (v) for (r->hash *= 7, i = 0; i < vn; i++) r->hash = r->hash * 131 + (unsigned char) v[i];
+	r->events++;
+	if (r->len + k + n + vn + 3 >= RECORD_SIZE) { r->len = RECORD_SIZE; return; }
+	memcpy(r->text + r->len, kind, k); r->len += k;
+	r->text[r->len++] = ' ';
+	memcpy(r->text + r->len, p, n); r->len += n;
+	if (v) { r->text[r->len++] = '='; memcpy(r->text + r->len, v, vn); r->len += vn; }
+	r->text[r->len++] = '\n';
+	r->text[r->len] = '\0';
+}
+
+static void on_start_tag(void *user, const char *name, size_t len) { record_put((RECORD *) user, "start", name, len, NULL, 0); }
+static void on_attribute(void *user, const char *name, size_t name_len, const char *value, size_t value_len) { record_put((RECORD *) user, "attr", name, name_len, value, value_len); }
+static void on_end_tag(void *user, const char *name, size_t len) { record_put((RECORD *) user, "end", name, len, NULL, 0); }
+static void on_text(void *user, const char *text, size_t len) { record_put((RECORD *) user, "text", text, len, NULL, 0); }
+static void on_comment(void *user, const char *text, size_t len) { record_put((RECORD *) user, "comment", text, len, NULL, 0); }
+static void on_script(void *user, const char *text, size_t len) { record_put((RECORD *) user, "script", text, len, NULL, 0); }
+
+static const HTMLSTREAMPARSER_CALLBACKS record_callbacks = { on_start_tag, on_attribute, on_end_tag, on_text, on_comment, on_script };
+
+static int record_equal(const RECORD *a, const RECORD *b) { return a->hash == b->hash && a->events == b->events && a->len == b->len && !memcmp(a->text, b->text, a->len < RECORD_SIZE ? a->len : RECORD_SIZE); }
+
+static const char doc[] =
+	"<!DOCTYPE html><html><head><title>T &amp; t</title>"
+	"<style>p > b { }</style></head>\n"
+	"<body class=\"main\" hidden><p id=x title='a&lt;b'>one &eacute; two<br>"
+	"<!-- note --><script type=\"text/javascript\">if (a<b) c(\"</p>\");</script>"
+	"<ul><li>x<li>y</ul><a href=\"/q?a=1&amp;b=2\">link</a><![CDATA[ no ]]>"
+	"<textarea><b>raw</b></textarea></body></html>\n";
+
+static const char doc_events[] =
+	"start html\n"
+	"start head\n"
+	"start title\n"
+	"text T &amp; t\n"
+	"end title\n"
+	"start style\n"
+	"text p > b { }\n"
+	"end style\n"
+	"end head\n"
+	"text \n\n"
+	"start body\n"
+	"attr class=main\n"
+	"attr hidden\n"
+	"start p\n"
+	"attr id=x\n"
+	"attr title=a&lt;b\n"
+	"text one &eacute; two\n"
+	"start br\n"
+	"comment  note \n"
+	"start script\n"
+	"attr type=text/javascript\n"
+	"script if (a<b) c(\"</p>\");\n"
+	"end script\n"
+	"start ul\n"
+	"start li\n"
+	"text x\n"
+	"start li\n"
+	"text y\n"
+	"end ul\n"
+	"start a\n"
+	"attr href=/q?a=1&amp;b=2\n"
+	"text link\n"
+	"end a\n"
+	"start textarea\n"
+	"text <b>raw</b>\n"
+	"end textarea\n"
+	"end body\n"
+	"end html\n";
+
+static HTMLSTREAMPARSER *record_parser(RECORD *r) {
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	memset(r, 0, sizeof(RECORD));
+	html_parser_set_callbacks(hsp, &record_callbacks, r);
+	return hsp;
+}
+
+/*
+ * Parses the len chars in chunks of the argument size,
+ * each copied and overwritten after the call, so the
+ * callbacks must not get pointers to a former chunk.
+ */
+static void parse_chunks(HTMLSTREAMPARSER *hsp, const char *buf, size_t len, size_t size) {
+	char *chunk = (char *) malloc(size);
+	size_t n;
+	while (len) {
+		n = len < size ? len : size;
+		memcpy(chunk, buf, n);
+		html_parser_parse(hsp, chunk, n);
+		memset(chunk, '#', n);
+		buf += n;
+		len -= n;
+	}
+	free(chunk);
+}
+
+static void test_callbacks(void) {
+	RECORD r;
+	HTMLSTREAMPARSER *hsp = record_parser(&r);
+	html_parser_parse(hsp, doc, sizeof(doc) - 1);
+	CHECK(!strcmp(r.text, doc_events));
+	html_parser_cleanup(hsp);
+	// the inner text at the end of the stream is not passed
+	hsp = record_parser(&r);
+	html_parser_parse(hsp, "<b>x</b>tail", 12);
+	CHECK(!strcmp(r.text, "start b\ntext x\nend b\n"));
+	html_parser_cleanup(hsp);
+}
+
+static void test_chunks(void) {
+	RECORD whole, r;
+	HTMLSTREAMPARSER *hsp = record_parser(&whole);
+	size_t len = sizeof(doc) - 1, k;
+	html_parser_parse(hsp, doc, len);
+	html_parser_cleanup(hsp);
+	for (k = 0; k <= len; k++) {
+		hsp = record_parser(&r);
+		parse_chunks(hsp, doc, k, len + 1);
+		parse_chunks(hsp, doc + k, len - k, len + 1);
+		CHECK(record_equal(&r, &whole));
+		html_parser_cleanup(hsp);
+	}
+	for (k = 1; k < 8; k++) {
+		hsp = record_parser(&r);
+		parse_chunks(hsp, doc, len, k);
+		CHECK(record_equal(&r, &whole));
+		html_parser_cleanup(hsp);
+	}
+}
+
+static void test_entities(void) {
+	static const char text[] = "<p>a&amp;b &eacute;&#x41;&#66;&notin;&amp</p><a title='x&lt;y' href=\"&quot;q&quot;\">";
+	char tag[32], val[64], inner[64];
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	size_t i, n;
+	html_parser_set_tag_buffer(hsp, tag, sizeof(tag));
+	html_parser_set_val_buffer(hsp, val, sizeof(val));
+	html_parser_set_inner_text_buffer(hsp, inner, sizeof(inner));
+	html_parser_set_decode_entities(hsp, 1);
+	// the text ends at the next tag
+	for (i = 0; text[i] != '/'; i++) html_parser_char_parse(hsp, text[i]);
+	CHECK(html_parser_inner_text_length(hsp) == 12 && !memcmp(html_parser_inner_text(hsp), "a&b \xc3\xa9" "AB\xe2\x88\x89&", 12));
+	CHECK(html_parser_inner_text_real_length(hsp) == 38);
+	// the value ends at its quote
+	n = strchr(text, 'y') - text + 2;
+	html_parser_parse(hsp, text + i, n - i);
+	CHECK(html_parser_val_length(hsp) == 3 && !memcmp(html_parser_val(hsp), "x<y", 3));
+	html_parser_parse(hsp, text + n, sizeof(text) - 1 - n);
+	CHECK(html_parser_val_length(hsp) == 3 && !memcmp(html_parser_val(hsp), "\"q\"", 3));
+	html_parser_cleanup(hsp);
+}
+
+/*
+ * Parses the string s as the next chunk.
+ */
+static void parse_string(HTMLSTREAMPARSER *hsp, const char *s) { html_parser_parse(hsp, s, strlen(s)); }
+
+static void test_parse_file(void) {
+	RECORD whole, r;
+	HTMLSTREAMPARSER *hsp = record_parser(&whole);
+	char path[] = "htmltest.XXXXXX";
+	int fd;
+	FILE *f;
+	html_parser_parse(hsp, doc, sizeof(doc) - 1);
+	html_parser_cleanup(hsp);
+	if ((fd = mkstemp(path)) < 0 || !(f = fdopen(fd, "w"))) { CHECK(0); return; }
+	fwrite(doc, 1, sizeof(doc) - 1, f);
+	fclose(f);
+	hsp = record_parser(&r);
+	CHECK(!html_parser_parse_file(hsp, path));
+	CHECK(record_equal(&r, &whole));
+	remove(path);
+	CHECK(html_parser_parse_file(hsp, path) == -1 && errno == ENOENT);
+	html_parser_cleanup(hsp);
+}
+
+static void test_arena(void) {
+	char value[101], text[201];
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	memset(value, 'v', 100);
+	value[100] = '\0';
+	memset(text, 't', 200);
+	text[200] = '\0';
+	// the arenas grow from 16 bytes to fit the whole value and text
+	html_parser_set_arena(hsp, 16, 1 << 12);
+	parse_string(hsp, "<div class=\"");
+	parse_string(hsp, value);
+	parse_string(hsp, "\"");
+	CHECK(html_parser_tag_length(hsp) == 3 && !memcmp(html_parser_tag(hsp), "div", 3));
+	CHECK(html_parser_val_length(hsp) == 100 && !memcmp(html_parser_val(hsp), value, 100));
+	parse_string(hsp, ">");
+	parse_string(hsp, text);
+	parse_string(hsp, "<");
+	CHECK(html_parser_inner_text_length(hsp) == 200 && !memcmp(html_parser_inner_text(hsp), text, 200));
+	// and are truncated at the max length, shared by the names
+	html_parser_set_arena(hsp, 16, 64);
+	parse_string(hsp, "/div><p title=\"");
+	parse_string(hsp, value);
+	parse_string(hsp, "\"");
+	CHECK(html_parser_val_length(hsp) == 64 - 6 && html_parser_val_real_length(hsp) == 100);
+	html_parser_release_arena(hsp);
+	parse_string(hsp, "><b>");
+	CHECK(html_parser_tag_length(hsp) == 0 && html_parser_tag_real_length(hsp) == 1);
+	html_parser_cleanup(hsp);
+}
+
+static void test_attr_list(void) {
+	char tag[16], attr[16], val[16], pool[64];
+	HTMLSTREAMPARSER_ATTRIBUTE list[8], *a;
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	html_parser_set_tag_buffer(hsp, tag, sizeof(tag));
+	html_parser_set_attr_buffer(hsp, attr, sizeof(attr));
+	html_parser_set_val_buffer(hsp, val, sizeof(val));
+	html_parser_set_attr_list_buffer(hsp, list, 8, pool, sizeof(pool));
+	parse_string(hsp, "<A HRef");
+	CHECK(html_parser_tag_id(hsp) == HTML_TAG_ID_A && html_parser_attr_id(hsp) == HTML_ATTR_ID_UNKNOWN);
+	parse_string(hsp, "=");
+	CHECK(html_parser_attr_id(hsp) == HTML_ATTR_ID_HREF);
+	parse_string(hsp, "\"x\" id=y disabled data-q='t'>");
+	CHECK(html_parser_attr_list_length(hsp) == 4 && html_parser_attr_list(hsp) == list);
+	CHECK(html_parser_attr_name_id(list[3].name, list[3].name_len) == HTML_ATTR_ID_UNKNOWN);
+	a = html_parser_find_attr(hsp, "id", 2);
+	CHECK(a && a->value_len == 1 && !memcmp(a->value, "y", 1));
+	a = html_parser_find_attr(hsp, "disabled", 8);
+	CHECK(a && !a->value);
+	a = html_parser_find_attr(hsp, "data-q", 6);
+	CHECK(a && a->value_len == 1 && !memcmp(a->value, "t", 1));
+	CHECK(!html_parser_find_attr(hsp, "rel", 3));
+	// an attribute not fitting the pool is left out
+	html_parser_set_attr_list_buffer(hsp, list, 8, pool, 8);
+	parse_string(hsp, "<b title=\"0123456789\" id=z>");
+	CHECK(html_parser_tag_id(hsp) == HTML_TAG_ID_B && html_parser_attr_list_length(hsp) == 1);
+	CHECK(list[0].name_len == 2 && !memcmp(list[0].name, "id", 2));
+	html_parser_release_attr_list_buffer(hsp);
+	parse_string(hsp, "<i id=z>");
+	CHECK(html_parser_attr_list_length(hsp) == 0);
+	html_parser_cleanup(hsp);
+}
+
+static void test_interest(void) {
+	static HTMLSTREAMPARSER_INTEREST interest;
+	char tag[16], attr[16], val[16], inner[16], pool[64];
+	HTMLSTREAMPARSER_ATTRIBUTE list[8];
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	html_parser_set_tag_buffer(hsp, tag, sizeof(tag));
+	html_parser_set_attr_buffer(hsp, attr, sizeof(attr));
+	html_parser_set_val_buffer(hsp, val, sizeof(val));
+	html_parser_set_inner_text_buffer(hsp, inner, sizeof(inner));
+	html_parser_set_attr_list_buffer(hsp, list, 8, pool, sizeof(pool));
+	html_parser_interest_clear(&interest);
+	html_parser_interest_add_attr(&interest, HTML_TAG_ID_A, HTML_ATTR_ID_HREF);
+	html_parser_interest_add_tag(&interest, HTML_TAG_ID_TITLE, 1);
+	html_parser_set_interest(hsp, &interest);
+	// only the href of a link gets into the list
+	parse_string(hsp, "<a id=\"x\" href=\"u\">");
+	CHECK(html_parser_attr_list_length(hsp) == 1 && list[0].value_len == 1 && !memcmp(list[0].value, "u", 1));
+	parse_string(hsp, "<div id=\"x\"");
+	CHECK(html_parser_val_length(hsp) == 0 && html_parser_val_real_length(hsp) == 1);
+	parse_string(hsp, ">skip<");
+	CHECK(html_parser_inner_text_length(hsp) == 0 && html_parser_inner_text_real_length(hsp) == 4);
+	// the text of a raw text element ends with its end tag
+	parse_string(hsp, "/div><title>keep</title>");
+	CHECK(html_parser_inner_text_length(hsp) == 4 && !memcmp(html_parser_inner_text(hsp), "keep", 4));
+	// the other texts come with the all text set
+	html_parser_interest_set_all_text(&interest, 1);
+	parse_string(hsp, "<p>text<");
+	CHECK(html_parser_inner_text_length(hsp) == 4 && !memcmp(html_parser_inner_text(hsp), "text", 4));
+	html_parser_set_interest(hsp, NULL);
+	parse_string(hsp, "/p><div id=\"x\"");
+	CHECK(html_parser_val_length(hsp) == 1);
+	html_parser_cleanup(hsp);
+}
+
+static void test_collapse(void) {
+	static const char *texts[] = { "  a \n\t b  ", "a", "   ", "\t\tone  two\r\nthree\n" };
+	char inner[64], s[64], *t;
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	size_t i, n;
+	html_parser_set_inner_text_buffer(hsp, inner, sizeof(inner));
+	html_parser_set_inner_text_collapse(hsp, 1);
+	for (i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+		parse_string(hsp, "<p>");
+		parse_string(hsp, texts[i]);
+		parse_string(hsp, "<");
+		strcpy(s, texts[i]);
+		n = strlen(s);
+		t = html_parser_trim(html_parser_replace_spaces(s, &n), &n);
+		CHECK(html_parser_inner_text_length(hsp) == n && !memcmp(html_parser_inner_text(hsp), t, n));
+		CHECK(html_parser_inner_text_real_length(hsp) == strlen(texts[i]));
+		parse_string(hsp, "/p>");
+	}
+	html_parser_cleanup(hsp);
+}
+
+/*
+ * Checks the trim functions against a char by char trim
+ * for strings of every length up to 40 with the runs of
+ * whitespace around, across the 16 chars taken at once.
+ */
+static void test_trim(void) {
+	char buf[64], *s;
+	size_t len, n, lo, hi, i, pad;
+	for (len = 0; len <= 40; len++) for (pad = 0; pad < 4; pad++) {
+		for (i = 0; i < len; i++) buf[i] = i < pad * 5 || i + pad * 7 >= len ? " \t\r\n"[i % 4] : (char) ('a' + i % 26);
+		for (lo = 0; lo < len && (buf[lo] == ' ' || buf[lo] == '\t' || buf[lo] == '\r' || buf[lo] == '\n'); lo++);
+		for (hi = len; hi > lo && (buf[hi - 1] == ' ' || buf[hi - 1] == '\t' || buf[hi - 1] == '\r' || buf[hi - 1] == '\n'); hi--);
+		n = len;
+		s = html_parser_rtrim(buf, &n);
+		CHECK(s == buf && n == (hi > lo ? hi : 0));
+		n = len;
+		s = html_parser_ltrim(buf, &n);
+		CHECK(s == buf + lo && n == len - lo);
+		n = len;
+		s = html_parser_trim(buf, &n);
+		CHECK(s == buf + lo && n == hi - lo);
+	}
+}
+
+static void test_comment(void) {
+	char comment[4];
+	RECORD r;
+	HTMLSTREAMPARSER *hsp = record_parser(&r);
+	html_parser_set_comment_buffer(hsp, comment, sizeof(comment));
+	// a '>' inside a comment does not end it
+	parse_string(hsp, "<!-- a > b --");
+	CHECK(html_parser_comment_length(hsp) == 0 && r.events == 0);
+	parse_string(hsp, "><p>");
+	CHECK(!strcmp(r.text, "comment  a > b \nstart p\n"));
+	CHECK(html_parser_comment_length(hsp) == 4 && !memcmp(html_parser_comment(hsp), " a >", 4));
+	CHECK(html_parser_comment_real_length(hsp) == 7);
+	html_parser_release_comment_buffer(hsp);
+	CHECK(html_parser_comment_length(hsp) == 0);
+	html_parser_cleanup(hsp);
+}
+
+static void test_stats(void) {
+	const HTMLSTREAMPARSER_STATS *s;
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	html_parser_parse(hsp, doc, sizeof(doc) - 1);
+	s = html_parser_stats(hsp);
+#ifdef HTML_PARSER_STATS
+	CHECK(s->tags > 0 && s->comments > 0 && s->scripts > 0);
+	html_parser_reset_stats(hsp);
+#endif
+	// the counters stay 0 unless configured with --enable-stats
+	CHECK(s->tags == 0 && s->attributes == 0 && s->scripts == 0 && s->comments == 0 && s->state_bytes[0] == 0);
+	html_parser_cleanup(hsp);
+}
+
+static void test_snapshot(void) {
+	static char snapshot[1 << 16];
+	RECORD whole, r;
+	HTMLSTREAMPARSER *hsp = record_parser(&whole), *x;
+	size_t len = sizeof(doc) - 1, k, n;
+	html_parser_parse(hsp, doc, len);
+	html_parser_cleanup(hsp);
+	for (k = 0; k <= len; k++) {
+		hsp = record_parser(&r);
+		parse_chunks(hsp, doc, k, 7);
+		n = html_parser_snapshot(hsp, NULL, 0);
+		CHECK(n && n <= sizeof(snapshot) && html_parser_snapshot(hsp, snapshot, sizeof(snapshot)) == n);
+		html_parser_cleanup(hsp);
+		x = html_parser_init();
+		html_parser_set_callbacks(x, &record_callbacks, &r);
+		// a truncated snapshot is refused
+		CHECK(html_parser_restore(x, snapshot, n - 1));
+		CHECK(!html_parser_restore(x, snapshot, n));
+		parse_chunks(x, doc + k, len - k, 7);
+		CHECK(record_equal(&r, &whole));
+		html_parser_cleanup(x);
+	}
+}
+
+/*
+ * Makes a document of about len chars
+ * out of the test document.
+ */
+/*
+ * Parses the prefix, changes a field of the state by the
+ * case k and restores the snapshot into another parser,
+ * which goes on parsing the rest whether it is refused
+ * or not. Returns the result of the restore and sets
+ * attrs to the length of the attribute list.
+ */
+static int restore_changed(const char *prefix, const char *rest, int k, size_t *attrs) {
+	static char snapshot[1 << 12];
+	char inner[64], val[64], pool[64];
+	HTMLSTREAMPARSER_ATTRIBUTE list[4];
+	RECORD r;
+	HTMLSTREAMPARSER *hsp = record_parser(&r), *x;
+	size_t n;
+	int ret;
+	html_parser_set_inner_text_buffer(hsp, inner, sizeof(inner));
+	html_parser_set_val_buffer(hsp, val, sizeof(val));
+	html_parser_set_attr_list_buffer(hsp, list, 4, pool, sizeof(pool));
+	html_parser_set_decode_entities(hsp, 1);
+	html_parser_parse(hsp, prefix, strlen(prefix));
+	switch (k) {
+		case 1: hsp->entity_hi = 0xffff; break;
+		case 2: hsp->entity_lo = hsp->entity_hi + 1; break;
+		case 3: hsp->entity_match = 0xffff; break;
+		case 4: hsp->entity_match_len = hsp->entity_len; break;
+		case 5: hsp->entity_part = HTML_NAME; break;
+		case 6: hsp->script_len = (size_t) -1 / 2; break;
+		case 7: hsp->attr_value_begin = (size_t) -1 / 2; break;
+	}
+	n = html_parser_snapshot(hsp, snapshot, sizeof(snapshot));
+	html_parser_cleanup(hsp);
+	x = record_parser(&r);
+	html_parser_set_inner_text_buffer(x, inner, sizeof(inner));
+	html_parser_set_val_buffer(x, val, sizeof(val));
+	html_parser_set_attr_list_buffer(x, list, 4, pool, sizeof(pool));
+	html_parser_set_decode_entities(x, 1);
+	ret = html_parser_restore(x, snapshot, n);
+	html_parser_parse(x, rest, strlen(rest));
+	*attrs = html_parser_attr_list_length(x);
+	html_parser_cleanup(x);
+	return ret;
+}
+
+static void test_corrupt_snapshot(void) {
+	static char snapshot[1 << 12];
+	RECORD r;
+	HTMLSTREAMPARSER *hsp, *x;
+	size_t attrs, n;
+	int k;
+	CHECK(!restore_changed("<p>&a", "mp;b</p>", 0, &attrs));
+	// a reference out of the tables or the held chars
+	for (k = 1; k <= 5; k++) CHECK(restore_changed("<p>&a", "mp;b</p>", k, &attrs));
+	// the offsets into the span and the value are cut to their lengths
+	CHECK(!restore_changed("<script>x</scr", "ipt><b>", 6, &attrs));
+	CHECK(!restore_changed("<a href=\"abc", "def\">", 7, &attrs) && attrs == 1);
+	// a parser without callbacks has no span of the script text
+	hsp = html_parser_init();
+	html_parser_parse(hsp, "<script>x</scr", 14);
+	n = html_parser_snapshot(hsp, snapshot, sizeof(snapshot));
+	html_parser_cleanup(hsp);
+	x = record_parser(&r);
+	CHECK(!html_parser_restore(x, snapshot, n));
+	html_parser_parse(x, "ipt><b>", 7);
+	CHECK(!strcmp(r.text, "script \nend \nstart b\n"));
+	html_parser_cleanup(x);
+}
+
+static void test_clone_state(void) {
+	RECORD whole, r;
+	HTMLSTREAMPARSER *hsp = record_parser(&whole), *x;
+	size_t len = sizeof(doc) - 1, k;
+	html_parser_parse(hsp, doc, len);
+	html_parser_cleanup(hsp);
+	for (k = 0; k <= len; k++) {
+		hsp = record_parser(&r);
+		parse_chunks(hsp, doc, k, 5);
+		x = html_parser_init();
+		html_parser_set_callbacks(x, &record_callbacks, &r);
+		CHECK(!html_parser_clone_state(x, hsp));
+		html_parser_cleanup(hsp);
+		parse_chunks(x, doc + k, len - k, 5);
+		CHECK(record_equal(&r, &whole));
+		html_parser_cleanup(x);
+	}
+}
+
+static char *large_doc(size_t len, size_t *doc_len) {
+	char *buf = (char *) malloc(len + sizeof(doc));
+	size_t n = 0;
+	while (n < len) {
+		memcpy(buf + n, doc, sizeof(doc) - 1);
+		n += sizeof(doc) - 1;
+	}
+	*doc_len = n;
+	return buf;
+}
+
+static void test_parallel(void) {
+	RECORD whole, r;
+	HTMLSTREAMPARSER *hsp;
+	size_t len;
+	char *buf = large_doc(1 << 20, &len);
+	int threads;
+	hsp = record_parser(&whole);
+	html_parser_parse(hsp, buf, len);
+	html_parser_cleanup(hsp);
+	for (threads = 1; threads <= 8; threads *= 2) {
+		hsp = record_parser(&r);
+		html_parser_parse_parallel(hsp, buf, len, threads);
+		CHECK(record_equal(&r, &whole));
+		// the parser goes on where the document ended
+		html_parser_parse(hsp, "<i>", 3);
+		CHECK(r.events == whole.events + 2);
+		html_parser_cleanup(hsp);
+	}
+	free(buf);
+}
+
+static void test_charsets(void) {
+	static const char latin[] = "<p title=\"\xa4\">caf\xe9 \xbd</p>";
+	static const char utf8[] = "<p title=\"\xe2\x82\xac\">caf\xc3\xa9 \xc5\x93</p>";
+	static const char utf16[] = "\xff\xfe<\0p\0>\0\xac\x20<\0/\0p\0>\0";
+	RECORD r, expected;
+	HTMLSTREAMPARSER *hsp;
+	size_t i;
+	hsp = record_parser(&expected);
+	html_parser_parse(hsp, utf8, sizeof(utf8) - 1);
+	html_parser_cleanup(hsp);
+	hsp = record_parser(&r);
+	CHECK(!html_parser_set_charset(hsp, HTML_CHARSET_ISO_8859_15));
+	parse_chunks(hsp, latin, sizeof(latin) - 1, 1);
+	html_parser_flush(hsp);
+	CHECK(!strcmp(r.text, expected.text));
+	html_parser_cleanup(hsp);
+	// the UTF-8 chars cut by the chunks are put together
+	hsp = record_parser(&r);
+	CHECK(!html_parser_set_charset(hsp, HTML_CHARSET_UTF_8));
+	parse_chunks(hsp, utf8, sizeof(utf8) - 1, 1);
+	html_parser_flush(hsp);
+	CHECK(!strcmp(r.text, expected.text));
+	html_parser_cleanup(hsp);
+	// the byte order mark chooses the charset
+	hsp = record_parser(&r);
+	CHECK(!html_parser_set_charset(hsp, HTML_CHARSET_AUTO));
+	for (i = 0; i < sizeof(utf16) - 1; i++) html_parser_parse(hsp, utf16 + i, 1);
+	html_parser_flush(hsp);
+	CHECK(html_parser_charset(hsp) == HTML_CHARSET_UTF_16LE);
+	CHECK(!strcmp(r.text, "start p\ntext \xe2\x82\xac\nend p\n"));
+	html_parser_cleanup(hsp);
+	CHECK(html_parser_charset_id("Latin1", 6) == HTML_CHARSET_WINDOWS_1252);
+	CHECK(html_parser_charset_id("x-unknown", 9) == HTML_CHARSET_NONE);
+}
+
+#ifdef HTML_TEST_ZLIB
+static size_t deflate_doc(const char *buf, size_t len, unsigned char *out, size_t size, int bits) {
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+	if (deflateInit2(&z, 9, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) return 0;
+	z.next_in = (Bytef *) buf;
+	z.avail_in = len;
+	z.next_out = out;
+	z.avail_out = size;
+	deflate(&z, Z_FINISH);
+	deflateEnd(&z);
+	return size - z.avail_out;
+}
+
+/*
+ * Inflates the len chars by chunks of one char
+ * and returns what the last call returned.
+ */
+static int inflate_chunks(HTMLSTREAMPARSER *hsp, const unsigned char *buf, size_t len) {
+	int ret = 0;
+	size_t i;
+	for (i = 0; i < len && ret >= 0; i++) ret = html_parser_inflate(hsp, (const char *) buf + i, 1);
+	return ret;
+}
+
+static void test_inflate(void) {
+	static unsigned char z[4096];
+	static const int bits[] = { 16 + MAX_WBITS, MAX_WBITS, -MAX_WBITS };
+	RECORD r, twice;
+	HTMLSTREAMPARSER *hsp;
+	size_t n, m;
+	int i;
+	for (i = 0; i < 3; i++) {
+		n = deflate_doc(doc, sizeof(doc) - 1, z, sizeof(z), bits[i]);
+		CHECK(n > 0);
+		hsp = record_parser(&r);
+		CHECK(!html_parser_set_inflate(hsp, 16));
+		CHECK(inflate_chunks(hsp, z, n) == 1);
+		CHECK(!strcmp(r.text, doc_events));
+		// the chars after the end of the stream are ignored
+		memset(z + n, 0, 16);
+		html_parser_restart(hsp);
+		memset(&r, 0, sizeof(r));
+		CHECK(inflate_chunks(hsp, z, n + 16) == 1);
+		CHECK(!strcmp(r.text, doc_events));
+		// only the gzip members follow one another
+		m = deflate_doc(doc, sizeof(doc) - 1, z + n, sizeof(z) - n, bits[i]);
+		html_parser_restart(hsp);
+		memset(&r, 0, sizeof(r));
+		CHECK(html_parser_inflate(hsp, (const char *) z, n + m) == 1);
+		if (i) CHECK(!strcmp(r.text, doc_events));
+		else {
+			html_parser_cleanup(hsp);
+			hsp = record_parser(&twice);
+			html_parser_parse(hsp, doc, sizeof(doc) - 1);
+			html_parser_parse(hsp, doc, sizeof(doc) - 1);
+			CHECK(record_equal(&r, &twice));
+		}
+		html_parser_cleanup(hsp);
+	}
+	hsp = record_parser(&r);
+	CHECK(!html_parser_set_inflate(hsp, 0));
+	CHECK(html_parser_inflate(hsp, "\x1f\x8b\x08\x00\xff\xff\xff\xff\x00\x03\xff\xff", 12) < 0);
+	html_parser_cleanup(hsp);
+}
+#endif
+
+static void test_links(void) {
+	static const char page[] =
+		"<a href=\"b.html\">x</a><img src=\"/i.png\" srcset=\"s1.png 1x, s2.png 2x\">"
+		"<A HREF=\"./b.html\"></A><base href=\"http://other.org/dir/\">"
+		"<a href=\"../up?q=1&amp;r=2\">y</a><form action=\"\"></form><a href=\"#top\">z</a>"
+		"<meta http-equiv=\"refresh\" content=\"5; url=next.html\">";
+	static const char *urls[] = {
+		"http://example.com/dir/b.html", "http://example.com/i.png", "http://example.com/dir/s1.png",
+		"http://example.com/dir/s2.png", "http://other.org/dir/", "http://other.org/up?q=1&r=2",
+		"http://other.org/dir/#top", "http://other.org/dir/next.html"
+	};
+	static const char kinds[] = { HTML_LINK_HREF, HTML_LINK_SRC, HTML_LINK_SRCSET, HTML_LINK_SRCSET, HTML_LINK_BASE, HTML_LINK_HREF, HTML_LINK_HREF, HTML_LINK_REFRESH };
+	HTMLSTREAMPARSER_LINK list[16];
+	char buffer[1024];
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	size_t i, n;
+	// the URL of ./b.html is in the list already
+	CHECK(!html_parser_set_links(hsp, list, 16, buffer, sizeof(buffer), 1));
+	CHECK(!html_parser_set_links_url(hsp, "http://example.com/dir/page.html", 32));
+	parse_chunks(hsp, page, sizeof(page) - 1, 3);
+	n = html_parser_links_length(hsp);
+	CHECK(n == 8);
+	for (i = 0; i < n && i < 8; i++) {
+		CHECK(list[i].kind == kinds[i]);
+		CHECK(list[i].len == strlen(urls[i]) && !memcmp(buffer + list[i].offset, urls[i], list[i].len));
+	}
+	CHECK(list[0].tag_id == HTML_TAG_ID_A && list[1].tag_id == HTML_TAG_ID_IMG);
+	CHECK(!html_parser_links_dropped(hsp));
+	// a full list drops the links, the same URL counts twice
+	html_parser_restart(hsp);
+	CHECK(!html_parser_set_links(hsp, list, 2, buffer, sizeof(buffer), 0));
+	html_parser_parse(hsp, page, sizeof(page) - 1);
+	CHECK(html_parser_links_length(hsp) == 2 && html_parser_links_dropped(hsp) == 7);
+	html_parser_cleanup(hsp);
+}
+
+struct visible {
+	char text[1024];
+	size_t len;
+};
+
+static void visible_drain(HTMLSTREAMPARSER *hsp, void *user) {
+	struct visible *v = (struct visible *) user;
+	const char *p;
+	size_t n;
+	while ((p = html_parser_visible_text(hsp, &n)) && n) {
+		memcpy(v->text + v->len, p, n);
+		v->len += n;
+		html_parser_consume_visible_text(hsp, n);
+	}
+}
+
+static void test_visible(void) {
+	static const char page[] =
+		"<html><head><title>T</title><style>p{}</style></head><body>"
+		"<p>one  &amp;\n two</p><script>x()</script><div>three<br>four</div>"
+		"<pre>a  b\n c</pre><table><tr><td>c1<td>c2</table><ul><li>i1<li>i2</ul><p>end</p>";
+	static const char expected[] = "one & two\nthree\nfour\na  b\n c\nc1 c2\ni1\ni2\nend";
+	struct visible v;
+	char ring[16];
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	v.len = 0;
+	CHECK(!html_parser_set_visible_text(hsp, ring, sizeof(ring), 4, visible_drain, &v));
+	parse_chunks(hsp, page, sizeof(page) - 1, 5);
+	visible_drain(hsp, &v);
+	v.text[v.len] = '\0';
+	CHECK(!strcmp(v.text, expected));
+	CHECK(!html_parser_visible_text_dropped(hsp));
+	// a text not taken out is dropped when the ring is full
+	html_parser_restart(hsp);
+	CHECK(!html_parser_set_visible_text(hsp, ring, sizeof(ring), 0, NULL, NULL));
+	html_parser_parse(hsp, page, sizeof(page) - 1);
+	CHECK(html_parser_visible_text_length(hsp) <= sizeof(ring) && html_parser_visible_text_dropped(hsp));
+	html_parser_cleanup(hsp);
+}
+
+static void test_tape(void) {
+	static const char page[] = "<div id=a><p>x<b>y</b></p><!--c--></div><p>z</p>";
+	static const char expected[] =
+		"0 start div 0 10\n1 attr id=a 0 0\n2 start p 1 8\n3 text x 2 0\n4 start b 2 7\n"
+		"5 text y 3 0\n6 end b 2 0\n7 end p 1 0\n8 comment c 1 0\n9 end div 0 0\n"
+		"10 start p 0 13\n11 text z 1 0\n12 end p 0 0\n";
+	static const char *kinds[] = { "start", "attr", "end", "text", "comment", "script" };
+	HTMLSTREAMPARSER_TOKEN tokens[64];
+	char arena[64], out[1024], *buf = (char *) malloc(sizeof(page));
+	HTMLSTREAMPARSER *hsp = html_parser_init();
+	size_t i, n, len = 0;
+	const HTMLSTREAMPARSER_TOKEN *t;
+	memcpy(buf, page, sizeof(page));
+	CHECK(!html_parser_set_tape(hsp, tokens, 64, arena, sizeof(arena)));
+	html_parser_parse(hsp, buf, 3);
+	html_parser_parse(hsp, buf + 3, sizeof(page) - 1 - 3);
+	html_parser_end_tape(hsp);
+	n = html_parser_tape_length(hsp);
+	for (i = 0; i < n; i++) {
+		t = tokens + i;
+		len += sprintf(out + len, "%zu %s %.*s", i, kinds[t->kind], (int) t->len, html_parser_token_name(t, buf, arena));
+		if (t->kind == HTML_TOKEN_ATTRIBUTE) len += sprintf(out + len, "=%.*s", (int) t->value_len, html_parser_token_value(t, buf, arena));
+		len += sprintf(out + len, " %u %u\n", t->depth, t->kind == HTML_TOKEN_START_TAG ? t->next : 0);
+	}
+	CHECK(!strcmp(out, expected));
+	CHECK(tokens[0].id == HTML_TAG_ID_DIV && tokens[1].id == HTML_ATTR_ID_ID && tokens[3].id == HTML_TAG_ID_P);
+	// the name split between the buffers is in the arena
+	CHECK((tokens[0].flags & HTML_TOKEN_ARENA) && !(tokens[2].flags & HTML_TOKEN_ARENA));
+	CHECK(html_parser_tape_find(tokens, n, 0, HTML_TOKEN_START_TAG, HTML_TAG_ID_P) == 2);
+	CHECK(html_parser_tape_find(tokens, n, tokens[0].next, HTML_TOKEN_START_TAG, HTML_TAG_ID_P) == 10);
+	CHECK(html_parser_tape_find(tokens, n, 0, HTML_TOKEN_START_TAG, HTML_TAG_ID_A) == n);
+	CHECK(!html_parser_tape_dropped(hsp));
+	// the tokens which do not fit are dropped
+	html_parser_restart(hsp);
+	CHECK(!html_parser_set_tape(hsp, tokens, 4, arena, sizeof(arena)));
+	html_parser_parse(hsp, buf, sizeof(page) - 1);
+	CHECK(html_parser_tape_length(hsp) == 4 && html_parser_tape_dropped(hsp) == 9);
+	html_parser_cleanup(hsp);
+	free(buf);
+}
+
+#define TEST_JOBS 64
+
+static void pool_setup(HTMLSTREAMPARSER *hsp, void *arg) { (void) arg; html_parser_set_tag_to_lower(hsp, 1); }
+
+static void pool_done(void *arg) { (*(int *) arg)++; }
+
+static void test_pool(void) {
+	static HTMLSTREAMPARSER_JOB jobs[TEST_JOBS];
+	static RECORD records[TEST_JOBS];
+	RECORD whole;
+	HTMLSTREAMPARSER *hsp = record_parser(&whole);
+	HTMLSTREAMPARSER_POOL *pool;
+	size_t len;
+	char *buf = large_doc(1 << 14, &len), path[] = "htmltest.XXXXXX";
+	int i, fd, batches = 0;
+	FILE *f;
+	html_parser_parse(hsp, buf, len);
+	html_parser_cleanup(hsp);
+	if ((fd = mkstemp(path)) < 0 || !(f = fdopen(fd, "w"))) { CHECK(0); free(buf); return; }
+	fwrite(buf, 1, len, f);
+	fclose(f);
+	pool = html_parser_pool_init(4, pool_setup, NULL, NULL);
+	CHECK(pool != NULL);
+	if (!pool) { remove(path); free(buf); return; }
+	memset(jobs, 0, sizeof(jobs));
+	memset(records, 0, sizeof(records));
+	for (i = 0; i < TEST_JOBS; i++) {
+		jobs[i].buf = buf;
+		jobs[i].len = len;
+		jobs[i].callbacks = &record_callbacks;
+		jobs[i].user = records + i;
+		if (i % 4 == 0) jobs[i].path = path;
+	}
+	CHECK(!html_parser_pool_submit(pool, jobs, TEST_JOBS / 2, pool_done, &batches));
+	CHECK(!html_parser_pool_submit(pool, jobs + TEST_JOBS / 2, TEST_JOBS / 2, pool_done, &batches));
+	html_parser_pool_wait(pool);
+	CHECK(batches == 2);
+	for (i = 0; i < TEST_JOBS; i++) {
+		CHECK(!jobs[i].error);
+		CHECK(record_equal(records + i, &whole));
+	}
+	html_parser_pool_cleanup(pool);
+	remove(path);
+	free(buf);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+struct connection {
+	RECORD record;
+	int done;
+	int error;
+};
+
+static void loop_done(HTMLSTREAMPARSER_CONNECTION *c, HTMLSTREAMPARSER *hsp, int error, void *user) {
+	struct connection *k = (struct connection *) user;
+	(void) c;
+	(void) hsp;
+	k->done++;
+	k->error = error;
+}
+
+static void test_loop(void) {
+	struct connection k[3];
+	HTMLSTREAMPARSER *hsp[3];
+	HTMLSTREAMPARSER_LOOP *loop = html_parser_loop_init(64, 4);
+	int fd[3][2], i, n;
+	size_t sent;
+	if (!loop) { printf("loop: skipped\n"); return; }
+	signal(SIGPIPE, SIG_IGN);
+	for (i = 0; i < 3; i++) {
+		CHECK(!socketpair(AF_UNIX, SOCK_STREAM, 0, fd[i]));
+		hsp[i] = html_parser_init();
+		memset(k + i, 0, sizeof(struct connection));
+		html_parser_set_callbacks(hsp[i], &record_callbacks, &k[i].record);
+		CHECK(html_parser_loop_add(loop, fd[i][0], hsp[i], loop_done, k + i) != NULL);
+	}
+	// the streams are sent in pieces between the runs
+	for (sent = 0; sent < sizeof(doc) - 1; sent += n) {
+		n = sizeof(doc) - 1 - sent < 97 ? sizeof(doc) - 1 - sent : 97;
+		for (i = 0; i < 3; i++) CHECK(write(fd[i][1], doc + sent, n) == n);
+		CHECK(html_parser_loop_run(loop, 0) == 3);
+	}
+	for (i = 0; i < 3; i++) close(fd[i][1]);
+	while ((n = html_parser_loop_run(loop, 100)) > 0);
+	CHECK(n == 0);
+	for (i = 0; i < 3; i++) {
+		CHECK(k[i].done == 1 && !k[i].error);
+		CHECK(!strcmp(k[i].record.text, doc_events));
+		html_parser_cleanup(hsp[i]);
+	}
+#ifdef HTML_TEST_ZLIB
+	{
+		// a gzip stream with padding after its end is not corrupt
+		static unsigned char z[4096];
+		size_t len = deflate_doc(doc, sizeof(doc) - 1, z, sizeof(z) - 16, 16 + MAX_WBITS);
+		memset(z + len, 0, 16);
+		CHECK(!socketpair(AF_UNIX, SOCK_STREAM, 0, fd[0]));
+		hsp[0] = html_parser_init();
+		memset(k, 0, sizeof(struct connection));
+		html_parser_set_callbacks(hsp[0], &record_callbacks, &k[0].record);
+		CHECK(!html_parser_set_inflate(hsp[0], 0));
+		CHECK(html_parser_loop_add(loop, fd[0][0], hsp[0], loop_done, k) != NULL);
+		CHECK(write(fd[0][1], z, len + 16) == (ssize_t) (len + 16));
+		close(fd[0][1]);
+		while ((n = html_parser_loop_run(loop, 100)) > 0);
+		CHECK(k[0].done == 1 && !k[0].error);
+		CHECK(!strcmp(k[0].record.text, doc_events));
+		html_parser_cleanup(hsp[0]);
+	}
+#endif
+	html_parser_loop_cleanup(loop);
+}
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+static void remove_dir(const char *dir) {
+	char path[512];
+	struct dirent *e;
+	DIR *d = opendir(dir);
+	if (!d) return;
+	while ((e = readdir(d))) {
+		if (e->d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+		remove(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+static void test_cache(void) {
+	char dir[] = "htmltest.XXXXXX", tag[32];
+	RECORD whole, r;
+	HTMLSTREAMPARSER *hsp = record_parser(&whole);
+	HTMLSTREAMPARSER_CACHE *cache;
+	size_t len;
+	char *buf = large_doc(1 << 12, &len);
+	html_parser_parse(hsp, buf, len);
+	html_parser_cleanup(hsp);
+	if (!mkdtemp(dir)) { CHECK(0); free(buf); return; }
+	if (!(cache = html_parser_cache_open(dir, 1 << 20))) { printf("cache: skipped\n"); rmdir(dir); free(buf); return; }
+	hsp = record_parser(&r);
+	CHECK(html_parser_cache_parse(cache, hsp, buf, len) == 0);
+	CHECK(record_equal(&r, &whole));
+	memset(&r, 0, sizeof(r));
+	CHECK(html_parser_cache_parse(cache, hsp, buf, len) == 1);
+	CHECK(record_equal(&r, &whole));
+	// a changed document is not taken from the cache
+	buf[len - 10] = 'X';
+	memset(&r, 0, sizeof(r));
+	CHECK(html_parser_cache_parse(cache, hsp, buf, len) == 0);
+	CHECK(r.events == whole.events);
+	html_parser_cleanup(hsp);
+	// the parser given is not changed, also without a tape
+	hsp = record_parser(&r);
+	html_parser_set_tag_buffer(hsp, tag, sizeof(tag));
+	CHECK(!html_parser_set_charset(hsp, HTML_CHARSET_UTF_8));
+	html_parser_parse(hsp, "<ab", 3);
+	memset(&r, 0, sizeof(r));
+	CHECK(html_parser_cache_parse(cache, hsp, doc, sizeof(doc) - 1) == 0);
+	CHECK(!strcmp(r.text, doc_events));
+	html_parser_parse(hsp, ">", 1);
+	html_parser_flush(hsp);
+	CHECK(html_parser_tag_length(hsp) == 2 && !memcmp(html_parser_tag(hsp), "ab", 2));
+	html_parser_cleanup(hsp);
+	html_parser_cache_close(cache);
+	remove_dir(dir);
+	free(buf);
+}
+#endif
+
+int main(void) {
+	test_callbacks();
+	test_chunks();
+	test_parse_file();
+	test_entities();
+	test_arena();
+	test_attr_list();
+	test_interest();
+	test_collapse();
+	test_trim();
+	test_comment();
+	test_stats();
+	test_snapshot();
+	test_corrupt_snapshot();
+	test_clone_state();
+	test_parallel();
+	test_charsets();
+#ifdef HTML_TEST_ZLIB
+	test_inflate();
+#else
+	printf("inflate: skipped\n");
+#endif
+	test_links();
+	test_visible();
+	test_tape();
+	test_pool();
+#ifdef HAVE_SYS_EPOLL_H
+	test_loop();
+#else
+	printf("loop: skipped\n");
+#endif
+#ifdef HAVE_SYS_MMAN_H
+	test_cache();
+#else
+	printf("cache: skipped\n");
+#endif
+	if (failed) printf("%d checks failed\n", failed);
+	return failed != 0;
+}